@@ -0,0 +1,139 @@
+/*
+	bytebauble_bench.cpp - Microbenchmark for the ByteBauble packed integer functions.
+	
+	Revision 0.
+	
+	Notes:
+			- Compares the current implementation against the previous bit-by-bit 
+				implementation, after validating the round trip for all lengths.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/bytebauble.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <random>
+
+
+// Previous implementation, which copied the bits one at a time.
+uint32_t legacyReadPackedInt(uint32_t packed, uint32_t &output) {
+	output = 0;
+	int idx = 0;
+	int src = 0;
+	int i;
+	for (i = 0; i < 4; ++i) {
+		for (int j = 0; j < 7; ++j) {
+			if ((packed >> src++) & 1UL) { output |= (1UL << idx++); }
+			else { idx++; }
+		}
+		
+		if (!((packed >> src++) & 1UL)) { break; }
+	}
+	
+	return i + 1;
+}
+
+
+uint32_t legacyWritePackedInt(uint32_t integer, uint32_t &output) {
+	uint32_t totalBytes = 0;
+	if (integer <= 0x80) { totalBytes = 1; }
+	else if (integer <= 0x4000) { totalBytes = 2; }
+	else if (integer <= 0x200000) { totalBytes = 3; }
+	else if (integer <= 0x10000000) { totalBytes = 4; }
+	else { return 0; }
+	
+	output = 0;
+	int idx = 0;
+	int src = 0;
+	for (uint32_t i = 0; i < totalBytes; ++i) {
+		for (int j = 0; j < 7; ++j) {
+			if ((integer >> src++) & 1UL) { output |= (1UL << idx++); }
+			else { idx++; }
+		}
+		
+		if ((i + 1) < totalBytes) { output |= (1UL << idx++); }
+	}
+	
+	return totalBytes;
+}
+
+
+// Run the function over all inputs a number of times, returning nanoseconds per call.
+template <typename F>
+double bench(F fnc, std::vector<uint32_t> &inputs, uint32_t &sink) {
+	const int rounds = 20;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		for (uint32_t in : inputs) {
+			uint32_t out;
+			sink += fnc(in, out);
+			sink ^= out;
+		}
+	}
+	
+	auto end = std::chrono::steady_clock::now();
+	double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	return ns / (rounds * inputs.size());
+}
+
+
+int main() {
+	// Validate round trips and encoded lengths for all boundaries, plus the full range up to three
+	// bytes.
+	uint32_t lengths[] = { 1, 1, 2, 2, 3, 3, 4, 4 };
+	uint32_t values[] = { 0, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, 0xFFFFFFF };
+	for (int i = 0; i < 8; ++i) {
+		uint32_t packed, out;
+		uint32_t len = ByteBauble::writePackedInt(values[i], packed);
+		if (len != lengths[i] || ByteBauble::readPackedInt(packed, out) != len 
+				|| out != values[i]) {
+			std::cerr << "Round trip failed for 0x" << std::hex << values[i] << std::endl;
+			return 1;
+		}
+	}
+	
+	for (uint32_t i = 0; i < 0x200000; ++i) {
+		uint32_t packed, out, legacy;
+		ByteBauble::writePackedInt(i, packed);
+		legacyReadPackedInt(packed, legacy);
+		if (ByteBauble::readPackedInt(packed, out) == 0 || out != i || legacy != i) {
+			std::cerr << "Round trip failed for 0x" << std::hex << i << std::endl;
+			return 1;
+		}
+	}
+	
+	uint32_t packed;
+	if (ByteBauble::writePackedInt(0x10000000, packed) != 0) {
+		std::cerr << "Out of range integer was not rejected." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Validated packed integer round trips." << std::endl;
+	
+	// Benchmark with a mix of lengths, as seen with MQTT remaining lengths.
+	std::mt19937 rng(42);
+	std::vector<uint32_t> ints, packedInts;
+	for (int i = 0; i < 1000000; ++i) {
+		uint32_t bits = 7 * (1 + rng() % 4);
+		uint32_t in = rng() & ((1UL << bits) - 1);
+		ints.push_back(in);
+		ByteBauble::writePackedInt(in, packed);
+		packedInts.push_back(packed);
+	}
+	
+	uint32_t sink = 0;
+	double legacyRead = bench(legacyReadPackedInt, packedInts, sink);
+	double read = bench(ByteBauble::readPackedInt, packedInts, sink);
+	double legacyWrite = bench(legacyWritePackedInt, ints, sink);
+	double write = bench(ByteBauble::writePackedInt, ints, sink);
+	
+	std::cout << "readPackedInt:  " << legacyRead << " ns (legacy), " << read << " ns" << std::endl;
+	std::cout << "writePackedInt: " << legacyWrite << " ns (legacy), " << write << " ns" << std::endl;
+	std::cout << "(checksum " << sink << ")" << std::endl;
+	
+	return 0;
+}
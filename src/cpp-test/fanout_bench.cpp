@@ -0,0 +1,97 @@
+/*
+	fanout_bench.cpp - Benchmark for sending a PUBLISH message to many subscribers.
+	
+	Revision 0.
+	
+	Notes:
+			- Compares encoding the message for each subscriber and copying it into the outbound
+				queue, against NmqttFanout with a per-subscriber header and a shared body.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/message.h"
+#include "../cpp/fanout.h"
+#include "../cpp/outbound.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+const size_t subscribers = 10000;
+
+
+// Previous implementation: a message and a copy of the payload per subscriber.
+double legacyFanout(const std::string &topic, const std::string &payload,
+						std::vector<NmqttFrame> &queued) {
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < subscribers; ++i) {
+		NmqttMessage msg(MQTT_PUBLISH);
+		msg.setTopic(topic);
+		msg.setQoS(MQTT_QOS_AT_LEAST_ONCE);
+		msg.setPacketID((uint16_t) (i + 1));
+		std::string_view header = msg.serializeHeaderLocal(payload.length());
+		std::string data;
+		data.reserve(header.length() + payload.length());
+		data.append(header.data(), header.length());
+		data += payload;
+		queued.push_back(NmqttFrame(std::move(data)));
+	}
+	
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+double sharedFanout(const std::string &topic, const std::string &payload,
+						std::vector<NmqttFrame> &queued) {
+	auto start = std::chrono::steady_clock::now();
+	NmqttFanout fanout(topic, payload);
+	for (size_t i = 0; i < subscribers; ++i) {
+		std::string_view header = fanout.header(MQTT_QOS_AT_LEAST_ONCE, false,
+												MQTT_PROTOCOL_VERSION_4, (uint16_t) (i + 1));
+		queued.push_back(NmqttFrame(std::string(header), fanout.getBody()));
+	}
+	
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+int main() {
+	std::string topic = "site/42/sensors/temperature";
+	size_t sizes[] = { 64, 1024, 64 * 1024 };
+	for (size_t size : sizes) {
+		std::string payload(size, 'x');
+		std::vector<NmqttFrame> legacy;
+		std::vector<NmqttFrame> shared;
+		legacy.reserve(subscribers);
+		shared.reserve(subscribers);
+		double legacyMs = legacyFanout(topic, payload, legacy);
+		double sharedMs = sharedFanout(topic, payload, shared);
+		
+		// Both should queue the same bytes.
+		for (size_t i = 0; i < subscribers; i += 997) {
+			if (shared[i].header + *shared[i].body != legacy[i].header) {
+				std::cerr << "Fan-out message differs for subscriber " << i << std::endl;
+				return 1;
+			}
+		}
+		
+		size_t legacyBytes = 0;
+		size_t sharedBytes = shared[0].body->length();
+		for (size_t i = 0; i < subscribers; ++i) {
+			legacyBytes += legacy[i].length();
+			sharedBytes += shared[i].header.length();
+		}
+		
+		std::cout << subscribers << " subscribers, " << size << " byte payload: " << legacyMs
+					<< " ms, " << legacyBytes << " bytes (legacy), " << sharedMs << " ms, "
+					<< sharedBytes << " bytes" << std::endl;
+	}
+	
+	return 0;
+}
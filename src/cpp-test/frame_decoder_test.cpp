@@ -0,0 +1,88 @@
+/*
+	frame_decoder_test.cpp - Test for the NymphMQTT frame decoder class.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/frame_decoder.h"
+#include "../cpp/message.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+
+// Feed the stream in chunks of the provided size, collecting all complete frames.
+int decode(const std::string &stream, size_t chunk, std::vector<std::string> &frames) {
+	NmqttFrameDecoder decoder;
+	for (size_t i = 0; i < stream.length(); i += chunk) {
+		const char* data = stream.data() + i;
+		size_t unread = std::min(chunk, stream.length() - i);
+		while (unread > 0) {
+			size_t used = 0;
+			int res = decoder.feed(data, unread, used);
+			data += used;
+			unread -= used;
+			if (res < 0) { return -1; }
+			else if (res == 0) { break; }
+			
+			std::string frame;
+			decoder.takeFrame(frame);
+			frames.push_back(frame);
+		}
+	}
+	
+	return 1;
+}
+
+
+int main() {
+	// Create a stream of PUBLISH messages with 1, 2 and 3 byte remaining lengths, followed by
+	// a PINGRESP message.
+	std::string stream;
+	std::vector<std::string> expected;
+	size_t sizes[] = { 12, 300, 20000 };
+	for (size_t size : sizes) {
+		NmqttMessage msg(MQTT_PUBLISH);
+		msg.setTopic("a/hello");
+		msg.setPayload(std::string(size, 'x'));
+		expected.push_back(msg.serialize());
+		stream += expected.back();
+	}
+	
+	expected.push_back(std::string({ (char) MQTT_PINGRESP, 0x00 }));
+	stream += expected.back();
+	
+	// Decode using a range of chunk sizes, including single bytes.
+	size_t chunks[] = { 1, 2, 3, 7, 4096, stream.length() };
+	for (size_t chunk : chunks) {
+		std::vector<std::string> frames;
+		if (decode(stream, chunk, frames) < 0) {
+			std::cerr << "Decoder reported corrupted data for chunk size " << chunk << std::endl;
+			return 1;
+		}
+		
+		if (frames != expected) {
+			std::cerr << "Decoded frames do not match for chunk size " << chunk << std::endl;
+			return 1;
+		}
+	}
+	
+	std::cout << "Successfully decoded frames." << std::endl;
+	
+	// A remaining length with the continuation bit set on the fourth byte is corrupted.
+	std::vector<std::string> frames;
+	std::string corrupt({ 0x30, (char) 0xFF, (char) 0xFF, (char) 0xFF, (char) 0xFF, 0x01 });
+	if (decode(corrupt, 1, frames) >= 0) {
+		std::cerr << "Failed to detect corrupted remaining length." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully detected corrupted data." << std::endl;
+	
+	return 0;
+}
@@ -34,5 +34,28 @@ int main() {
 	std::cout << "Found topic: " << msg.getTopic() << std::endl;
 	std::cout << "Found payload: " << msg.getPayload() << std::endl;
 	
+	// A PUBLISH with both QoS bits set is malformed.
+	NmqttMessage bad;
+	if (bad.parseMessage(std::string({0x36, 0x05, 0x00, 0x01, 'a', 0x00, 0x01})) >= 0 || bad.valid()) {
+		std::cerr << "Accepted PUBLISH with QoS 3." << std::endl;
+		return 1;
+	}
+	
+	// An MQTT 5 DISCONNECT carries its reason code, which is left out with MQTT 3.1.1.
+	NmqttMessage disconnect(MQTT_DISCONNECT);
+	disconnect.setProtocolVersion(MQTT_PROTOCOL_VERSION_5);
+	disconnect.setReasonCode(MQTT_CODE_TOPIC_ALIAS_INVALID);
+	std::string encoded = disconnect.serialize();
+	NmqttMessage parsed;
+	parsed.setProtocolVersion(MQTT_PROTOCOL_VERSION_5);
+	disconnect.setProtocolVersion(MQTT_PROTOCOL_VERSION_4);
+	if (encoded != std::string({ (char) 0xE0, 0x02, (char) 0x94, 0x00 }) 
+			|| parsed.parseMessage(encoded) < 0 
+			|| parsed.getReasonCode() != MQTT_CODE_TOPIC_ALIAS_INVALID
+			|| disconnect.serialize() != std::string({ (char) 0xE0, 0x00 })) {
+		std::cerr << "DISCONNECT reason code not encoded correctly." << std::endl;
+		return 1;
+	}
+	
 	return 0;
 }
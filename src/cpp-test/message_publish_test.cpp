@@ -8,6 +8,8 @@
 
 
 #include "../cpp/message.h"
+#include "../cpp/publish_template.h"
+#include "../cpp/fanout.h"
 
 #include <string>
 #include <iostream>
@@ -27,6 +29,12 @@ int main() {
 	
 	std::string binMsg = msg.serialize();
 	
+	// Serialising again should yield the same message.
+	if (msg.serialize() != binMsg || msg.serializedSize() != binMsg.length()) {
+		std::cerr << "Repeated serialisation differs." << std::endl;
+		return 1;
+	}
+	
 	std::cout << "Bin msg: " << std::hex << binMsg << std::endl;
 	std::cout << "Bin msg length: " << std::hex << binMsg.length() << std::endl;
 	
@@ -44,5 +52,124 @@ int main() {
 	std::cout << "Found topic: " << msg2.getTopic() << std::endl;
 	std::cout << "Found payload: " << msg2.getPayload() << std::endl;
 	
+	// A publish template should yield the same messages as NmqttMessage, for any payload size.
+	NmqttPublishTemplate tpl(topic, MQTT_QOS_AT_LEAST_ONCE, true);
+	size_t sizes[] = { 0, 12, 200, 20000 };
+	for (size_t size : sizes) {
+		NmqttMessage msg3(MQTT_PUBLISH);
+		msg3.setQoS(MQTT_QOS_AT_LEAST_ONCE);
+		msg3.setRetain(true);
+		msg3.setPacketID(size + 1);
+		msg3.setTopic(topic);
+		msg3.setPayload(std::string(size, 'x'));
+		if (tpl.build(std::string(size, 'x'), size + 1) != msg3.serialize()) {
+			std::cerr << "Template message differs for payload size " << size << std::endl;
+			return 1;
+		}
+		
+		// Headers for scatter-gather sends, followed by the payload, should match as well.
+		std::string expected = msg3.serialize();
+		std::string header(tpl.buildHeader(size, size + 1));
+		std::string header2(msg3.serializeHeaderLocal(size));
+		if (header + std::string(size, 'x') != expected 
+				|| header2 + std::string(size, 'x') != expected) {
+			std::cerr << "Message header differs for payload size " << size << std::endl;
+			return 1;
+		}
+	}
+	
+	// Topics which are not valid for PUBLISH leave the template invalid.
+	std::string invalidTopics[] = { "", "a/+", "a/#", std::string("a\0b", 3), "a\xC3" };
+	for (const std::string &t : invalidTopics) {
+		NmqttPublishTemplate bad(t);
+		if (bad.valid() || !bad.buildHeader(10).empty()) {
+			std::cerr << "Template accepted an invalid topic." << std::endl;
+			return 1;
+		}
+	}
+	
+	std::cout << "Successfully built template messages." << std::endl;
+	
+	// A fan-out header followed by the shared body should match NmqttMessage for every variant,
+	// with and without a topic alias.
+	NmqttFanout fanout(topic, std::string(200, 'y'));
+	for (int v = 0; v < 2; ++v) {
+		MqttProtocolVersion version = v ? MQTT_PROTOCOL_VERSION_5 : MQTT_PROTOCOL_VERSION_4;
+		for (int q = 0; q < 3; ++q) {
+			for (int alias = 0; alias < 3; ++alias) {
+				if (alias > 0 && !v) { continue; }
+				
+				NmqttMessage msg6(MQTT_PUBLISH);
+				msg6.setProtocolVersion(version);
+				msg6.setQoS((MqttQoS) (q << 1));
+				msg6.setRetain(q == 1);
+				msg6.setTopic((alias == 2) ? std::string() : topic);
+				if (q > 0) { msg6.setPacketID(q * 1000 + alias); }
+				if (alias > 0) { msg6.setProperty(MQTT_PROP_TOPIC_ALIAS, 7); }
+				msg6.setPayload(std::string(200, 'y'));
+				
+				std::string frame(fanout.header((MqttQoS) (q << 1), q == 1, version, 
+												q * 1000 + alias, alias ? 7 : 0, alias == 2));
+				if (frame + *fanout.getBody() != msg6.serialize()) {
+					std::cerr << "Fan-out message differs for version " << v << ", QoS " << q 
+								<< ", alias " << alias << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+	
+	std::cout << "Successfully built fan-out messages." << std::endl;
+	
+	// MQTT 5 properties should survive a round trip, and be decoded on access. Setting a property
+	// again replaces its value.
+	NmqttMessage msg4(MQTT_PUBLISH);
+	msg4.setProtocolVersion(MQTT_PROTOCOL_VERSION_5);
+	msg4.setTopic(topic);
+	msg4.setProperty(MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, 60);
+	msg4.setPayload(payload);
+	msg4.setProperty(MQTT_PROP_CONTENT_TYPE, "application/json");
+	msg4.addUserProperty("source", "sensor-1");
+	msg4.addUserProperty("unit", "C");
+	msg4.setProperty(MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, 300);
+	msg4.setProperty(MQTT_PROP_CONTENT_TYPE, "text/plain");
+	
+	NmqttMessage msg5;
+	msg5.setProtocolVersion(MQTT_PROTOCOL_VERSION_5);
+	msg5.parseMessage(msg4.serialize());
+	
+	uint32_t expiry = 0;
+	std::string_view contentType, key, value;
+	if (!msg5.valid() || msg5.getPayloadView() != payload
+			|| !msg5.getProperty(MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, expiry) || expiry != 300
+			|| !msg5.getProperty(MQTT_PROP_CONTENT_TYPE, contentType) || contentType != "text/plain"
+			|| msg5.getUserPropertyCount() != 2 || !msg5.getUserProperty(1, key, value)
+			|| key != "unit" || value != "C" || msg5.hasProperty(MQTT_PROP_TOPIC_ALIAS)) {
+		std::cerr << "MQTT 5 properties round trip failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully parsed MQTT 5 properties." << std::endl;
+	
+	// Reusing a message for many values keeps its strings intact while the buffer is compacted.
+	for (int i = 0; i < 1000; ++i) {
+		std::string t = "a/" + std::to_string(i);
+		std::string p(i % 200, (char) ('a' + i % 26));
+		msg4.setPayload(p);
+		msg4.setProperty(MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, i);
+		msg4.setTopic(t);
+		if (i % 3 == 0) { msg4.setProperty(MQTT_PROP_CONTENT_TYPE, t); }
+		
+		msg5.parseMessage(msg4.serialize());
+		if (!msg5.valid() || msg5.getTopic() != t || msg5.getPayloadView() != p
+				|| !msg5.getProperty(MQTT_PROP_MESSAGE_EXPIRY_INTERVAL, expiry) || expiry != (uint32_t) i
+				|| msg5.getUserPropertyCount() != 2) {
+			std::cerr << "Reusing a message failed at " << i << "." << std::endl;
+			return 1;
+		}
+	}
+	
+	std::cout << "Successfully reused a message." << std::endl;
+	
 	return 0;
 }
@@ -0,0 +1,184 @@
+/*
+	outbound_test.cpp - Test for the NymphMQTT outbound queue of a client connection.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/outbound.h"
+#include "../cpp/message.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <iostream>
+
+
+// Create a frame of 100 bytes, with the sequence number in the second byte.
+std::string frame(uint8_t type, int seq) {
+	std::string f(100, 'x');
+	f[0] = (char) type;
+	f[1] = (char) seq;
+	return f;
+}
+
+
+// Send everything that is queued, in chunks of the provided size, returning the sequence numbers.
+std::vector<int> drain(NmqttOutbound &out, size_t chunk) {
+	std::string sent;
+	while (!out.empty()) {
+		std::string_view parts[4];
+		size_t count = out.gather(parts, 4);
+		size_t n = 0;
+		for (size_t i = 0; i < count && n < chunk; ++i) {
+			size_t len = std::min(chunk - n, parts[i].length());
+			sent.append(parts[i].data(), len);
+			n += len;
+		}
+		
+		out.consume(n);
+	}
+	
+	std::vector<int> seqs;
+	for (size_t i = 0; i < sent.length(); i += 100) { seqs.push_back(sent[i + 1]); }
+	return seqs;
+}
+
+
+int main() {
+	NmqttOutboundLimits limits;
+	limits.maxBytes = 1000;
+	limits.maxMessages = 100;
+	limits.lowWaterBytes = 200;
+	limits.lowWaterMessages = 100;
+	limits.maxSpillBytes = 500;
+	limits.qos0Policy = NMQTT_DROP_OLDEST;
+	NmqttOutbound::setLimits(limits);
+	
+	// Dropping the oldest QoS 0 messages keeps the newest ten, but not those which are being sent.
+	NmqttOutbound out;
+	for (int i = 0; i < 10; ++i) { out.push(frame(MQTT_PUBLISH, i)); }
+	if (out.aboveHighWater()) {
+		std::cerr << "Queue above high-water mark before reaching the limit." << std::endl;
+		return 1;
+	}
+	
+	std::string_view parts[2];
+	out.gather(parts, 2);
+	for (int i = 10; i < 15; ++i) { out.push(frame(MQTT_PUBLISH, i)); }
+	out.consume(0);
+	
+	std::vector<int> expected = { 0, 1, 7, 8, 9, 10, 11, 12, 13, 14 };
+	if (!out.aboveHighWater() || out.droppedCount() != 5 || drain(out, 150) != expected) {
+		std::cerr << "Drop-oldest policy failed." << std::endl;
+		return 1;
+	}
+	
+	if (out.aboveHighWater()) {
+		std::cerr << "Queue still above high-water mark after draining." << std::endl;
+		return 1;
+	}
+	
+	// QoS 1 messages are held back in order, and control messages are always queued.
+	for (int i = 0; i < 10; ++i) { out.push(frame(MQTT_PUBLISH, i)); }
+	out.push(frame(MQTT_PUBLISH | 0x2, 10));
+	out.push(frame(MQTT_PUBLISH | 0x2, 11));
+	out.push(frame(MQTT_PINGRESP, 12));
+	out.push(frame(MQTT_PUBLISH | 0x2, 13));
+	expected = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 10, 11, 13 };
+	if (drain(out, 1000) != expected || out.aboveHighWater()) {
+		std::cerr << "Held back QoS 1 messages not sent in order." << std::endl;
+		return 1;
+	}
+	
+	// Exceeding the spill limit disconnects the client.
+	for (int i = 0; i < 10; ++i) { out.push(frame(MQTT_PUBLISH | 0x2, i)); }
+	bool ok = true;
+	for (int i = 10; i < 16; ++i) { ok = out.push(frame(MQTT_PUBLISH | 0x2, i)) && ok; }
+	if (ok) {
+		std::cerr << "Spill limit not enforced." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully applied drop-oldest and spill limits." << std::endl;
+	
+	// Dropping the newest QoS 0 messages, and disconnecting.
+	limits.qos0Policy = NMQTT_DROP_NEWEST;
+	NmqttOutbound::setLimits(limits);
+	NmqttOutbound newest;
+	for (int i = 0; i < 15; ++i) { newest.push(frame(MQTT_PUBLISH, i)); }
+	expected = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	if (newest.droppedCount() != 5 || drain(newest, 1000) != expected) {
+		std::cerr << "Drop-newest policy failed." << std::endl;
+		return 1;
+	}
+	
+	limits.qos0Policy = NMQTT_DROP_DISCONNECT;
+	NmqttOutbound::setLimits(limits);
+	NmqttOutbound disconnect;
+	for (int i = 0; i < 10; ++i) { disconnect.push(frame(MQTT_PUBLISH, i)); }
+	if (disconnect.push(frame(MQTT_PUBLISH, 10))) {
+		std::cerr << "Disconnect policy failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully applied drop-newest and disconnect policies." << std::endl;
+	
+	// Messages sharing a body are sent as their own header followed by the body, also when a
+	// send ends in the middle of either.
+	limits.qos0Policy = NMQTT_DROP_OLDEST;
+	NmqttOutbound::setLimits(limits);
+	NmqttOutbound shared;
+	std::string whole = frame(MQTT_PUBLISH, 0);
+	NmqttSharedBody body = std::make_shared<const std::string>(whole.substr(10));
+	for (int i = 0; i < 5; ++i) {
+		std::string header = frame(MQTT_PUBLISH, i).substr(0, 10);
+		shared.push(NmqttFrame(std::move(header), body));
+	}
+	
+	shared.push(frame(MQTT_PINGRESP, 5));
+	expected = { 0, 1, 2, 3, 4, 5 };
+	if (drain(shared, 7) != expected || body.use_count() != 1) {
+		std::cerr << "Messages with a shared body not sent correctly." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully sent messages with a shared body." << std::endl;
+	
+	// A drain marker is reached once the messages in front of it have been sent, including those
+	// which were held back, and at once when nothing is queued.
+	NmqttFrame marker;
+	marker.drain = true;
+	NmqttOutbound paced;
+	paced.push(std::move(marker));
+	if (!paced.takeDrained() || paced.takeDrained() || !paced.empty()) {
+		std::cerr << "Drain marker on an empty queue not reached." << std::endl;
+		return 1;
+	}
+	
+	for (int i = 0; i < 11; ++i) { paced.push(frame(MQTT_PUBLISH | 0x2, i)); }
+	marker.drain = true;
+	paced.push(std::move(marker));
+	paced.push(frame(MQTT_PUBLISH | 0x2, 11));
+	for (int i = 0; i < 11; ++i) {
+		paced.gather(parts, 2);
+		paced.consume(100);
+		if (paced.takeDrained() != (i == 10)) {
+			std::cerr << "Drain marker reached out of order." << std::endl;
+			return 1;
+		}
+	}
+	
+	expected = { 11 };
+	if (drain(paced, 1000) != expected || paced.takeDrained() || paced.aboveHighWater()) {
+		std::cerr << "Messages behind a drain marker not sent correctly." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully reached drain markers." << std::endl;
+	
+	return 0;
+}
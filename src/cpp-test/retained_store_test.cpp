@@ -0,0 +1,155 @@
+/*
+	retained_store_test.cpp - Test for the NymphMQTT retained message store.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/retained_store.h"
+#include "../cpp/match_cache.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iostream>
+
+
+NmqttSharedBody body(const std::string &text) {
+	return std::make_shared<const std::string>(text);
+}
+
+
+// Collect the topics of the retained messages matching a filter, in chunks of the provided size.
+std::vector<std::string> collect(NmqttRetainedStore &store, std::string filter, size_t chunk) {
+	std::vector<std::string> topics;
+	NmqttRetainedStore::Cursor cursor;
+	std::vector<NmqttRetainedRef> out;
+	while (store.collect(filter, cursor, chunk, out) > 0) {
+		if (out.size() > chunk) { return std::vector<std::string>(); }
+		for (const NmqttRetainedRef &ref : out) { topics.push_back(ref->topic); }
+		out.clear();
+	}
+	
+	return topics;
+}
+
+
+int main() {
+	NmqttRetainedStore store;
+	std::vector<std::string> topics = { "site/1/sensors", "site/1/sensors/temp", "site/1/sensors/hum",
+		"site/2/sensors/temp", "site/2/status", "$SYS/uptime", "other", "other/x", "a//b" };
+	for (const std::string &topic : topics) { store.store(topic, body(topic), 1); }
+	
+	// Wildcards visit only the matching branches, with parents before children.
+	std::vector<std::string> expected = { "site/1/sensors", "site/1/sensors/hum",
+											"site/1/sensors/temp", "site/2/sensors/temp" };
+	if (collect(store, "site/+/sensors/#", 100) != expected
+			|| collect(store, "site/+/sensors/#", 1) != expected) {
+		std::cerr << "Wildcard lookup failed." << std::endl;
+		return 1;
+	}
+	
+	expected = { "$SYS/uptime" };
+	std::vector<std::string> exact = { "site/2/status" };
+	std::vector<std::string> empty = { "a//b" };
+	if (collect(store, "#", 100).size() != topics.size() - 1 || collect(store, "$SYS/#", 2) != expected
+			|| collect(store, "+/uptime", 2).size() != 0 || collect(store, "site/2/status", 2) != exact
+			|| collect(store, "a/+/b", 2) != empty || collect(store, "site/3/#", 2).size() != 0) {
+		std::cerr << "Lookup of '#', '$' topics or exact topics failed." << std::endl;
+		return 1;
+	}
+	
+	// Any chunk size yields every matching message once, as checked against the filter matching
+	// of the match cache.
+	NmqttRetainedStore grid;
+	std::vector<std::string> all;
+	for (int a = 0; a < 5; ++a) {
+		for (int b = 0; b < 5; ++b) {
+			for (int c = 0; c < 5; ++c) {
+				std::string topic = std::to_string(a) + "/" + std::to_string(b) + "/" + std::to_string(c);
+				all.push_back(topic);
+				grid.store(topic, body(topic), 0);
+				if (c == 0) {
+					topic = std::to_string(a) + "/" + std::to_string(b);
+					all.push_back(topic);
+					grid.store(topic, body(topic), 0);
+				}
+			}
+		}
+	}
+	
+	std::vector<std::string> filters = { "#", "1/#", "+/2/#", "+/+/3", "+/+", "4/+/+", "2/3/#",
+											"2/3/4", "+/+/+/#", "9/#" };
+	for (const std::string &filter : filters) {
+		std::multiset<std::string> wanted;
+		for (const std::string &topic : all) {
+			if (NmqttMatchCache::matches(filter, topic)) { wanted.insert(topic); }
+		}
+		
+		for (size_t chunk : { 1, 2, 7, 1000 }) {
+			std::vector<std::string> found = collect(grid, filter, chunk);
+			if (std::multiset<std::string>(found.begin(), found.end()) != wanted) {
+				std::cerr << "Chunked lookup of " << filter << " in chunks of " << chunk
+							<< " failed." << std::endl;
+				return 1;
+			}
+		}
+	}
+	
+	std::cout << "Successfully looked up retained messages." << std::endl;
+	
+	// Changes between chunks: a removed topic is skipped, one added after the cursor is returned,
+	// and none are returned twice.
+	NmqttRetainedStore::Cursor cursor;
+	std::vector<NmqttRetainedRef> out;
+	grid.collect("2/#", cursor, 3, out);
+	if (out.size() != 3 || out[0]->topic != "2/0" || out[2]->topic != "2/0/1") {
+		std::cerr << "First chunk of changing lookup failed." << std::endl;
+		return 1;
+	}
+	
+	grid.remove("2/0/2");
+	grid.remove("2/0/1");
+	grid.store("2/4/9", body("new"), 2);
+	while (grid.collect("2/#", cursor, 4, out) > 0) { }
+	std::set<std::string> seen;
+	for (const NmqttRetainedRef &ref : out) { seen.insert(ref->topic); }
+	if (out.size() != 31 - 2 + 1 || seen.size() != out.size() || seen.count("2/0/2")
+			|| !seen.count("2/4/9") || out.back()->qos != 2 || *out.back()->payload != "new") {
+		std::cerr << "Lookup with changes between chunks failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully continued lookup across changes." << std::endl;
+	
+	// Payloads are shared, replacing a message updates the usage, and an empty payload removes it.
+	NmqttSharedBody shared = body(std::string(1000, 'p'));
+	store.store("site/2/status", shared, 0);
+	out.clear();
+	NmqttRetainedStore::Cursor single;
+	store.collect("site/2/status", single, 10, out);
+	NmqttRetainedStats stats = store.getStats();
+	if (out.size() != 1 || out[0]->payload != shared || stats.messages != topics.size()
+			|| stats.payloadBytes < 1000 || stats.bytes < stats.payloadBytes) {
+		std::cerr << "Replacing a retained message failed." << std::endl;
+		return 1;
+	}
+	
+	for (const std::string &topic : topics) { store.store(topic, body(""), 0); }
+	stats = store.getStats();
+	if (stats.messages != 0 || stats.nodes != 0 || stats.payloadBytes != 0 || stats.bytes != 0
+			|| collect(store, "#", 10).size() != 0) {
+		std::cerr << "Removing retained messages failed." << std::endl;
+		return 1;
+	}
+	
+	stats = grid.getStats();
+	std::cout << "Successfully removed retained messages (" << stats.messages << " messages, "
+				<< stats.nodes << " nodes, " << stats.bytes << " bytes in second store)."
+				<< std::endl;
+	
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+	session_test.cpp - Test for the message handling of a NymphMQTT server session.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/session.h"
+#include "../cpp/server_connections.h"
+#include "../cpp/dispatcher.h"
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <iostream>
+
+
+std::atomic<int> publishes(0);
+std::atomic<int> subscribes(0);
+
+
+// Wait until the dispatched messages have been handled, or a second has passed.
+bool waitFor(std::atomic<int> &counter, int count) {
+	for (int i = 0; i < 100 && counter < count; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	
+	return counter == count;
+}
+
+
+int main() {
+	NmqttClientSocket core;
+	core.publishHandler = [](uint64_t, NmqttMessage &msg) { publishes++; };
+	core.subscribeHandler = [](uint64_t, NmqttMessage &msg) { subscribes++; };
+	NmqttClientConnections::setCoreParameters(core);
+	Dispatcher::init(1);
+	
+	// PUBLISH to 'a' and SUBSCRIBE to 'a', plus the same with the invalid topic 'a/+' and topic
+	// filter 'a#'.
+	std::string publish({ 0x30, 0x05, 0x00, 0x01, 'a', 'h', 'i' });
+	std::string subscribe({ (char) 0x82, 0x06, 0x00, 0x01, 0x00, 0x01, 'a', 0x00 });
+	std::string badPublish({ 0x30, 0x05, 0x00, 0x03, 'a', '/', '+' });
+	std::string badSubscribe({ (char) 0x82, 0x07, 0x00, 0x01, 0x00, 0x02, 'a', '#', 0x00 });
+	
+	NmqttSession session(Poco::Net::StreamSocket(), 0);
+	std::string data = publish + subscribe;
+	if (!session.processData(data.data(), data.length()) || !waitFor(publishes, 1)
+			|| !waitFor(subscribes, 1)) {
+		std::cerr << "Valid messages were not dispatched." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully dispatched valid messages." << std::endl;
+	
+	// An invalid message closes the session, and neither it nor the messages after it are
+	// dispatched.
+	data = badPublish + publish;
+	if (session.processData(data.data(), data.length()) || waitFor(publishes, 2)) {
+		std::cerr << "Invalid PUBLISH was not rejected." << std::endl;
+		return 1;
+	}
+	
+	NmqttSession other(Poco::Net::StreamSocket(), 0);
+	data = badSubscribe + subscribe;
+	if (other.processData(data.data(), data.length()) || waitFor(subscribes, 2)) {
+		std::cerr << "Invalid SUBSCRIBE was not rejected." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully rejected invalid messages." << std::endl;
+	
+	// A looked up connection stays valid after it was removed, and a handle which was kept after
+	// the disconnect, like that of a subscriber, does not match the connection reusing its slot.
+	uint64_t old;
+	std::shared_ptr<NmqttClientSocket> entry;
+	{
+		NmqttSession closed(Poco::Net::StreamSocket(), 0);
+		old = closed.getHandle();
+		entry = NmqttClientConnections::getSocket(old);
+	}
+	
+	NmqttSession reused(Poco::Net::StreamSocket(), 0);
+	if (!entry || !entry->topicAliases || NmqttClientConnections::getSocket(old)
+			|| reused.getHandle() == old || (uint32_t) reused.getHandle() != (uint32_t) old) {
+		std::cerr << "Handle of a closed connection matches a new connection." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully invalidated the handle of a closed connection." << std::endl;
+	
+	Dispatcher::stop();
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+	socket_options_bench.cpp - Benchmark for the NymphMQTT socket option profiles.
+	
+	Revision 0.
+	
+	Notes:
+			- Runs over loopback, with the default options, the latency profile and the throughput
+				profile set on both ends.
+			- The latency test sends small messages as a separate header and payload, as a TLS
+				connection does, and waits for the echo. With Nagle's algorithm and delayed
+				acknowledgements the payload is held back until the header has been acknowledged.
+			- The throughput test sends a large amount of data in one direction.
+			- Loopback has a low round trip time, so larger buffers matter less here than on a real
+				network.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/socket_options.h"
+
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Net/SocketAddress.h>
+#include <Poco/Exception.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+const int roundTrips = 200;
+const size_t bulkTotal = 512 * 1024 * 1024;
+
+
+// Receive exactly the requested number of bytes.
+bool receiveAll(Poco::Net::StreamSocket &socket, char* data, size_t length) {
+	while (length > 0) {
+		int n = socket.receiveBytes(data, (int) length);
+		if (n <= 0) { return false; }
+		data += n;
+		length -= n;
+	}
+	
+	return true;
+}
+
+
+// Measure the average round trip time in microseconds of a small message sent in two parts.
+double latencyTest(const NmqttSocketOptions &options) {
+	std::string result;
+	Poco::Net::ServerSocket server;
+	server.bind(Poco::Net::SocketAddress("127.0.0.1", 0), true);
+	options.apply(server, result);
+	server.listen(options.listenBacklog);
+	
+	std::thread echo([&server, &options]() {
+		Poco::Net::StreamSocket peer = server.acceptConnection();
+		std::string result;
+		options.apply(peer, result);
+		char msg[66];
+		while (receiveAll(peer, msg, sizeof(msg))) {
+			if (options.quickAck) { NmqttSocketOptions::rearmQuickAck(peer); }
+			peer.sendBytes(msg, 2);
+			peer.sendBytes(msg + 2, sizeof(msg) - 2);
+		}
+	});
+	
+	Poco::Net::StreamSocket client(Poco::Net::SocketAddress::IPv4);
+	if (!options.apply(client, result)) { std::cout << "\t(" << result << ")" << std::endl; }
+	client.connect(server.address());
+	
+	char msg[66] = { 0x30, 64 };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < roundTrips; ++i) {
+		client.sendBytes(msg, 2);
+		client.sendBytes(msg + 2, sizeof(msg) - 2);
+		if (!receiveAll(client, msg, sizeof(msg))) { break; }
+		if (options.quickAck) { NmqttSocketOptions::rearmQuickAck(client); }
+	}
+	
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	client.close();
+	echo.join();
+	
+	return std::chrono::duration<double, std::micro>(end - start).count() / roundTrips;
+}
+
+
+// Measure the throughput in MB/s of a bulk transfer.
+double throughputTest(const NmqttSocketOptions &options) {
+	std::string result;
+	Poco::Net::ServerSocket server;
+	server.bind(Poco::Net::SocketAddress("127.0.0.1", 0), true);
+	options.apply(server, result);
+	server.listen(options.listenBacklog);
+	
+	std::thread sink([&server, &options]() {
+		Poco::Net::StreamSocket peer = server.acceptConnection();
+		std::string result;
+		options.apply(peer, result);
+		std::vector<char> buffer(256 * 1024);
+		while (peer.receiveBytes(buffer.data(), (int) buffer.size()) > 0) { }
+	});
+	
+	Poco::Net::StreamSocket client(Poco::Net::SocketAddress::IPv4);
+	options.apply(client, result);
+	client.connect(server.address());
+	
+	std::vector<char> block(64 * 1024, 'x');
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (size_t sent = 0; sent < bulkTotal; sent += block.size()) {
+		client.sendBytes(block.data(), (int) block.size());
+	}
+	
+	client.shutdownSend();
+	sink.join();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	client.close();
+	
+	double seconds = std::chrono::duration<double>(end - start).count();
+	return (bulkTotal / (1024.0 * 1024.0)) / seconds;
+}
+
+
+int main() {
+	struct Profile {
+		const char* name;
+		NmqttSocketOptions options;
+	};
+	
+	Profile profiles[] = {
+		{ "default", NmqttSocketOptions() },
+		{ "latency", NmqttSocketOptions::latency() },
+		{ "throughput", NmqttSocketOptions::throughput() }
+	};
+	
+	try {
+		for (Profile &profile : profiles) {
+			std::cout << profile.name << ":" << std::endl;
+			std::cout << "\tRound trip: " << latencyTest(profile.options) << " us" << std::endl;
+			std::cout << "\tBulk: " << throughputTest(profile.options) << " MB/s" << std::endl;
+		}
+	}
+	catch (Poco::Exception &e) {
+		std::cerr << "Benchmark failed: " << e.displayText() << std::endl;
+		return 1;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+	socket_writer_test.cpp - Test for the NymphMQTT socket writer class.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/socket_writer.h"
+
+#include <Poco/Net/StreamSocketImpl.h>
+
+#include <string>
+#include <string_view>
+#include <iostream>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+
+
+// Read from the peer until it sees the connection closed. Returns the number of bytes read, or -1
+// if no more data arrives before the connection is closed.
+long readToEnd(int fd) {
+	long total = 0;
+	char buffer[64 * 1024];
+	while (true) {
+		pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 1000) <= 0) { return -1; }
+		
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n == 0) { return total; }
+		if (n < 0) { return -1; }
+		total += n;
+	}
+}
+
+
+int main() {
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		std::cerr << "Failed to create socket pair." << std::endl;
+		return 1;
+	}
+	
+	// A frame which does not fit into the socket buffers, while the peer does not read. The send
+	// times out after writing a part of it.
+	Poco::Net::StreamSocket socket(new Poco::Net::StreamSocketImpl(fds[0]));
+	socket.setBlocking(false);
+	socket.setSendBufferSize(16 * 1024);
+	std::string header(2, 'h');
+	std::string payload(4 * 1024 * 1024, 'p');
+	std::string_view parts[2] = { header, payload };
+	if (NmqttSocketWriter::send(socket, parts, 2)) {
+		std::cerr << "Send did not fail with a full socket buffer." << std::endl;
+		return 1;
+	}
+	
+	// The partly sent frame would misalign the stream, so the connection has been shut down. The
+	// peer gets the partial frame, and then sees the connection closed.
+	long received = readToEnd(fds[1]);
+	if (received <= 0 || received >= (long) (header.length() + payload.length())) {
+		std::cerr << "Connection not closed after a partial send." << std::endl;
+		return 1;
+	}
+	
+	std::string_view next = "next";
+	if (NmqttSocketWriter::send(socket, &next, 1)) {
+		std::cerr << "Send succeeded after a partial send." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully closed the connection after a partial send." << std::endl;
+	
+	close(fds[1]);
+	return 0;
+}
@@ -0,0 +1,294 @@
+/*
+	topic_tree_test.cpp - Test for the NymphMQTT topic tree and SUBSCRIBE messages.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/topic_tree.h"
+#include "../cpp/message.h"
+
+#include "../cpp/epoch.h"
+#include "../cpp/match_cache.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+
+// Returns the matching subscribers for a topic as a string of handle:QoS pairs.
+std::string match(NmqttTopicTree &tree, std::string topic) {
+	std::vector<NmqttSubscriber> subs;
+	tree.match(topic, subs);
+	std::string res;
+	for (NmqttSubscriber &sub : subs) {
+		if (!res.empty()) { res += " "; }
+		res += std::to_string(sub.handle) + ":" + std::to_string(sub.qos);
+	}
+	
+	return res;
+}
+
+
+int main() {
+	NmqttTopicTree tree;
+	tree.subscribe(1, "sport/tennis/player1", 0);
+	tree.subscribe(2, "sport/tennis/+", 1);
+	tree.subscribe(3, "sport/#", 2);
+	tree.subscribe(4, "+/+/player1", 1);
+	tree.subscribe(4, "sport/tennis/player1", 2);
+	tree.subscribe(5, "#", 0);
+	tree.subscribe(6, "$SYS/#", 0);
+	tree.subscribe(7, "sport/+", 0);
+	
+	struct Case {
+		const char* topic;
+		const char* expected;
+	};
+	
+	Case cases[] = {
+		{ "sport/tennis/player1", "1:0 2:1 3:2 4:2 5:0" },
+		{ "sport/tennis/player2", "2:1 3:2 5:0" },
+		{ "sport", "3:2 5:0" },
+		{ "sport/", "3:2 5:0 7:0" },
+		{ "sport/tennis", "3:2 5:0 7:0" },
+		{ "chess/board/player1", "4:1 5:0" },
+		{ "$SYS/broker/load", "6:0" },
+		{ "$SYS", "6:0" },
+		{ "unknown/level", "5:0" }
+	};
+	
+	for (Case &c : cases) {
+		std::string res = match(tree, c.topic);
+		if (res != c.expected) {
+			std::cerr << "Topic " << c.topic << " matched '" << res << "', expected '"
+						<< c.expected << "'." << std::endl;
+			return 1;
+		}
+	}
+	
+	// Subscribing again replaces the QoS, and removed subscriptions prune the tree.
+	if (tree.subscribe(2, "sport/tennis/+", 0) || match(tree, "sport/tennis/x") != "2:0 3:2 5:0") {
+		std::cerr << "Subscription was not replaced." << std::endl;
+		return 1;
+	}
+	
+	if (!tree.unsubscribe(2, "sport/tennis/+") || tree.unsubscribe(2, "sport/tennis/+")
+			|| tree.unsubscribe(1, "sport/tennis/+")) {
+		std::cerr << "Unsubscribe failed." << std::endl;
+		return 1;
+	}
+	
+	tree.removeSession(4);
+	tree.removeSession(5);
+	if (match(tree, "sport/tennis/player1") != "1:0 3:2" || tree.count() != 4) {
+		std::cerr << "Removing sessions failed." << std::endl;
+		return 1;
+	}
+	
+	tree.removeSession(1);
+	tree.removeSession(3);
+	tree.removeSession(6);
+	tree.removeSession(7);
+	tree.subscribe(8, "sport/tennis/player1", 1);
+	if (tree.count() != 1 || match(tree, "sport/tennis/player1") != "8:1") {
+		std::cerr << "Tree not reusable after removing all sessions." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully matched topics." << std::endl;
+	
+	// Cached results are invalidated by changes to matching filters only.
+	NmqttTopicTree cached;
+	cached.subscribe(1, "home/+/temp", 0);
+	cached.subscribe(2, "office/#", 1);
+	match(cached, "home/kitchen/temp");
+	match(cached, "office/a");
+	match(cached, "home/kitchen/temp");
+	cached.subscribe(3, "garden/+", 0);
+	match(cached, "home/kitchen/temp");
+	match(cached, "office/a");
+	cached.subscribe(4, "home/kitchen/#", 2);
+	std::string res = match(cached, "home/kitchen/temp");
+	NmqttMatchCacheStats stats = cached.getCacheStats();
+	if (res != "1:0 4:2" || stats.hits != 3 || stats.misses != 3 || stats.invalidations != 1
+			|| stats.entries != 2) {
+		std::cerr << "Match cache failed: " << res << ", " << stats.hits << " hits, " << stats.misses
+					<< " misses, " << stats.invalidations << " invalidations." << std::endl;
+		return 1;
+	}
+	
+	cached.removeSession(2);
+	if (match(cached, "office/a") != "" || cached.getCacheStats().invalidations != 2) {
+		std::cerr << "Match cache not invalidated by removing a session." << std::endl;
+		return 1;
+	}
+	
+	// Filter matching, as used for invalidation.
+	struct FilterCase {
+		const char* filter;
+		const char* topic;
+		bool expected;
+	};
+	
+	FilterCase filterCases[] = {
+		{ "a/+/c", "a/b/c", true }, { "a/+/c", "a/b/d", false }, { "a/#", "a", true },
+		{ "a/#", "ab", false }, { "#", "$SYS/x", false }, { "$SYS/#", "$SYS/x", true },
+		{ "+", "a/b", false }, { "a/+", "a/", true }, { "+/+", "/a", true }, { "a/b", "a", false }
+	};
+	
+	for (FilterCase &c : filterCases) {
+		if (NmqttMatchCache::matches(c.filter, c.topic) != c.expected) {
+			std::cerr << "Filter " << c.filter << " against " << c.topic << " failed." << std::endl;
+			return 1;
+		}
+	}
+	
+	// Invalidation only removes matching topics, also for batches with many filters and filters
+	// with a wildcard at the first level.
+	NmqttMatchCache cache;
+	std::vector<NmqttSubscriber> none;
+	for (int i = 0; i < 100; ++i) {
+		cache.insert((i % 2 ? "a/" : "b/") + std::to_string(i), none, cache.getGeneration());
+	}
+	
+	std::vector<std::string> many;
+	for (int i = 0; i < 40; ++i) { many.push_back("c/" + std::to_string(i)); }
+	many.push_back("a/1");
+	cache.invalidate(many);
+	NmqttMatchCacheStats cacheStats = cache.getStats();
+	std::vector<NmqttSubscriber> out;
+	if (cacheStats.entries != 99 || cacheStats.invalidations != 1 || cache.lookup("a/1", out)) {
+		std::cerr << "Invalidation with many filters failed." << std::endl;
+		return 1;
+	}
+	
+	cache.invalidate({ "+/99", "b/#" });
+	cacheStats = cache.getStats();
+	if (cacheStats.entries != 48 || cache.lookup("a/99", out) || cache.lookup("b/98", out)
+			|| !cache.lookup("a/97", out)) {
+		std::cerr << "Invalidation with wildcard filters failed." << std::endl;
+		return 1;
+	}
+	
+	// Entries which are evicted leave their first level group.
+	NmqttMatchCache small(16);
+	for (int i = 0; i < 100; ++i) {
+		small.insert((i % 2 ? "a/" : "b/") + std::to_string(i), none, small.getGeneration());
+	}
+	
+	small.invalidate({ "a/#" });
+	cacheStats = small.getStats();
+	if (cacheStats.entries == 0 || cacheStats.evictions != 100 - cacheStats.entries 
+										- cacheStats.invalidations || small.lookup("a/99", out)) {
+		std::cerr << "Invalidation after evictions failed." << std::endl;
+		return 1;
+	}
+	
+	small.invalidate({ "#" });
+	if (small.getStats().entries != 0) {
+		std::cerr << "Invalidation with '#' failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully cached matches." << std::endl;
+	
+	// Lookups during a mass resubscribe always find the stable subscriptions, and see each of the
+	// changing ones either subscribed or not.
+	NmqttTopicTree busy;
+	busy.subscribe(1, "fleet/+/status", 1);
+	busy.subscribe(2, "fleet/#", 0);
+	std::atomic<bool> running(true);
+	std::atomic<int> failures(0);
+	std::atomic<int> lookups(0);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; ++r) {
+		readers.emplace_back([&busy, &running, &failures, &lookups, r]() {
+			std::vector<NmqttSubscriber> subs;
+			for (int i = 0; running; ++i) {
+				std::string topic = "fleet/" + std::to_string((i + r) % 500) + "/status";
+				busy.match(topic, subs);
+				if (subs.size() < 2 || subs.size() > 3 || subs[0].handle != 1 
+						|| subs[1].handle != 2) { failures++; }
+				lookups++;
+			}
+		});
+	}
+	
+	std::vector<std::thread> writers;
+	for (int w = 0; w < 4; ++w) {
+		writers.emplace_back([&busy, w]() {
+			for (int round = 0; round < 5; ++round) {
+				for (int i = w; i < 500; i += 4) {
+					busy.subscribe(100 + i, "fleet/" + std::to_string(i) + "/status", 1);
+				}
+				
+				for (int i = w; i < 500; i += 4) { busy.removeSession(100 + i); }
+			}
+		});
+	}
+	
+	for (std::thread &t : writers) { t.join(); }
+	running = false;
+	for (std::thread &t : readers) { t.join(); }
+	NmqttEpoch::reclaim();
+	
+	// No stale results remain cached.
+	for (int i = 0; i < 500; ++i) {
+		if (match(busy, "fleet/" + std::to_string(i) + "/status") != "1:1 2:0") { failures++; }
+	}
+	
+	if (failures > 0 || busy.count() != 2 || NmqttEpoch::pending() != 0) {
+		std::cerr << "Concurrent lookups failed: " << failures << " of " << lookups << "." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully looked up topics while changing subscriptions (" << lookups << " lookups)." << std::endl;
+	
+	// SUBSCRIBE with two topic filters, packet ID 0x1234.
+	std::string sub({ (char) 0x82, 0x0E, 0x12, 0x34, 0x00, 0x03, 'a', '/', 'b', 0x01,
+						0x00, 0x03, 'c', '/', '#', 0x02 });
+	NmqttMessage msg;
+	msg.parseMessage(sub);
+	std::string_view filter;
+	uint8_t options;
+	if (!msg.valid() || msg.getPacketID() != 0x1234 || msg.getTopicFilterCount() != 2
+			|| !msg.getTopicFilter(1, filter, options) || filter != "c/#" || options != 2) {
+		std::cerr << "Failed to parse SUBSCRIBE message." << std::endl;
+		return 1;
+	}
+	
+	// Invalid flags, options and filters are rejected.
+	std::string bad[] = {
+		std::string({ (char) 0x80, 0x06, 0x12, 0x34, 0x00, 0x01, 'a', 0x00 }),
+		std::string({ (char) 0x82, 0x06, 0x12, 0x34, 0x00, 0x01, 'a', 0x03 }),
+		std::string({ (char) 0x82, 0x07, 0x12, 0x34, 0x00, 0x02, 'a', '#', 0x00 }),
+		std::string({ (char) 0x82, 0x02, 0x12, 0x34 })
+	};
+	
+	for (std::string &b : bad) {
+		NmqttMessage m;
+		m.parseMessage(b);
+		if (m.valid()) {
+			std::cerr << "Invalid SUBSCRIBE message accepted." << std::endl;
+			return 1;
+		}
+	}
+	
+	NmqttMessage ack(MQTT_SUBACK);
+	ack.setPacketID(0x1234);
+	ack.setReasonCodes(std::string({ 0x01, (char) 0x80 }));
+	std::string expected({ (char) 0x90, 0x04, 0x12, 0x34, 0x01, (char) 0x80 });
+	if (ack.serialize() != expected) {
+		std::cerr << "Failed to serialise SUBACK message." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "Successfully parsed SUBSCRIBE and serialised SUBACK." << std::endl;
+	
+	return 0;
+}
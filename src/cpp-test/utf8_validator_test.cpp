@@ -0,0 +1,86 @@
+/*
+	utf8_validator_test.cpp - Test for the NymphMQTT UTF-8 and topic validator.
+	
+	Revision 0.
+	
+	2026/10/17, Maya Posch
+*/
+
+
+#include "../cpp/utf8_validator.h"
+
+#include <string>
+#include <random>
+#include <iostream>
+
+
+int main() {
+	// Known strings, checked with the scalar and the vectorised scan.
+	struct { std::string str; uint32_t flags; } cases[] = {
+		{ "", 0 },
+		{ "a/b/c", NMQTT_SCAN_SLASH },
+		{ "sensors/+/temperature/#", NMQTT_SCAN_SLASH | NMQTT_SCAN_PLUS | NMQTT_SCAN_HASH },
+		{ "caf\xC3\xA9/\xE2\x82\xAC/\xF0\x9F\x98\x80", NMQTT_SCAN_SLASH },
+		{ std::string("a\0b", 3), NMQTT_SCAN_INVALID },
+		{ "\xC0\xAF", NMQTT_SCAN_INVALID },				// Overlong '/'.
+		{ "\xED\xA0\x80", NMQTT_SCAN_INVALID },			// Surrogate.
+		{ "\xF4\x90\x80\x80", NMQTT_SCAN_INVALID },		// Beyond U+10FFFF.
+		{ "abc\xE2\x82", NMQTT_SCAN_INVALID }			// Truncated.
+	};
+	
+	for (auto &c : cases) {
+		// Place each case at every offset within a longer ASCII string, to cross the block sizes.
+		for (size_t pad = 0; pad < 40; ++pad) {
+			std::string str = std::string(pad, 'x') + c.str + std::string(pad, 'y');
+			uint32_t flags = NmqttUtf8Validator::scan(str);
+			if (flags != c.flags || NmqttUtf8Validator::scanScalar(str.data(), str.length()) != flags) {
+				std::cerr << "Unexpected flags 0x" << std::hex << flags << " for case '" << c.str
+							<< "' with padding " << std::dec << pad << std::endl;
+				return 1;
+			}
+		}
+	}
+	
+	// Random strings, mostly ASCII with some multi-byte and invalid bytes. Both scans have to agree.
+	std::mt19937 rng(42);
+	const char* pieces[] = { "a", "/", "+", "#", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\x80" };
+	for (int i = 0; i < 20000; ++i) {
+		std::string str;
+		size_t len = rng() % 100;
+		while (str.length() < len) {
+			uint32_t r = rng() % 100;
+			str += (r < 80) ? pieces[0] : pieces[1 + (r % 7)];
+		}
+		
+		if (NmqttUtf8Validator::scan(str) != NmqttUtf8Validator::scanScalar(str.data(), str.length())) {
+			std::cerr << "Scan mismatch for random string " << i << std::endl;
+			return 1;
+		}
+	}
+	
+	// Topic filters.
+	const char* goodFilters[] = { "#", "+", "a/+/b", "a/#", "+/+", "/a" };
+	const char* badFilters[] = { "", "a#", "a/#/b", "a+/b", "a/+b" };
+	for (const char* f : goodFilters) {
+		if (!NmqttUtf8Validator::validTopicFilter(f)) {
+			std::cerr << "Rejected valid filter: " << f << std::endl;
+			return 1;
+		}
+	}
+	
+	for (const char* f : badFilters) {
+		if (NmqttUtf8Validator::validTopicFilter(f)) {
+			std::cerr << "Accepted invalid filter: " << f << std::endl;
+			return 1;
+		}
+	}
+	
+	if (NmqttUtf8Validator::validTopicName("a/+") || !NmqttUtf8Validator::validTopicName("a/b")) {
+		std::cerr << "Topic name check failed." << std::endl;
+		return 1;
+	}
+	
+	std::cout << "UTF-8 validator tests passed." << std::endl;
+	
+	return 0;
+}
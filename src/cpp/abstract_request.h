@@ -23,6 +23,7 @@ class AbstractRequest {
 	//
 	
 public:
+	virtual ~AbstractRequest() { }
 	virtual void setValue(std::string value) = 0;
 	virtual void process() = 0;
 	virtual void finish() = 0;
@@ -15,104 +15,79 @@
 
 #include "bytebauble.h"
 
-#include <iostream>
 
+// Static initialisations.
+// Mask for the bytes of a packed integer of the indexed length.
+const uint32_t ByteBauble::lengthMasks[5] = { 0x0, 0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF };
 
-// --- CONSTRUCTOR ---
-ByteBauble::ByteBauble() {
-	// Perform host endianness detection.
-	detectHostEndian();
-}
+// Continuation bits for a packed integer of the indexed length.
+const uint32_t ByteBauble::continuationBits[5] = { 0x0, 0x0, 0x80, 0x8080, 0x808080 };
 
 
-// --- DETECT HOST ENDIAN ---
-// Perform a check for the endianness of the host system.
-void ByteBauble::detectHostEndian() {
-	// This check uses a single 16-bit integer, using it as a single byte after assignment.
-	// Depending on which byte the (<255) value ended up on, we can determine the host endianness.
-	uint16_t bytes = 1;
-	if (*((uint8_t*) &bytes) == 1) {
-		// Detected little endian.
-		//std::cout << "Detected Host Little Endian." << std::endl;
-		hostEndian = BB_LE;
-	}
-	else {
-		// Detected big endian.
-		//std::cout << "Detected Host Big Endian." << std::endl;
-		hostEndian = BB_BE;
-	}
+// --- CTZ ---
+// Count trailing zero bits. The input must not be zero.
+static inline uint32_t ctz(uint32_t in) {
+#if defined(__GNUC__) || defined(__MINGW32__) || defined(__MINGW64__)
+	return __builtin_ctz(in);
+#elif defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, in);
+	return idx;
+#else
+	uint32_t count = 0;
+	while (!(in & 1)) { in >>= 1; count++; }
+	return count;
+#endif
 }
 
 
+
 // --- READ PACKED INT ---
 // Packed integer format that uses the MSB of each byte to indicate that another byte follows.
-// This method supports the input of a single unsigned 32-bit integer.
+// This method supports the input of a single unsigned 32-bit integer, with the first byte of the
+// packed integer in the least significant byte.
 // Second parameter and output is a 32-bit integer, of which at most 28 bits can contain a value from the 
 // packed integer.
 // Return value is the number of bytes in the packed integer.
 uint32_t ByteBauble::readPackedInt(uint32_t packed, uint32_t &output) {
-	// Check the special bits while copying the data bits.
-	output = 0;
-	int idx = 0; 	// Index into output integer.
-	int src = 0; 	// Index into input packed integer.
-	int i;
-	for (i = 0; i < 4; ++i) {
-		// Copy data bits of current byte.
-		for (int j = 0; j < 7; ++j) {
-			if ((packed >> src++) & 1UL) {
-				output |= (1UL << idx++);
-			}
-			else {
-				//output &= ~(1UL << idx++);
-				idx++;
-			}
-		}
-		
-		// Check for presence of follow-up byte.
-		if (!((packed >> src++) & 1UL)) {
-			// Not found, we're done.
-			break;
-		}
-	}
+	// The first byte without its continuation bit set ends the packed integer. Without such a byte
+	// the integer spans the maximum of four bytes.
+	uint32_t stop = ~packed & 0x80808080;
+	uint32_t bytes = 4;
+	if (stop) { bytes = (ctz(stop) >> 3) + 1; }
 	
-	return i + 1;
+	// Mask off the bytes that are not part of the packed integer, along with the continuation 
+	// bits, then collapse the remaining 7-bit groups.
+	uint32_t data = packed & lengthMasks[bytes] & 0x7F7F7F7F;
+	output = (data & 0x7F) 
+				| ((data >> 1) & 0x3F80) 
+				| ((data >> 2) & 0x1FC000) 
+				| ((data >> 3) & 0xFE00000);
+	
+	return bytes;
 }
 
 
 // --- WRITE PACKED INT ---
+// Writes the integer as packed integer into the output, with the first byte in the least 
+// significant byte. Returns the number of bytes in the packed integer, or 0 if the integer is out of
+// range (more than 28 bits).
 uint32_t ByteBauble::writePackedInt(uint32_t integer, uint32_t &output) {
-	// First determine how many bytes we will be needing.
-	uint32_t totalBytes = 0;
-	if (integer <= 0x80) { totalBytes = 1; }
-	else if (integer <= 0x4000) { totalBytes = 2; }
-	else if (integer <= 0x200000) { totalBytes = 3; }
-	else if (integer <= 0x10000000) { totalBytes = 4; }
-	else {
+	if (integer >= 0x10000000) {
 		// Out of range, return error.
 		return 0;
 	}
 	
-	// Copy the source data bits to as many packed bytes as needed.
-	output = 0;
-	int idx = 0;	// Index into packed (output) integer.
-	int src = 0; 	// Index into source integer.
-	for (int i = 0; i < totalBytes; ++i) {
-		//
-		for (int j = 0; j < 7; ++j) {
-			if ((integer >> src++) & 1UL) {
-				output |= (1UL << idx++);
-			}
-			else {
-				//output &= ~(1UL << idx++);
-				idx++;
-			}
-		}
-			
-		// Check for follow-up byte and set if necessary.
-		if ((i + 1) < totalBytes) {
-			output |= (1UL << idx++);
-		}
-	}
+	// Determine how many bytes we will be needing.
+	uint32_t totalBytes = 1 + (integer >= 0x80) + (integer >= 0x4000) + (integer >= 0x200000);
+	
+	// Spread the 7-bit groups over the bytes, then set the continuation bit on all but the last
+	// byte.
+	output = (integer & 0x7F) 
+				| ((integer << 1) & 0x7F00) 
+				| ((integer << 2) & 0x7F0000) 
+				| ((integer << 3) & 0x7F000000);
+	output |= continuationBits[totalBytes];
 	
 	return totalBytes;
 }
@@ -23,6 +23,7 @@
 
 #ifdef _MSC_VER
 #include <stdlib.h>
+#include <intrin.h>
 #endif
 
 
@@ -32,103 +33,91 @@ enum BBEndianness {
 };
 
 
+// Host endianness is determined at compile time. MSVC only targets little endian platforms.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BB_HOST_ENDIAN BB_BE
+#else
+#define BB_HOST_ENDIAN BB_LE
+#endif
+
+
 class ByteBauble {
 	BBEndianness globalEndian = BB_LE;
-	BBEndianness hostEndian = BB_LE;
-	
-public:
-	ByteBauble();
-	
-	void detectHostEndian();
-	BBEndianness getHostEndian() { return hostEndian; }
-	
-	static uint32_t readPackedInt(uint32_t packed, uint32_t &output);
-	static uint32_t writePackedInt(uint32_t integer, uint32_t &output);
-	
-	void setGlobalEndianness(BBEndianness end) { globalEndian = end; }
+	static constexpr BBEndianness hostEndian = BB_HOST_ENDIAN;
+	static const uint32_t lengthMasks[5];
+	static const uint32_t continuationBits[5];
 	
-	// --- TO GLOBAL ---
-	// 
+	// --- SWAP ---
+	// Flip the bytes, so that the MSB and LSB are switched.
+	// Compiler intrinsics in GCC/MinGW exist since ~4.3, for MSVC
 	template <typename T>
-	T toGlobal(T in, BBEndianness end) {
-		// Convert to requested format, if different from global.
-		if (end == globalEndian) {
-			// Endianness matches, return input.
+	static T swap(T in) {
+		if constexpr (sizeof(T) == 1) {
 			return in;
 		}
-		
-		// Perform the conversion.
-		// Flip the bytes, so that the MSB and LSB are switched.
-		// Compiler intrinsics in GCC/MinGW exist since ~4.3, for MSVC
-		std::size_t bytesize = sizeof(in);
 #if defined(__GNUC__) || defined(__MINGW32__) || defined(__MINGW64__)
-		if (bytesize == 2) {
+		else if constexpr (sizeof(T) == 2) {
 			return __builtin_bswap16(in);
 		}
-		else if (bytesize == 4) {
+		else if constexpr (sizeof(T) == 4) {
 			return __builtin_bswap32(in);
 		}
-		else if (bytesize == 8) {
+		else if constexpr (sizeof(T) == 8) {
 			return __builtin_bswap64(in);
 		}
 #elif defined(_MSC_VER)
-		if (bytesize == 2) {
+		else if constexpr (sizeof(T) == 2) {
 			return _byteswap_ushort(in);
 		}
-		else if (bytesize == 4) {
+		else if constexpr (sizeof(T) == 4) {
 			return _byteswap_ulong(in);
 		}
-		else if (bytesize == 8) {
+		else if constexpr (sizeof(T) == 8) {
 			return _byteswap_uint64(in);
 		}
 #endif
-
-		// Fallback for other compilers.
-		// TODO: implement.
-		return 0;
+		else {
+			// Fallback for other compilers.
+			T out = 0;
+			for (std::size_t i = 0; i < sizeof(T); ++i) {
+				out = (out << 8) | ((in >> (i * 8)) & 0xFF);
+			}
+			
+			return out;
+		}
 	}
 	
-	// --- TO HOST ---
-	// 
+public:
+	static constexpr BBEndianness getHostEndian() { return hostEndian; }
+	
+	static uint32_t readPackedInt(uint32_t packed, uint32_t &output);
+	static uint32_t writePackedInt(uint32_t integer, uint32_t &output);
+	
+	void setGlobalEndianness(BBEndianness end) { globalEndian = end; }
+	
+	// --- TO GLOBAL ---
+	// Convert to the global endianness, if different from the provided one.
 	template <typename T>
-	T toHost(T in, BBEndianness end) {
-		// 
+	T toGlobal(T in, BBEndianness end) {
+		if (end == globalEndian) {
+			// Endianness matches, return input.
+			return in;
+		}
 		
-		// Convert to requested format, if different from host.
+		return swap(in);
+	}
+	
+	// --- TO HOST ---
+	// Convert to the host endianness, if different from the provided one. As the host endianness
+	// is a compile-time constant, this reduces to either a no-op or a byte swap.
+	template <typename T>
+	static T toHost(T in, BBEndianness end) {
 		if (end == hostEndian) {
 			// Endianness matches, return input.
 			return in;
 		}
 		
-		// Perform the conversion.
-		// Flip the bytes, so that the MSB and LSB are switched.
-		// Compiler intrinsics in GCC/MinGW exist since ~4.3, for MSVC
-		std::size_t bytesize = sizeof(in);
-#if defined(__GNUC__) || defined(__MINGW32__) || defined(__MINGW64__)
-		if (bytesize == 2) {
-			return __builtin_bswap16(in);
-		}
-		else if (bytesize == 4) {
-			return __builtin_bswap32(in);
-		}
-		else if (bytesize == 8) {
-			return __builtin_bswap64(in);
-		}
-#elif defined(_MSC_VER)
-		if (bytesize == 2) {
-			return _byteswap_ushort(in);
-		}
-		else if (bytesize == 4) {
-			return _byteswap_ulong(in);
-		}
-		else if (bytesize == 8) {
-			return _byteswap_uint64(in);
-		}
-#endif
-
-		// Fallback for other compilers.
-		// TODO: implement.
-		return 0;
+		return swap(in);
 	}
 };
 
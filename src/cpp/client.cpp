@@ -17,6 +17,7 @@
 #include "client_listener_manager.h"
 #include "connections.h"
 #include "dispatcher.h"
+#include "socket_writer.h"
 
 #include <Poco/Net/NetException.h>
 #include <Poco/NumberFormatter.h>
@@ -32,6 +33,18 @@ NmqttClient::NmqttClient() {
 }
 
 
+// --- DECONSTRUCTOR ---
+NmqttClient::~NmqttClient() {
+	for (int i = 0; i < slotBlockCount; ++i) {
+		delete[] slotBlocks[i].load();
+	}
+	
+	tlsSessions.clear();
+	tlsContext = 0;
+	if (sslInitialized) { Poco::Net::uninitializeSSL(); }
+}
+
+
 // --- INIT ---
 // Initialise the runtime and sets the logger function to be used by the Nymph 
 // Logger class, along with the desired maximum log level:
@@ -81,22 +94,32 @@ void NmqttClient::setMessageHandler(std::function<void(int, std::string, std::st
 }
 
 
+// --- SET MESSAGE VIEW HANDLER ---
+// Set the callback function that will be called every time a message is received from the broker,
+// with the topic and payload as views into the received message, instead of copies. The views are
+// only valid until the callback returns. Used instead of the message handler when set.
+void NmqttClient::setMessageViewHandler(std::function<void(int, std::string_view, 
+											std::string_view)> handler) {
+	messageViewHandler = handler;
+}
+
+
 // --- SHUTDOWN ---
 // Shutdown the runtime. Close any open connections and clean up resources.
 bool NmqttClient::shutdown() {
 	socketsMutex.lock();
-	map<int, Poco::Net::StreamSocket*>::iterator it;
-	for (it = sockets.begin(); it != sockets.end(); ++it) {
-		// Remove socket from listener.
-		NmqttClientListenerManager::removeConnection(it->first);
+	int handleCount = lastHandle;
+	socketsMutex.unlock();
+	
+	for (int handle = 0; handle < handleCount; ++handle) {
+		NmqttClientSlot* slot = getSlot(handle);
+		if (!slot || !slot->active.load(std::memory_order_acquire)) { continue; }
 		
-		// TODO: try/catch. 
-		it->second->shutdown();
+		// Remove socket from listener.
+		NmqttClientListenerManager::removeConnection(handle);
+		releaseSlot(handle);
 	}
 	
-	sockets.clear();
-	socketsMutex.unlock();
-	
 	NmqttClientListenerManager::stop();
 	
 	return true;
@@ -107,36 +130,57 @@ bool NmqttClient::shutdown() {
 // Create a new connection with the remote MQTT server and return a handle for
 // the connection.
 bool NmqttClient::connect(string host, int port, int &handle, void* data, 
-							NmqttBrokerConnection &conn, string &result) {
+							NmqttBrokerConnection &conn, string &result, 
+							const NmqttSocketOptions &options) {
 	Poco::Net::SocketAddress sa(host, port);
-	return connect(sa, handle, data, conn, result);
+	return connect(sa, handle, data, conn, result, options);
 }
 
 
 bool NmqttClient::connect(string url, int &handle, void* data, 
-							NmqttBrokerConnection &conn, string &result) {
+							NmqttBrokerConnection &conn, string &result, 
+							const NmqttSocketOptions &options) {
 	Poco::Net::SocketAddress sa(url);
-	return connect(sa, handle, data, conn, result);
+	return connect(sa, handle, data, conn, result, options);
 }
 
 
+// The socket options are set before connecting, so that the buffer sizes apply to the TCP
+// handshake. TLS sockets only get their options once connected.
 bool NmqttClient::connect(Poco::Net::SocketAddress sa, int &handle,  void* data,
-							NmqttBrokerConnection &conn, string &result) {
+							NmqttBrokerConnection &conn, string &result, 
+							const NmqttSocketOptions &options) {
 	using namespace std::placeholders;
 	NymphSocket ns;
+	std::string optionsResult;
+	std::string sessionKey;
 	try {
 		if (secureConnection) {
-			Poco::Net::initializeSSL();
+			// Resume the last TLS session with this broker, if any, to skip the full handshake.
+			sessionKey = sa.toString();
+			Poco::Net::Session::Ptr session = getTlsSession(sessionKey);
 			ns.secure = true;
-			ns.context = new Poco::Net::Context(Poco::Net::Context::CLIENT_USE,
-												key,
-												cert,
-												ca);
-			ns.socket = new Poco::Net::SecureStreamSocket(sa, ns.context);
+			ns.context = tlsContext;
+			Poco::Net::SecureStreamSocket* socket;
+			if (session) { socket = new Poco::Net::SecureStreamSocket(sa, tlsContext, session); }
+			else { socket = new Poco::Net::SecureStreamSocket(sa, tlsContext); }
+			
+			ns.socket = socket;
+			if (socket->sessionWasReused()) { NYMPH_LOG_DEBUG("Resumed TLS session."); }
+			storeTlsSession(sessionKey, socket);
+			if (!options.apply(*ns.socket, optionsResult)) {
+				NYMPH_LOG_WARNING("Failed to set socket options: " + optionsResult);
+			}
 		}
 		else {
 			ns.secure = false;
-			ns.socket = new Poco::Net::StreamSocket(sa);
+			Poco::Net::StreamSocket socket(sa.family());
+			if (!options.apply(socket, optionsResult)) {
+				NYMPH_LOG_WARNING("Failed to set socket options: " + optionsResult);
+			}
+			
+			socket.connect(sa);
+			ns.socket = new Poco::Net::StreamSocket(socket);
 		}
 	}
 	catch (Poco::Net::ConnectionRefusedException &ex) {
@@ -153,36 +197,73 @@ bool NmqttClient::connect(Poco::Net::SocketAddress sa, int &handle,  void* data,
 		return false;
 	}
 	catch (Poco::Net::NetException &ex) {
+		// Includes TLS handshake failures. Do not offer the cached session again.
+		if (!sessionKey.empty()) {
+			tlsSessionsMutex.lock();
+			tlsSessions.erase(sessionKey);
+			tlsSessionsMutex.unlock();
+		}
+		
 		result = "Net exception: " + ex.displayText();
 		return false;
 	}
 	
-	socketsMutex.lock();
-	sockets.insert(pair<int, Poco::Net::StreamSocket*>(lastHandle, ns.socket));
-	ns.semaphore = new Semaphore(0, 1);
-	socketSemaphores.insert(pair<int, Poco::Semaphore*>(lastHandle, ns.semaphore));
+	int newHandle;
+	NmqttClientSlot* slot = allocateSlot(newHandle);
+	if (!slot) {
+		result = "Too many connections.";
+		delete ns.socket;
+		return false;
+	}
+	
 	ns.data = data;
-	ns.handle = lastHandle;
+	ns.handle = newHandle;
+	ns.version = mqttVersion;
+	ns.topicAliases = std::make_shared<NmqttOutboundAliases>();
+	ns.topicAliasMaximum = (mqttVersion == MQTT_PROTOCOL_VERSION_5) ? topicAliasMaximum : 0;
+	ns.receiveBufferSize = receiveBufferSize;
+	ns.receiveBufferMax = receiveBufferMax;
+	ns.quickAck = options.quickAck;
 	ns.handler = messageHandler;
+	ns.viewHandler = messageViewHandler;
 	ns.connackHandler = std::bind(&NmqttClient::connackHandler, this, _1, _2, _3);
 	ns.pingrespHandler = std::bind(&NmqttClient::pingrespHandler, this, _1);
+	ns.protocolErrorHandler = std::bind(&NmqttClient::protocolErrorHandler, this, _1, _2);
 	NmqttConnections::addSocket(ns);
-	if (!NmqttClientListenerManager::addConnection(lastHandle)) { return false; }
-	handle = lastHandle++;
-	socketsMutex.unlock();
+	
+	slot->sendMutex.lock();
+	slot->socket = ns.socket;
+	slot->topicAliases = ns.topicAliases;
+	slot->tlsSessionKey = sessionKey;
+	slot->sendMutex.unlock();
+	slot->active.store(true, std::memory_order_release);
+	
+	if (!NmqttClientListenerManager::addConnection(newHandle)) {
+		result = "Failed to add connection to listener.";
+		releaseSlot(newHandle);
+		return false;
+	}
+	
+	handle = newHandle;
 	
 	NYMPH_LOG_DEBUG("Added new connection with handle: " + NumberFormatter::format(handle));
 	
 	// Send Connect message using the previously set data.
 	brokerConn = 0;
 	NmqttMessage msg(MQTT_CONNECT);
+	msg.setProtocolVersion(mqttVersion);
+	if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && topicAliasMaximum > 0) {
+		// Allow the broker to use topic aliases for the messages it sends us.
+		msg.setProperty(MQTT_PROP_TOPIC_ALIAS_MAXIMUM, topicAliasMaximum);
+	}
+	
 	if (willFlag) { msg.setWill(willTopic, will, willQoS, willRetainFlag); }
 	if (usernameFlag) { msg.setCredentials(username, password); }
 	msg.setClientId(clientId);
 	
 	NYMPH_LOG_INFORMATION("Sending CONNECT message.");
 	
-	if (!sendMessage(handle, msg.serialize())) {
+	if (!sendMessage(handle, msg.serializeLocal())) {
 		return false;
 	}
 	
@@ -223,43 +304,24 @@ bool NmqttClient::disconnect(int handle, string &result) {
 	NmqttMessage msg(MQTT_DISCONNECT);
 	//msg.setWill(will);
 	
-	sendMessage(handle, msg.serialize());
+	sendMessage(handle, msg.serializeLocal());
 	
 	// FIXME: wait here?
 	
-	map<int, Poco::Net::StreamSocket*>::iterator it;
-	map<int, Poco::Semaphore*>::iterator sit;
-	socketsMutex.lock();
-	it = sockets.find(handle);
-	if (it == sockets.end()) { 
+	NmqttClientSlot* slot = getSlot(handle);
+	if (!slot || !slot->active.load(std::memory_order_acquire)) { 
 		result = "Provided handle " + NumberFormatter::format(handle) + " was not found.";
-		socketsMutex.unlock();
 		return false; 
 	}
 	
-	sit = socketSemaphores.find(handle);
-	if (sit == socketSemaphores.end()) {
-		result = "No semaphore found for socket handle.";
-		socketsMutex.unlock();
+	// Remove socket from listener. Once this returns, the socket is no longer used by the 
+	// listener and it can be closed and deleted.
+	NmqttClientListenerManager::removeConnection(handle);
+	if (!releaseSlot(handle)) {
+		result = "Provided handle " + NumberFormatter::format(handle) + " was not found.";
 		return false;
 	}
 	
-	// TODO: try/catch.
-	// Shutdown socket. Set the semaphore once done to signal that the socket's 
-	// listener thread that it's safe to delete the socket.
-	it->second->shutdown();
-	it->second->close();
-	if (sit->second) { sit->second->set(); }
-	
-	// Remove socket from listener.
-	NmqttClientListenerManager::removeConnection(it->first);
-	
-	// Remove socket references from both maps.
-	sockets.erase(it);
-	socketSemaphores.erase(sit);
-	
-	socketsMutex.unlock();
-	
 	NYMPH_LOG_DEBUG("Removed connection with handle: " + NumberFormatter::format(handle));
 	
 	return true;
@@ -286,43 +348,202 @@ void NmqttClient::setWill(std::string topic, std::string will, uint8_t qos, bool
 
 
 // --- SET TLS ---
-void NmqttClient::setTLS(std::string &ca, std::string &cert, std::string &key) {
-	this->ca = ca;
-	this->cert = cert;
-	this->key = key;
+// Creates the TLS context which is shared by all following connections, loading the CA, 
+// certificate and key once. Returns false if these could not be loaded.
+bool NmqttClient::setTLS(std::string &ca, std::string &cert, std::string &key) {
+	if (!sslInitialized) {
+		Poco::Net::initializeSSL();
+		sslInitialized = true;
+	}
+	
+	try {
+		tlsContext = new Poco::Net::Context(Poco::Net::Context::CLIENT_USE, key, cert, ca);
+		tlsContext->enableSessionCache(true);
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_ERROR("Failed to create TLS context: " + e.displayText());
+		tlsContext = 0;
+		secureConnection = false;
+		return false;
+	}
+	
+	// Sessions of the previous context cannot be resumed with the new one.
+	tlsSessionsMutex.lock();
+	tlsSessions.clear();
+	tlsSessionsMutex.unlock();
+	
 	secureConnection = true;
+	return true;
+}
+
+
+// --- GET TLS SESSION ---
+// Returns the cached TLS session for a broker address, or null.
+Poco::Net::Session::Ptr NmqttClient::getTlsSession(const std::string &key) {
+	Poco::Mutex::ScopedLock lock(tlsSessionsMutex);
+	std::map<std::string, Poco::Net::Session::Ptr>::iterator it = tlsSessions.find(key);
+	if (it == tlsSessions.end()) { return 0; }
+	return it->second;
+}
+
+
+// --- STORE TLS SESSION ---
+// Caches the current TLS session of a connection, for resumption by the next connection to the 
+// same broker address. This is done after connecting, and again before closing, as TLS 1.3 
+// session tickets are only received after the handshake.
+void NmqttClient::storeTlsSession(const std::string &key, Poco::Net::StreamSocket* socket) {
+	Poco::Net::SecureStreamSocket* secure = dynamic_cast<Poco::Net::SecureStreamSocket*>(socket);
+	if (!secure) { return; }
+	
+	Poco::Net::Session::Ptr session;
+	try {
+		session = secure->currentSession();
+	}
+	catch (Poco::Exception &e) {
+		return;
+	}
+	
+	if (!session) { return; }
+	
+	Poco::Mutex::ScopedLock lock(tlsSessionsMutex);
+	tlsSessions[key] = session;
+}
+
+
+// --- SET RECEIVE BUFFER SIZE ---
+// Sets the initial size of the receive buffer of new connections, and the size up to which it may
+// grow while the socket keeps having more data available than fits.
+void NmqttClient::setReceiveBufferSize(uint32_t size, uint32_t max) {
+	receiveBufferSize = (size > 0) ? size : 1;
+	receiveBufferMax = (max > receiveBufferSize) ? max : receiveBufferSize;
+}
+
+
+// --- GET SLOT ---
+// Returns the slot for the handle, or null if no slot was allocated for it. Does not lock.
+NmqttClientSlot* NmqttClient::getSlot(int handle) {
+	if (handle < 0 || handle >= slotBlockSize * slotBlockCount) { return 0; }
+	
+	NmqttClientSlot* block = slotBlocks[handle / slotBlockSize].load(std::memory_order_acquire);
+	if (!block) { return 0; }
+	
+	return &block[handle % slotBlockSize];
+}
+
+
+// --- ALLOCATE SLOT ---
+// Returns an unused slot and its handle, or null if all handles are in use. Handles of closed 
+// connections are reused in the order they were released.
+NmqttClientSlot* NmqttClient::allocateSlot(int &handle) {
+	Poco::Mutex::ScopedLock lock(socketsMutex);
+	if (!freeHandles.empty()) {
+		handle = freeHandles.front();
+		freeHandles.pop();
+		return getSlot(handle);
+	}
+	
+	if (lastHandle >= slotBlockSize * slotBlockCount) { return 0; }
+	
+	// Blocks are published once they are fully constructed.
+	handle = lastHandle++;
+	std::atomic<NmqttClientSlot*> &block = slotBlocks[handle / slotBlockSize];
+	if (!block.load(std::memory_order_relaxed)) {
+		block.store(new NmqttClientSlot[slotBlockSize], std::memory_order_release);
+	}
+	
+	return getSlot(handle);
+}
+
+
+// --- RELEASE SLOT ---
+// Closes and deletes the socket of the connection once sends in progress have finished, and 
+// frees the handle. Returns false if the handle was not in use.
+bool NmqttClient::releaseSlot(int handle) {
+	NmqttClientSlot* slot = getSlot(handle);
+	if (!slot || !slot->active.exchange(false, std::memory_order_acq_rel)) { return false; }
+	
+	slot->sendMutex.lock();
+	Poco::Net::StreamSocket* socket = slot->socket;
+	std::string sessionKey;
+	sessionKey.swap(slot->tlsSessionKey);
+	slot->socket = 0;
+	slot->topicAliases.reset();
+	slot->generation.fetch_add(1, std::memory_order_release);
+	slot->sendMutex.unlock();
+	
+	if (!sessionKey.empty()) { storeTlsSession(sessionKey, socket); }
+	
+	try {
+		socket->shutdown();
+		socket->close();
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_WARNING("Failed to close socket: " + e.message());
+	}
+	
+	delete socket;
+	
+	socketsMutex.lock();
+	freeHandles.push(handle);
+	socketsMutex.unlock();
+	
+	return true;
 }
 
 
 // --- SEND MESSAGE ---
 // Private method for sending data to a remote broker.
-bool NmqttClient::sendMessage(int handle, std::string binMsg) {
-	map<int, Poco::Net::StreamSocket*>::iterator it;
-	socketsMutex.lock();
-	it = sockets.find(handle);
-	if (it == sockets.end()) { 
+bool NmqttClient::sendMessage(int handle, std::string_view binMsg) {
+	return sendMessage(handle, &binMsg, 1);
+}
+
+
+// --- SEND MESSAGE ---
+// Sends a message made up of multiple parts, e.g. a PUBLISH header followed by the user's payload,
+// without concatenating them. Sends on different connections do not block each other.
+bool NmqttClient::sendMessage(int handle, const std::string_view* parts, size_t count) {
+	NmqttClientSlot* slot = getSlot(handle);
+	uint32_t generation = slot ? slot->generation.load(std::memory_order_acquire) : 0;
+	if (!slot || !slot->active.load(std::memory_order_acquire)) { 
+		NYMPH_LOG_ERROR("Provided handle " + NumberFormatter::format(handle) + " was not found.");
+		return false;
+	}
+	
+	// The connection may have been closed and its handle reused before the slot got locked.
+	Poco::Mutex::ScopedLock lock(slot->sendMutex);
+	if (!slot->active.load(std::memory_order_relaxed) 
+			|| slot->generation.load(std::memory_order_relaxed) != generation) {
+		NYMPH_LOG_ERROR("Provided handle " + NumberFormatter::format(handle) + " was not found.");
+		return false;
+	}
+	
+	return sendLocked(slot, handle, parts, count);
+}
+
+
+// --- SEND LOCKED ---
+// Sends a message on the connection of the slot. The slot's send mutex has to be locked.
+bool NmqttClient::sendLocked(NmqttClientSlot* slot, int handle, const std::string_view* parts, 
+								size_t count) {
+	if (!slot->socket) {
 		NYMPH_LOG_ERROR("Provided handle " + NumberFormatter::format(handle) + " was not found.");
-		socketsMutex.unlock();
 		return false;
 	}
 	
 	try {
-		int ret = it->second->sendBytes(((const void*) binMsg.c_str()), binMsg.length());
-		if (ret != binMsg.length()) {
+		if (!NmqttSocketWriter::send(*(slot->socket), parts, count)) {
 			// Handle error.
 			NYMPH_LOG_ERROR("Failed to send message. Not all bytes sent.");
 			return false;
 		}
 		
-		NYMPH_LOG_DEBUG("Sent " + NumberFormatter::format(ret) + " bytes.");
+		NYMPH_LOG_DEBUG("Sent message in " + NumberFormatter::format(count) + " parts.");
 	}
 	catch (Poco::Exception &e) {
 		NYMPH_LOG_ERROR("Failed to send message: " + e.message());
 		return false;
 	}
 	
-	socketsMutex.unlock();
-	
 	// Reset Ping timer.
 	pingTimer.restart();
 	
@@ -356,7 +577,7 @@ void NmqttClient::pingreqHandler(uint32_t t) {
 	NYMPH_LOG_INFORMATION("Sending PINGREQ message for handle: " + 
 							Poco::NumberFormatter::format(t));
 	
-	if (!sendMessage(t, msg.serialize())) {
+	if (!sendMessage(t, msg.serializeLocal())) {
 		NYMPH_LOG_ERROR("Failed to send PINGREQ message.");
 	}
 }
@@ -370,18 +591,109 @@ void NmqttClient::pingrespHandler(int handle) {
 }
 
 
+// --- PROTOCOL ERROR HANDLER ---
+// Called by the listener of a connection before it closes the connection because of a protocol
+// error. With MQTT 5 the broker is sent a DISCONNECT with the reason code first.
+void NmqttClient::protocolErrorHandler(int handle, MqttReasonCodes code) {
+	if (mqttVersion != MQTT_PROTOCOL_VERSION_5) { return; }
+	
+	NYMPH_LOG_INFORMATION("Sending DISCONNECT message with reason code: 0x" + 
+							Poco::NumberFormatter::formatHex((unsigned) code));
+	
+	NmqttMessage msg(MQTT_DISCONNECT);
+	msg.setProtocolVersion(MQTT_PROTOCOL_VERSION_5);
+	msg.setReasonCode(code);
+	if (!sendMessage(handle, msg.serializeLocal())) {
+		NYMPH_LOG_ERROR("Failed to send DISCONNECT message.");
+	}
+}
+
+
 // --- PUBLISH ---
 bool NmqttClient::publish(int handle, std::string topic, std::string payload, std::string &result, 
 							MqttQoS qos, bool retain) {
 	NmqttMessage msg(MQTT_PUBLISH);
+	msg.setProtocolVersion(mqttVersion);
 	msg.setQoS(qos);
 	msg.setRetain(retain);
-	msg.setTopic(topic);
-	msg.setPayload(payload);
+	if (qos != MQTT_QOS_AT_MOST_ONCE) { msg.setPacketID(nextPacketID()); }
+	msg.setTopic(std::move(topic));
 	
 	NYMPH_LOG_INFORMATION("Sending PUBLISH message.");
 	
-	return sendMessage(handle, msg.serialize());
+	NmqttClientSlot* slot = getSlot(handle);
+	uint32_t generation = slot ? slot->generation.load(std::memory_order_acquire) : 0;
+	if (!slot || !slot->active.load(std::memory_order_acquire)) {
+		result = "Provided handle " + NumberFormatter::format(handle) + " was not found.";
+		return false;
+	}
+	
+	// With MQTT 5, replace the topic with a topic alias where possible. The connection stays 
+	// locked until the message is sent, so that the broker sees aliases in the order they were 
+	// assigned in. The connection may have been closed and its handle reused before the slot got
+	// locked.
+	Poco::Mutex::ScopedLock lock(slot->sendMutex);
+	if (!slot->active.load(std::memory_order_relaxed) 
+			|| slot->generation.load(std::memory_order_relaxed) != generation) {
+		result = "Provided handle " + NumberFormatter::format(handle) + " was not found.";
+		return false;
+	}
+	
+	if (slot->topicAliases) {
+		slot->topicAliases->lock();
+		slot->topicAliases->apply(msg);
+		slot->topicAliases->unlock();
+	}
+	
+	// The payload is sent directly from its string, after the serialised header.
+	std::string_view parts[2] = { msg.serializeHeaderLocal(payload.length()), payload };
+	if (parts[0].empty()) {
+		result = "Message too large.";
+		return false;
+	}
+	
+	return sendLocked(slot, handle, parts, 2);
+}
+
+
+// --- CREATE PUBLISH TEMPLATE ---
+// Pre-encodes a PUBLISH message for the provided topic, for use with the template version of 
+// publish(). Use this for topics which are published to repeatedly.
+NmqttPublishTemplate NmqttClient::createPublishTemplate(std::string topic, MqttQoS qos, bool retain) {
+	return NmqttPublishTemplate(std::move(topic), qos, retain, mqttVersion);
+}
+
+
+// --- PUBLISH ---
+// Publish using a template. Only the remaining length and packet ID are encoded, the payload is
+// sent from the provided buffer. The template should not be used by multiple threads at the 
+// same time.
+bool NmqttClient::publish(int handle, NmqttPublishTemplate &tpl, std::string_view payload, 
+							std::string &result) {
+	uint16_t packetID = 0;
+	if (tpl.getQoS() != MQTT_QOS_AT_MOST_ONCE) { packetID = nextPacketID(); }
+	
+	std::string_view parts[2] = { tpl.buildHeader(payload.length(), packetID), payload };
+	if (parts[0].empty()) {
+		result = "Invalid publish template or payload too large.";
+		return false;
+	}
+	
+	NYMPH_LOG_INFORMATION("Sending PUBLISH message.");
+	
+	return sendMessage(handle, parts, 2);
+}
+
+
+// --- NEXT PACKET ID ---
+// Returns the next packet identifier. Zero is not a valid packet identifier and is skipped.
+uint16_t NmqttClient::nextPacketID() {
+	uint16_t id;
+	do {
+		id = ++lastPacketID;
+	} while (id == 0);
+	
+	return id;
 }
 
 
@@ -389,33 +701,36 @@ bool NmqttClient::publish(int handle, std::string topic, std::string payload, st
 bool NmqttClient::subscribe(int handle, std::string topic, std::string result) {
 	//
 	NmqttMessage msg(MQTT_SUBSCRIBE);
+	msg.setProtocolVersion(mqttVersion);
 	msg.setTopic(topic);
 	
 	NYMPH_LOG_INFORMATION("Sending SUBSCRIBE message.");
 	
-	return sendMessage(handle, msg.serialize());
+	return sendMessage(handle, msg.serializeLocal());
 }
 
 
 // --- UNSUBSCRIBE ---
 bool NmqttClient::unsubscribe(int handle, std::string topic, std::string result) {
 	NmqttMessage msg(MQTT_UNSUBSCRIBE);
+	msg.setProtocolVersion(mqttVersion);
 	msg.setTopic(topic);
 	
 	NYMPH_LOG_INFORMATION("Sending UNSUBSCRIBE message.");
 	
-	return sendMessage(handle, msg.serialize());
+	return sendMessage(handle, msg.serializeLocal());
 }
 
 
 // --- GET LOCAL ADDRESS
 // Returns the local IPv4 address as a string, or an empty string if handle not found.
 std::string NmqttClient::getLocalAddress(int handle) {
-	//
-	std::map<int, Poco::Net::StreamSocket*>::iterator it;
-	it = sockets.find(handle);
-	if (it == sockets.end()) { return std::string(); }
+	NmqttClientSlot* slot = getSlot(handle);
+	if (!slot) { return std::string(); }
+	
+	Poco::Mutex::ScopedLock lock(slot->sendMutex);
+	if (!slot->socket) { return std::string(); }
 	
-	return it->second->address().toString();
+	return slot->socket->address().toString();
 }
 
@@ -18,18 +18,25 @@
 
 
 #include <string>
+#include <queue>
 #include <map>
+#include <memory>
 #include <functional>
+#include <atomic>
 
 #include <Poco/Mutex.h>
-#include <Poco/Semaphore.h>
 #include <Poco/Net/SocketAddress.h>
 #include <Poco/Net/StreamSocket.h>
 #include <Poco/Condition.h>
+#include <Poco/Net/Context.h>
+#include <Poco/Net/Session.h>
 
 #include "nymph_logger.h"
 #include "message.h"
+#include "publish_template.h"
+#include "topic_alias.h"
 #include "chronotrigger.h"
+#include "socket_options.h"
 
 
 struct NmqttBrokerConnection {
@@ -41,19 +48,39 @@ struct NmqttBrokerConnection {
 };
 
 
+// Connection slot, looked up by handle without locking. Slots are allocated in blocks, which are
+// only freed when the client is destroyed. Slots of closed connections are reused.
+struct NmqttClientSlot {
+	std::atomic<bool> active = { false };
+	std::atomic<uint32_t> generation = { 0 };	// Incremented when the slot is released.
+	Poco::Mutex sendMutex;					// Serialises sends. Guards the fields below.
+	Poco::Net::StreamSocket* socket = 0;
+	std::shared_ptr<NmqttOutboundAliases> topicAliases;
+	std::string tlsSessionKey;				// Key of the TLS session cache, for TLS connections.
+};
+
+
 class NmqttClient {
-	std::map<int, Poco::Net::StreamSocket*> sockets;
-	std::map<int, Poco::Semaphore*> socketSemaphores;
-	Poco::Mutex socketsMutex;
+	static const int slotBlockSize = 64;
+	static const int slotBlockCount = 1024;
+	
+	std::atomic<NmqttClientSlot*> slotBlocks[slotBlockCount] = {};
+	std::queue<int> freeHandles;
+	Poco::Mutex socketsMutex;				// Guards handle allocation, not the slots.
 	int lastHandle = 0;
 	long timeout = 3000;
 	std::string loggerName = "NmqttClient";
 	std::function<void(int, std::string, std::string)> messageHandler;
+	std::function<void(int, std::string_view, std::string_view)> messageViewHandler;
 	Poco::Condition connectCnd;
 	Poco::Mutex connectMtx;
 	ChronoTrigger pingTimer;
 	NmqttBrokerConnection* brokerConn = 0;
 	bool secureConnection = false;
+	bool sslInitialized = false;
+	Poco::Net::Context::Ptr tlsContext;		// Shared by all TLS connections.
+	std::map<std::string, Poco::Net::Session::Ptr> tlsSessions;	// Per broker address.
+	Poco::Mutex tlsSessionsMutex;
 	
 	uint8_t connectFlags;
 	bool cleanSessionFlag = true;
@@ -67,34 +94,59 @@ class NmqttClient {
 	std::string clientId = "NymphMQTT-client";
 	std::string username;
 	std::string password;
-	std::string ca, cert, key;
+	std::atomic<uint16_t> lastPacketID = { 0 };
+	MqttProtocolVersion mqttVersion = MQTT_PROTOCOL_VERSION_4;
+	uint16_t topicAliasMaximum = 16;
+	uint32_t receiveBufferSize = 16 * 1024;
+	uint32_t receiveBufferMax = 64 * 1024;
 	
-	bool sendMessage(int handle, std::string binMsg);
+	uint16_t nextPacketID();
+	NmqttClientSlot* getSlot(int handle);
+	NmqttClientSlot* allocateSlot(int &handle);
+	bool releaseSlot(int handle);
+	bool sendMessage(int handle, std::string_view binMsg);
+	bool sendMessage(int handle, const std::string_view* parts, size_t count);
+	bool sendLocked(NmqttClientSlot* slot, int handle, const std::string_view* parts, size_t count);
+	Poco::Net::Session::Ptr getTlsSession(const std::string &key);
+	void storeTlsSession(const std::string &key, Poco::Net::StreamSocket* socket);
 	void connackHandler(int handle, bool sessionPresent, MqttReasonCodes code);
 	void pingreqHandler(uint32_t t);
 	void pingrespHandler(int handle);
+	void protocolErrorHandler(int handle, MqttReasonCodes code);
 	
 public:
 	NmqttClient();
+	~NmqttClient();
 	
 	bool init(std::function<void(int, std::string)> logger, int level = NYMPH_LOG_LEVEL_TRACE, long timeout = 3000);
 	void setLogger(std::function<void(int, std::string)> logger, int level);
 	void setMessageHandler(std::function<void(int, std::string, std::string)> handler);
+	void setMessageViewHandler(std::function<void(int, std::string_view, std::string_view)> handler);
 	bool shutdown();
 	bool connect(std::string host, int port, int &handle, void* data, 
-					NmqttBrokerConnection &conn, std::string &result);
+					NmqttBrokerConnection &conn, std::string &result,
+					const NmqttSocketOptions &options = NmqttSocketOptions());
 	bool connect(std::string url, int &handle, void* data, 
-					NmqttBrokerConnection &conn, std::string &result);
+					NmqttBrokerConnection &conn, std::string &result,
+					const NmqttSocketOptions &options = NmqttSocketOptions());
 	bool connect(Poco::Net::SocketAddress sa, int &handle, void* data, 
-					NmqttBrokerConnection &conn, std::string &result);
+					NmqttBrokerConnection &conn, std::string &result,
+					const NmqttSocketOptions &options = NmqttSocketOptions());
 	bool disconnect(int handle, std::string &result);
 	
 	void setCredentials(std::string &user, std::string &pass);
 	void setWill(std::string topic, std::string will, uint8_t qos = 0, bool retain = false);
-	void setTLS(std::string &ca, std::string &cert, std::string &key);
+	bool setTLS(std::string &ca, std::string &cert, std::string &key);
 	void setClientId(std::string id) { clientId = id; }
+	void setProtocolVersion(MqttProtocolVersion version) { mqttVersion = version; }
+	void setTopicAliasMaximum(uint16_t max) { topicAliasMaximum = max; }
+	void setReceiveBufferSize(uint32_t size, uint32_t max);
 	bool publish(int handle, std::string topic, std::string payload, std::string &result, 
 					MqttQoS qos = MQTT_QOS_AT_MOST_ONCE, bool retain = false);
+	NmqttPublishTemplate createPublishTemplate(std::string topic, 
+					MqttQoS qos = MQTT_QOS_AT_MOST_ONCE, bool retain = false);
+	bool publish(int handle, NmqttPublishTemplate &tpl, std::string_view payload, 
+					std::string &result);
 	bool subscribe(int handle, std::string topic, std::string result);
 	bool unsubscribe(int handle, std::string topic, std::string result);
 	
@@ -1,10 +1,10 @@
 /*
-	client_listener.h - Header for the NymphMQTT Client socket listening thread class.
+	client_listener.cpp - Implementation of the NymphMQTT Client connection listener class.
 	
 	Revision 0
 	
 	Features:
-			- Socket listener for MQTT connections.
+			- Receives and parses the messages of a single MQTT connection.
 			
 	Notes:
 			- 
@@ -21,19 +21,21 @@
 using namespace std;
 
 #include <Poco/NumberFormatter.h>
+#include <Poco/Exception.h>
 
 using namespace Poco;
 
 
 // --- CONSTRUCTOR ---
-NmqttClientListener::NmqttClientListener(int handle, Condition* cnd, Mutex* mtx) {
+NmqttClientListener::NmqttClientListener(int handle) {
 	loggerName = "NmqttClientListener";
-	listen = true;
-	init = true;
 	this->nymphSocket = NmqttConnections::getSocket(handle);
 	this->socket = nymphSocket->socket;
-	this->readyCond = cnd;
-	this->readyMutex = mtx;
+	topicAliases.setMaximum(nymphSocket->topicAliasMaximum);
+	buffer.resize(nymphSocket->receiveBufferSize);
+	bufferMax = nymphSocket->receiveBufferMax;
+	quickAck = nymphSocket->quickAck;
+	requestPool = std::make_shared<NmqttRequestPool<Request> >();
 }
 
 
@@ -43,148 +45,115 @@ NmqttClientListener::~NmqttClientListener() {
 }
 
 
-// --- RUN ---
-void NmqttClientListener::run() {
-	Poco::Timespan timeout(0, 100); // 100 microsecond timeout
-	
-	NYMPH_LOG_INFORMATION("Start listening...");
-	
-	char headerBuff[5];
-	while (listen) {
-		if (socket->poll(timeout, Net::Socket::SELECT_READ)) {
-			// Attempt to receive the entire message.
-			// First validate the first two bytes. If it's an MQTT message this will contain the
-			// command and the first byte of the message length.
-			//
-			// Unfortunately, MQTT's message length is a variable length integer, spanning 1-4 bytes.
-			// Because of this, we have to read in the first byte, see whether a second one follows
-			// by looking at the 8th bit of the byte, read that in, and so on.
-			//
-			// The smallest message we can receive is the Disconnect type, with just two bytes.
-			int received = socket->receiveBytes((void*) &headerBuff, 2);
+// --- READABLE ---
+// Called by the reactor when data is available on the socket. Returns false if the connection was
+// closed or has failed, after which this listener should be removed.
+bool NmqttClientListener::readable() {
+	try {
+		// Read as much data as is available, into the receive buffer. MQTT's message length is a
+		// variable length integer, spanning 1-4 bytes, so a read may contain any number of 
+		// partial or complete messages. All complete messages are dispatched before the next 
+		// read, with the frame decoder keeping any partial message.
+		bool secure = socket->secure();
+		while (true) {
+			int received = socket->receiveBytes((void*) buffer.data(), buffer.size());
 			if (received == 0) {
 				// Remote disconnnected. Socket should be discarded.
-				NYMPH_LOG_INFORMATION("Received remote disconnected notice. Terminating listener thread.");
-				break;
+				NYMPH_LOG_INFORMATION("Received remote disconnected notice. Removing listener.");
+				return false;
 			}
-			else if (received < 2) {
-				// TODO: try to wait for more bytes.
-				NYMPH_LOG_WARNING("Received <2 bytes: " + NumberFormatter::format(received));
-				
-				continue;
+			else if (received < 0) {
+				// The socket is non-blocking: no data is left, or a TLS record is not complete yet.
+				// The read continues once more data arrives.
+				return true;
 			}
 			
-			// Use the NmqttMessage class's validation feature to extract the message length from
-			// the fixed header.
-			NmqttMessage msg;
-			uint32_t msglen = 0;
-			int idx = 0; // Will be set to the index after the fixed header by the parse method.
-			while (!msg.parseHeader((char*) &headerBuff, 5, msglen, idx)) {
-				// Attempt to read more data. The index parameter is placed at the last valid
-				// byte in the headerBuff array. Append new data after this.
-				
-				NYMPH_LOG_WARNING("Too few bytes to parse header. Aborting...");
-				
-				// TODO: abort reading for now.
-				continue;
-			}
+			NYMPH_LOG_DEBUG("Read 0x" + NumberFormatter::formatHex(received) + " bytes.");
 			
-			NYMPH_LOG_DEBUG("Received message length: " + NumberFormatter::format(msglen));
+			if (quickAck) { NmqttSocketOptions::rearmQuickAck(*socket); }
+			if (!processData(buffer.data(), received)) { return false; }
 			
-			string binMsg;
-			if (msglen > 0) {
-				// Create new buffer for the rest of the message.
-				char* buff = new char[msglen];
-				
-				// Read the entire message into a string which is then used to
-				// construct an NmqttMessage instance.
-				received = socket->receiveBytes((void*) buff, msglen);
-				binMsg.append(headerBuff, idx);
-				binMsg.append(buff, received);
-				if (received != msglen) {
-					// Handle incomplete message.
-					NYMPH_LOG_WARNING("Incomplete message: " + NumberFormatter::format(received) + " of " + NumberFormatter::format(msglen));
-					
-					// Loop until the rest of the message has been received.
-					// TODO: Set a maximum number of loops/timeout? Reset when 
-					// receiving data, timeout when poll times out N times?
-					//binMsg->reserve(msglen);
-					int unread = msglen - received;
-					while (1) {
-						if (socket->poll(timeout, Net::Socket::SELECT_READ)) {
-							char* buff1 = new char[unread];
-							received = socket->receiveBytes((void*) buff1, unread);
-							if (received == 0) {
-								// Remote disconnnected. Socket should be discarded.
-								NYMPH_LOG_INFORMATION("Received remote disconnected notice. Terminating listener thread.");
-								delete[] buff1;
-								break;
-							}
-							else if (received != unread) {
-								binMsg.append((const char*) buff1, received);
-								delete[] buff1;
-								unread -= received;
-								NYMPH_LOG_WARNING("Incomplete message: " + NumberFormatter::format(unread) + "/" + NumberFormatter::format(msglen) + " unread.");
-								continue;
-							}
-							
-							// Full message was read. Continue with processing.
-							binMsg.append((const char*) buff1, received);
-							delete[] buff1;
-							break;
-						} // if
-					} //while
-				}
-				else { 
-					NYMPH_LOG_DEBUG("Read 0x" + NumberFormatter::formatHex(received) + " bytes.");
-				}
-				
-				delete[] buff;
-			}
-			else {
-				//
-				binMsg.append(headerBuff, idx);
+			// A short read means that the socket has been drained. A TLS socket may still have 
+			// decrypted data buffered, which does not show up as readiness of the socket itself.
+			if ((size_t) received < buffer.size()) {
+				if (!secure || socket->available() <= 0) { break; }
+				continue;
 			}
 			
-			// Parse the string into an NmqttMessage instance.
-			msg.parseMessage(binMsg);	
-			
-			NYMPH_LOG_DEBUG("Got command: 0x" + Poco::NumberFormatter::formatHex(msg.getCommand()));
-			
-			// Call the message handler callback when one exists for this type of message.
-			// TODO: refactor for Dispatcher.
-			Request* req = new Request;
-			req->setMessage(nymphSocket->handle, msg);
-			Dispatcher::addRequest(req);
-		}
-		
-		// Check whether we're still initialising.
-		if (init) {
-			// Signal that this listener thread is ready.
-			readyMutex->lock();
-			readyCond->signal();
-			readyMutex->unlock();
-			
-			timeout.assign(1, 0); // Change timeout to 1 second.
-			init = false;
+			// The buffer was filled. Grow it for the next read, which returns at once if no more
+			// data is waiting.
+			if (buffer.size() < bufferMax) {
+				size_t size = buffer.size() * 2;
+				buffer.resize((size < bufferMax) ? size : bufferMax);
+			}
 		}
 	}
+	catch (Poco::TimeoutException &e) {
+		// Would block, with POCO versions which report this as a timeout.
+		return true;
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_ERROR("Failed to read from socket: " + e.message());
+		return false;
+	}
 	
-	NYMPH_LOG_INFORMATION("Stopping thread...");
-	
-	// Clean-up.
-	delete readyCond;
-	delete readyMutex;
-	nymphSocket->semaphore->wait();	// Wait for the connection to be closed.
-	delete socket;
-	delete nymphSocket->semaphore;
-	nymphSocket->semaphore = 0;
-	delete this; // Call the destructor ourselves.
+	return true;
 }
 
 
-// --- STOP ---
-void NmqttClientListener::stop() {
-	listen = false;
+// --- PROCESS DATA ---
+// Feeds received data to the frame decoder, dispatching each complete message. Returns false if
+// the data is corrupted or a message is malformed.
+bool NmqttClientListener::processData(const char* data, size_t unread) {
+	while (unread > 0) {
+		size_t used = 0;
+		int res = decoder.feed(data, unread, used);
+		data += used;
+		unread -= used;
+		if (res < 0) {
+			NYMPH_LOG_ERROR("Received corrupted data. Removing listener.");
+			return false;
+		}
+		else if (res == 0) {
+			// Wait for the rest of the message.
+			break;
+		}
+		
+		// Parse the complete message into the message instance of a pooled request. The 
+		// buffers of the decoder, this listener and the message are swapped, so that their 
+		// capacity is reused.
+		Request* req = requestPool->acquire();
+		NmqttMessage &msg = req->getMessage();
+		decoder.takeFrame(frame);
+		msg.setProtocolVersion(nymphSocket->version);
+		if (msg.parseFrame(frame) < 0) {
+			// A malformed message is a protocol error, which closes the connection.
+			NYMPH_LOG_ERROR("Received malformed message. Removing listener.");
+			req->finish();
+			return false;
+		}
+		
+		NYMPH_LOG_DEBUG("Got command: 0x" + Poco::NumberFormatter::formatHex(msg.getCommand()));
+		
+		// Replace a topic alias with its topic (MQTT 5). An invalid topic alias is a protocol 
+		// error, which closes the connection, as with the broker. The broker is sent a DISCONNECT
+		// with the Topic Alias invalid reason code first.
+		if (msg.getCommand() == MQTT_PUBLISH && nymphSocket->version == MQTT_PROTOCOL_VERSION_5
+				&& !topicAliases.resolve(msg)) {
+			NYMPH_LOG_ERROR("Received PUBLISH with invalid topic alias. Removing listener.");
+			if (nymphSocket->protocolErrorHandler) {
+				nymphSocket->protocolErrorHandler(nymphSocket->handle, 
+													MQTT_CODE_TOPIC_ALIAS_INVALID);
+			}
+			
+			req->finish();
+			return false;
+		}
+		
+		// Call the message handler callback when one exists for this type of message.
+		req->setHandle(nymphSocket->handle);
+		Dispatcher::addRequest(req);
+	}
+	
+	return true;
 }
-
@@ -1,13 +1,16 @@
 /*
-	client_listener.h - Header for the NymphMQTT Client socket listening thread class.
+	client_listener.h - Header for the NymphMQTT Client connection listener class.
 	
 	Revision 0
 	
 	Features:
-			- Socket listener for MQTT connections.
+			- Receives and parses the messages of a single MQTT connection.
 			
 	Notes:
-			- 
+			- Instances are driven by a client reactor thread, which calls readable() when data is 
+				available on the socket. The socket is non-blocking, so that a partial TLS record
+				does not block the reactor.
+			- Each connection has its own receive buffer, which grows while reads fill it.
 			
 	2019/05/08 - Maya Posch
 */
@@ -17,33 +20,40 @@
 #define NMQTT_CLIENT_LISTENER_H
 
 
-#include <Poco/Runnable.h>
 #include <Poco/Net/StreamSocket.h>
-#include <Poco/Semaphore.h>
-#include <Poco/Condition.h>
 
 #include "client.h"
 #include "message.h"
 #include "connections.h"
+#include "frame_decoder.h"
+#include "topic_alias.h"
+#include "request.h"
 
 #include <map>
 #include <string>
+#include <vector>
 
 
-class NmqttClientListener : public Poco::Runnable {
+class NmqttClientListener {
 	std::string loggerName;
-	bool listen;
+	NmqttFrameDecoder decoder;
+	NmqttInboundAliases topicAliases;
+	std::shared_ptr<NmqttRequestPool<Request> > requestPool;
+	std::string frame;
 	NymphSocket* nymphSocket;
 	Poco::Net::StreamSocket* socket;
-	bool init;
-	Poco::Condition* readyCond;
-	Poco::Mutex* readyMutex;
+	std::vector<char> buffer;
+	size_t bufferMax;
+	bool quickAck;
+	
+	bool processData(const char* data, size_t len);
 	
 public:
-	NmqttClientListener(int handle , Poco::Condition* cond, Poco::Mutex* mtx);
+	NmqttClientListener(int handle);
 	~NmqttClientListener();
-	void run();
-	void stop();
+	
+	Poco::Net::StreamSocket* getSocket() { return socket; }
+	bool readable();
 };
 
 #endif
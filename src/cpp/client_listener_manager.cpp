@@ -14,7 +14,6 @@
 
 
 #include "client_listener_manager.h"
-#include "client_listener.h"
 #include "nymph_logger.h"
 
 #include <iostream>
@@ -22,28 +21,64 @@
 
 using namespace std;
 
-#include <Poco/Thread.h>
 #include <Poco/NumberFormatter.h>
-#include <Poco/Condition.h>
 
 using namespace Poco;
 
 
 // Static initialisations.
-map<int, NmqttClientListener*> NmqttClientListenerManager::listeners;
-Mutex NmqttClientListenerManager::listenersMutex;
+vector<NmqttClientReactor*> NmqttClientListenerManager::reactors;
+uint32_t NmqttClientListenerManager::reactorCount = 1;
+Mutex NmqttClientListenerManager::reactorsMutex;
 string NmqttClientListenerManager::loggerName = "NmqttClientListenerManager";
 
 
 // --- STOP ---
 void NmqttClientListenerManager::stop() {
-	// Shut down all listening threads.
-	listenersMutex.lock();
-	for (int i = 0; i < listeners.size(); ++i) {
-		listeners[i]->stop();
+	// Shut down all reactor threads.
+	reactorsMutex.lock();
+	for (int i = 0; i < reactors.size(); ++i) {
+		reactors[i]->stop();
+		delete reactors[i];
 	}
 	
-	listenersMutex.unlock();
+	reactors.clear();
+	reactorsMutex.unlock();
+}
+
+
+// --- SET REACTOR COUNT ---
+// Sets the number of reactor threads to use. Only has an effect before the first connection.
+void NmqttClientListenerManager::setReactorCount(uint32_t count) {
+	if (count < 1) { count = 1; }
+	
+	reactorsMutex.lock();
+	if (reactors.empty()) { reactorCount = count; }
+	reactorsMutex.unlock();
+}
+
+
+// --- GET REACTOR ---
+// Returns the reactor for the handle, starting the reactors if needed.
+NmqttClientReactor* NmqttClientListenerManager::getReactor(int handle) {
+	reactorsMutex.lock();
+	if (reactors.empty()) {
+		for (uint32_t i = 0; i < reactorCount; ++i) {
+			NmqttClientReactor* reactor = new NmqttClientReactor;
+			if (!reactor->start()) {
+				delete reactor;
+				break;
+			}
+			
+			reactors.push_back(reactor);
+		}
+	}
+	
+	NmqttClientReactor* reactor = 0;
+	if (!reactors.empty()) { reactor = reactors[handle % reactors.size()]; }
+	reactorsMutex.unlock();
+	
+	return reactor;
 }
 
 
@@ -51,28 +86,12 @@ void NmqttClientListenerManager::stop() {
 bool NmqttClientListenerManager::addConnection(int handle) {
 	NYMPH_LOG_INFORMATION("Adding connection. Handle: " + NumberFormatter::format(handle) + ".");
 	
-	// Create new thread for NmqttListener instance which handles
-	// the new socket. Save reference to this listener.
-	Poco::Condition* cnd = new Poco::Condition;
-	Poco::Mutex* mtx = new Poco::Mutex;
-	long timeout = 1000; // 1 second
-	mtx->lock();
-	NmqttClientListener* esl = new NmqttClientListener(handle, cnd, mtx);
-	Poco::Thread* thread = new Poco::Thread;
-	thread->start(*esl);
-	if (!cnd->tryWait(*mtx, timeout)) {
-		// Handle listener timeout.
-		NYMPH_LOG_ERROR("Creating of new listener thread timed out.");
-		mtx->unlock();
+	NmqttClientReactor* reactor = getReactor(handle);
+	if (!reactor || !reactor->addConnection(handle)) {
+		NYMPH_LOG_ERROR("Failed to add connection to reactor.");
 		return false;
 	}
 	
-	mtx->unlock();
-	
-	listenersMutex.lock();
-	listeners.insert(std::pair<int, NmqttClientListener*>(handle, esl));
-	listenersMutex.unlock();
-	
 	NYMPH_LOG_INFORMATION("Listening socket has been added.");
 	
 	return true;
@@ -80,22 +99,19 @@ bool NmqttClientListenerManager::addConnection(int handle) {
 
 
 // --- REMOVE CONNECTION ---
-// Removes a connection using the Nymph connection handle.
+// Removes a connection using the Nymph connection handle. Once this returns, the socket is no 
+// longer used and can be closed.
 bool NmqttClientListenerManager::removeConnection(int handle) {
-	map<int, NmqttClientListener*>::iterator it;
-	listenersMutex.lock();
-	
 	NYMPH_LOG_INFORMATION("Removing connection for handle: " + NumberFormatter::format(handle) + ".");
 	
-	it = listeners.find(handle);
-	if (it == listeners.end()) { listenersMutex.unlock(); return true; }
+	reactorsMutex.lock();
+	NmqttClientReactor* reactor = 0;
+	if (!reactors.empty()) { reactor = reactors[handle % reactors.size()]; }
+	reactorsMutex.unlock();
 	
-	it->second->stop(); // Tell the listening thread to terminate.
-	listeners.erase(it);
+	if (reactor) { reactor->removeConnection(handle); }
 	
 	NYMPH_LOG_INFORMATION("Listening socket has been removed.");
 	
-	listenersMutex.unlock();
 	return true;
 }
-
@@ -4,7 +4,8 @@
 	Revision 0
 	
 	Notes:
-			- 
+			- Connections are divided over a fixed number of reactor threads, which are started 
+				along with the first connection.
 			
 	History:
 	2019/06/24, Maya Posch	: Initial version.
@@ -22,16 +23,20 @@
 
 #include <Poco/Mutex.h>
 
-#include "client_listener.h"
+#include "client_reactor.h"
 
 
 class NmqttClientListenerManager {
-	static std::map<int, NmqttClientListener*> listeners;
-	static Poco::Mutex listenersMutex;
+	static std::vector<NmqttClientReactor*> reactors;
+	static uint32_t reactorCount;
+	static Poco::Mutex reactorsMutex;
 	static std::string loggerName;
 	
+	static NmqttClientReactor* getReactor(int handle);
+	
 public:
 	static void stop();
+	static void setReactorCount(uint32_t count);
 	
 	static bool addConnection(int handle);
 	static bool removeConnection(int handle);
@@ -0,0 +1,151 @@
+/*
+	client_reactor.cpp - Implementation of the NymphMQTT Client reactor class.
+	
+	Revision 0
+	
+	Features:
+			- Single thread which receives data for any number of client connections.
+			
+	Notes:
+			- 
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "client_reactor.h"
+#include "nymph_logger.h"
+
+#include <Poco/NumberFormatter.h>
+#include <Poco/Exception.h>
+
+using namespace Poco;
+
+
+// --- DECONSTRUCTOR ---
+NmqttClientReactor::~NmqttClientReactor() {
+	stop();
+}
+
+
+// --- START ---
+bool NmqttClientReactor::start() {
+	if (!poller.valid()) {
+		NYMPH_LOG_ERROR("Failed to create poller.");
+		return false;
+	}
+	
+	running = true;
+	thread.start(*this);
+	return true;
+}
+
+
+// --- STOP ---
+// Stops the reactor thread and removes all connections.
+void NmqttClientReactor::stop() {
+	if (!running) { return; }
+	
+	running = false;
+	poller.wake();
+	thread.join();
+	
+	listenersMutex.lock();
+	while (!listeners.empty()) { closeListener(listeners.begin()); }
+	listenersMutex.unlock();
+}
+
+
+// --- RUN ---
+void NmqttClientReactor::run() {
+	NYMPH_LOG_INFORMATION("Start listening...");
+	
+	std::vector<NmqttPollEvent> events;
+	while (running) {
+		if (poller.wait(events, -1) < 0) {
+			NYMPH_LOG_ERROR("Failed to wait for socket events. Terminating reactor thread.");
+			break;
+		}
+		
+		// Look up the listener with the lock held, but read without it, so that a slow connection
+		// does not block adding and removing others. A connection is not removed while it is being
+		// read from. Events for connections which were removed after the wait are skipped.
+		for (const NmqttPollEvent &ev : events) {
+			listenersMutex.lock();
+			std::map<int, NmqttClientListener*>::iterator it = listeners.find((int) ev.key);
+			if (it == listeners.end()) {
+				listenersMutex.unlock();
+				continue;
+			}
+			
+			NmqttClientListener* listener = it->second;
+			reading = it->first;
+			listenersMutex.unlock();
+			
+			bool open = listener->readable();
+			
+			listenersMutex.lock();
+			reading = -1;
+			if (!open) { closeListener(listeners.find((int) ev.key)); }
+			readingCnd.broadcast();
+			listenersMutex.unlock();
+		}
+	}
+	
+	NYMPH_LOG_INFORMATION("Stopping thread...");
+}
+
+
+// --- ADD CONNECTION ---
+bool NmqttClientReactor::addConnection(int handle) {
+	NmqttClientListener* listener = new NmqttClientListener(handle);
+	try {
+		listener->getSocket()->setBlocking(false);
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_ERROR("Failed to make socket non-blocking: " + e.message());
+		delete listener;
+		return false;
+	}
+	
+	listenersMutex.lock();
+	listeners.insert(std::pair<int, NmqttClientListener*>(handle, listener));
+	if (!poller.add(listener->getSocket()->impl()->sockfd(), handle)) {
+		NYMPH_LOG_ERROR("Failed to add socket for handle " + NumberFormatter::format(handle) + ".");
+		listeners.erase(handle);
+		listenersMutex.unlock();
+		delete listener;
+		return false;
+	}
+	
+	listenersMutex.unlock();
+	return true;
+}
+
+
+// --- REMOVE CONNECTION ---
+// Removes the connection, after waiting for a read in progress on it to finish. Once this returns,
+// the reactor no longer uses its socket.
+bool NmqttClientReactor::removeConnection(int handle) {
+	listenersMutex.lock();
+	while (reading == handle) { readingCnd.wait(listenersMutex); }
+	
+	std::map<int, NmqttClientListener*>::iterator it = listeners.find(handle);
+	if (it == listeners.end()) {
+		listenersMutex.unlock();
+		return false;
+	}
+	
+	closeListener(it);
+	listenersMutex.unlock();
+	return true;
+}
+
+
+// --- CLOSE LISTENER ---
+// Unregisters the socket and deletes the listener. Call with the listeners mutex locked.
+void NmqttClientReactor::closeListener(std::map<int, NmqttClientListener*>::iterator it) {
+	poller.remove(it->second->getSocket()->impl()->sockfd());
+	delete it->second;
+	listeners.erase(it);
+}
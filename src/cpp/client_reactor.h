@@ -0,0 +1,60 @@
+/*
+	client_reactor.h - Header for the NymphMQTT Client reactor class.
+	
+	Revision 0
+	
+	Features:
+			- Single thread which receives data for any number of client connections.
+			
+	Notes:
+			- Connections are added and removed from other threads. Removal is complete when 
+				removeConnection() returns, after which the socket can be closed.
+			- Sockets are made non-blocking, and are read without holding the listeners lock. A 
+				connection which is being read from is removed once the read has finished.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_CLIENT_REACTOR_H
+#define NMQTT_CLIENT_REACTOR_H
+
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+#include <Poco/Mutex.h>
+#include <Poco/Condition.h>
+
+#include "poller.h"
+#include "client_listener.h"
+
+
+class NmqttClientReactor : public Poco::Runnable {
+	std::string loggerName = "NmqttClientReactor";
+	NmqttPoller poller;
+	std::map<int, NmqttClientListener*> listeners;
+	Poco::Mutex listenersMutex;
+	int reading = -1;					// Handle of the connection being read from, or -1.
+	Poco::Condition readingCnd;			// Signalled when a read has finished.
+	Poco::Thread thread;
+	bool running = false;
+	
+	void closeListener(std::map<int, NmqttClientListener*>::iterator it);
+	
+public:
+	~NmqttClientReactor();
+	
+	bool start();
+	void stop();
+	void run();
+	
+	bool addConnection(int handle);
+	bool removeConnection(int handle);
+};
+
+
+#endif
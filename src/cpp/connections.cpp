@@ -18,15 +18,19 @@
 
 // Static declarations.
 std::map<int, NymphSocket> NmqttConnections::sockets;
+Poco::Mutex NmqttConnections::socketsMutex;
 
 
+// --- ADD SOCKET ---
 void NmqttConnections::addSocket(NymphSocket &ns) {
-	sockets.insert(std::pair<int, NymphSocket>(ns.handle, ns));
+	Poco::Mutex::ScopedLock lock(socketsMutex);
+	sockets[ns.handle] = ns;
 }
 
 
 // --- GET SOCKET ---
 NymphSocket* NmqttConnections::getSocket(int handle) {
+	Poco::Mutex::ScopedLock lock(socketsMutex);
 	std::map<int, NymphSocket>::iterator it;
 	it = sockets.find(handle);
 	if (it == sockets.end()) {
@@ -7,7 +7,8 @@
 			- Static class to enable the global management of connections.
 			
 	Notes:
-			- 
+			- Handles are reused once a connection has been closed. Adding a connection replaces 
+				the entry of a previous connection with the same handle.
 			
 	2019/05/08 - Maya Posch
 */
@@ -18,13 +19,16 @@
 
 
 #include <map>
+#include <memory>
+#include <string_view>
 #include <functional>
 
-#include <Poco/Semaphore.h>
+#include <Poco/Mutex.h>
 #include <Poco/Net/StreamSocket.h>
 #include <Poco/Net/SecureStreamSocket.h>
 
 #include "client.h"
+#include "topic_alias.h"
 
 
 // TYPES
@@ -33,17 +37,25 @@ struct NymphSocket {
 	//Poco::Net::SecureStreamSocket* ssocket;	// Pointer to a secure socket instance.
 	Poco::Net::Context::Ptr context;	// The security context for TLS connections.
 	Poco::Net::StreamSocket* socket;	// Pointer to a non-secure socket instance.
-	Poco::Semaphore* semaphore;			// Signals when it's safe to delete the socket.
 	std::function<void(int, std::string, std::string)> handler;		// Publish message handler.
+	std::function<void(int, std::string_view, std::string_view)> viewHandler;	// Same, with views.
 	std::function<void(int, bool, MqttReasonCodes)> connackHandler; // CONNACK handler.
 	std::function<void(int)> pingrespHandler;						// PINGRESP handler.
+	std::function<void(int, MqttReasonCodes)> protocolErrorHandler;	// Sends DISCONNECT.
 	void* data;						// User data.
 	int handle;						// The Nymph internal socket handle.
+	MqttProtocolVersion version;	// MQTT version used on this connection.
+	std::shared_ptr<NmqttOutboundAliases> topicAliases;	// Aliases for published topics.
+	uint16_t topicAliasMaximum;		// Maximum for aliases of received topics.
+	uint32_t receiveBufferSize;		// Initial size of the receive buffer.
+	uint32_t receiveBufferMax;		// Size up to which the receive buffer may grow.
+	bool quickAck;					// Set TCP_QUICKACK again after each receive.
 };
 
 
 class NmqttConnections {
 	static std::map<int, NymphSocket> sockets;
+	static Poco::Mutex socketsMutex;
 	
 public:
 	static void addSocket(NymphSocket &ns);
@@ -0,0 +1,137 @@
+/*
+	epoch.cpp - Implementation of the NymphMQTT epoch-based reclamation class.
+	
+	Revision 0
+	
+	Features:
+			- Deferred deletion of objects which readers may still be using.
+	
+	Notes:
+			- A retired object is tagged with the global epoch, which is then advanced. Readers
+				which enter after this record a later epoch, and can only reach the replacement.
+				The object is deleted once no active reader has an epoch up to its tag.
+			- The seq_cst fences order the epoch of a reader before its loads of the structure,
+				and the publishing of a replacement before the scan of the readers.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "epoch.h"
+
+#include <limits>
+
+
+// Static initialisations.
+std::atomic<uint64_t> NmqttEpoch::globalEpoch { 1 };
+std::atomic<NmqttEpoch::Record*> NmqttEpoch::records { 0 };
+std::vector<NmqttEpoch::Retired> NmqttEpoch::retired;
+Poco::Mutex NmqttEpoch::retiredMutex;
+
+
+// Releases the record of a thread when it exits.
+struct NmqttEpochRecordOwner {
+	NmqttEpoch::Record* rec = 0;
+	
+	~NmqttEpochRecordOwner() {
+		if (rec) { rec->used.store(false, std::memory_order_release); }
+	}
+};
+
+
+// --- RECORD ---
+// Returns the record of the calling thread, claiming a free one or adding a new one on first use.
+NmqttEpoch::Record* NmqttEpoch::record() {
+	static thread_local NmqttEpochRecordOwner owner;
+	if (owner.rec) { return owner.rec; }
+	
+	for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+		bool expected = false;
+		if (!r->used.load(std::memory_order_relaxed)
+				&& r->used.compare_exchange_strong(expected, true)) {
+			owner.rec = r;
+			return r;
+		}
+	}
+	
+	Record* r = new Record;
+	r->used.store(true, std::memory_order_relaxed);
+	r->next = records.load(std::memory_order_relaxed);
+	while (!records.compare_exchange_weak(r->next, r, std::memory_order_release,
+											std::memory_order_relaxed)) { }
+	
+	owner.rec = r;
+	return r;
+}
+
+
+// --- GUARD ---
+NmqttEpoch::Guard::Guard() : rec(record()) {
+	if (rec->depth++ > 0) { return; }
+	
+	rec->epoch.store(globalEpoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+
+NmqttEpoch::Guard::~Guard() {
+	if (--rec->depth > 0) { return; }
+	
+	rec->epoch.store(0, std::memory_order_release);
+}
+
+
+// --- MINIMUM ACTIVE ---
+// Returns the lowest epoch of the active readers, or the maximum value if none are active.
+uint64_t NmqttEpoch::minimumActive() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	uint64_t min = std::numeric_limits<uint64_t>::max();
+	for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+		uint64_t e = r->epoch.load(std::memory_order_acquire);
+		if (e != 0 && e < min) { min = e; }
+	}
+	
+	return min;
+}
+
+
+// --- RETIRE ---
+// Schedules an object for deletion, after it has been replaced or unlinked in the structure.
+void NmqttEpoch::retire(void* ptr, void (*destroy)(void*)) {
+	Retired r;
+	r.ptr = ptr;
+	r.destroy = destroy;
+	
+	Poco::Mutex::ScopedLock lock(retiredMutex);
+	r.epoch = globalEpoch.fetch_add(1, std::memory_order_seq_cst);
+	retired.push_back(r);
+}
+
+
+// --- RECLAIM ---
+// Deletes the retired objects which are no longer in use. Returns the number deleted.
+size_t NmqttEpoch::reclaim() {
+	std::vector<Retired> freed;
+	retiredMutex.lock();
+	uint64_t min = minimumActive();
+	size_t n = 0;
+	for (size_t i = 0; i < retired.size(); ++i) {
+		if (retired[i].epoch < min) { freed.push_back(retired[i]); }
+		else { retired[n++] = retired[i]; }
+	}
+	
+	retired.resize(n);
+	retiredMutex.unlock();
+	
+	// Objects are deleted without the lock, so that their destructors may retire others.
+	for (Retired &r : freed) { r.destroy(r.ptr); }
+	return freed.size();
+}
+
+
+// --- PENDING ---
+// Returns the number of retired objects which have not been deleted yet.
+size_t NmqttEpoch::pending() {
+	Poco::Mutex::ScopedLock lock(retiredMutex);
+	return retired.size();
+}
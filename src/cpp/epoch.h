@@ -0,0 +1,81 @@
+/*
+	epoch.h - Header for the NymphMQTT epoch-based reclamation class.
+	
+	Revision 0
+	
+	Features:
+			- Lets threads read shared structures without locks, while writers replace parts of
+				them. Replaced objects are deleted once no reader can still be using them.
+	
+	Notes:
+			- A reader holds a Guard while it uses the structure. Guards may be nested.
+			- Writers publish the replacement before retiring the old object. It is deleted once
+				every reader which was active at the time of retiring has left.
+			- A long-running reader delays the deletion of retired objects, but blocks no one.
+			- Each reading thread uses a record, which is reused by another thread after the thread
+				exits. Records are never freed.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_EPOCH_H
+#define NMQTT_EPOCH_H
+
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <Poco/Mutex.h>
+
+
+class NmqttEpoch {
+	struct Record {
+		std::atomic<uint64_t> epoch { 0 };		// Epoch of the active reader, or 0.
+		std::atomic<bool> used { false };
+		uint32_t depth = 0;						// Nesting of guards, used by the owner only.
+		Record* next = 0;
+	};
+	
+	struct Retired {
+		void* ptr;
+		void (*destroy)(void*);
+		uint64_t epoch;
+	};
+	
+	static std::atomic<uint64_t> globalEpoch;
+	static std::atomic<Record*> records;
+	static std::vector<Retired> retired;
+	static Poco::Mutex retiredMutex;
+	
+	static Record* record();
+	static uint64_t minimumActive();
+	static void retire(void* ptr, void (*destroy)(void*));
+	
+	template <typename T> static void destroy(void* ptr) { delete static_cast<T*>(ptr); }
+	
+	friend struct NmqttEpochRecordOwner;
+
+public:
+	class Guard {
+		Record* rec;
+	
+	public:
+		Guard();
+		~Guard();
+		Guard(const Guard &other) = delete;
+		Guard& operator=(const Guard &other) = delete;
+	};
+	
+	template <typename T> static void retire(const T* ptr) { 
+		if (ptr) { retire(const_cast<T*>(ptr), &destroy<T>); }
+	}
+	
+	static size_t reclaim();
+	static size_t pending();
+};
+
+
+#endif
@@ -0,0 +1,114 @@
+/*
+	fanout.cpp - Implementation of the NymphMQTT PUBLISH fan-out class.
+	
+	Revision 0
+	
+	Features:
+			- Encodes a PUBLISH message once, for sending it to many clients.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "fanout.h"
+
+#include <bytebauble.h>
+
+#include <memory>
+
+
+// --- CONSTRUCTOR ---
+// Copies the payload into the shared body.
+NmqttFanout::NmqttFanout(std::string_view topic, std::string_view payload) :
+		topic(topic), body(std::make_shared<const std::string>(payload)) {
+	//
+}
+
+
+// Shares a payload which is already held elsewhere, such as in the retained message store.
+NmqttFanout::NmqttFanout(std::string_view topic, NmqttSharedBody payload) :
+		topic(topic), body(std::move(payload)) {
+	//
+}
+
+
+// --- ENCODE ---
+// Writes the fixed and variable header of a PUBLISH message with the body as payload, and the
+// provided alias if not 0. The packet identifier is left as zero, at the returned offset. Returns
+// false if the message would be too large.
+bool NmqttFanout::encode(std::string &out, uint8_t qos, bool retain, bool v5,
+							std::string_view topic, uint16_t alias, uint32_t &packetIDOffset) {
+	if (topic.length() > 0xFFFF) { return false; }
+	
+	uint32_t varLen = 2 + topic.length();
+	if (qos > 0) { varLen += 2; }
+	if (v5) { varLen += (alias != 0) ? 4 : 1; }
+	if (body->length() > 0x0FFFFFFF - varLen) { return false; }
+	
+	uint32_t msgLenPacked;
+	uint32_t lenBytes = ByteBauble::writePackedInt(varLen + body->length(), msgLenPacked);
+	if (lenBytes == 0) { return false; }
+	
+	out.clear();
+	out.push_back((char) (MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0)));
+	for (uint32_t i = 0; i < lenBytes; ++i) {
+		out.push_back((char) (msgLenPacked >> (i * 8)));
+	}
+	
+	out.push_back((char) (topic.length() >> 8));
+	out.push_back((char) topic.length());
+	out.append(topic.data(), topic.length());
+	packetIDOffset = out.length();
+	if (qos > 0) { out.append(2, '\0'); }
+	if (v5) {
+		// Properties: only the topic alias, if any.
+		if (alias == 0) { out.push_back(0x00); }
+		else {
+			out.push_back(0x03);
+			out.push_back((char) MQTT_PROP_TOPIC_ALIAS);
+			out.push_back((char) (alias >> 8));
+			out.push_back((char) alias);
+		}
+	}
+	
+	return true;
+}
+
+
+// --- HEADER ---
+// Returns the header of the message for a client, which is to be followed by the shared body. The
+// packet identifier is ignored for QoS 0. With an alias other than 0 the topic is sent along,
+// unless the client already knows the alias. The returned view is valid until the next call to
+// this method, or until the instance is destroyed. An empty view is returned if the message would
+// be too large.
+std::string_view NmqttFanout::header(MqttQoS qos, bool retain, MqttProtocolVersion version,
+										uint16_t packetID, uint16_t alias, bool aliasKnown) {
+	uint8_t q = qos >> 1;
+	if (q > 2) { return std::string_view(); }
+	
+	bool v5 = version == MQTT_PROTOCOL_VERSION_5;
+	uint32_t offset;
+	if (v5 && alias != 0) {
+		std::string_view t = aliasKnown ? std::string_view() : std::string_view(topic);
+		if (!encode(local, q, retain, true, t, alias, offset)) { return std::string_view(); }
+	}
+	else {
+		Variant &v = variants[retain ? 1 : 0][q][v5 ? 1 : 0];
+		if (v.header.empty() && !encode(v.header, q, retain, v5, topic, 0, v.packetIDOffset)) {
+			return std::string_view();
+		}
+		
+		local = v.header;
+		offset = v.packetIDOffset;
+	}
+	
+	if (q > 0) {
+		local[offset] = (char) (packetID >> 8);
+		local[offset + 1] = (char) packetID;
+	}
+	
+	return std::string_view(local.data(), local.length());
+}
@@ -0,0 +1,60 @@
+/*
+	fanout.h - Header for the NymphMQTT PUBLISH fan-out class.
+	
+	Revision 0
+	
+	Features:
+			- Encodes a PUBLISH message once, for sending it to many clients.
+			- The payload is copied once into a shared body, which the outbound queues of all
+				clients refer to.
+			- A header is encoded once per variant: QoS, retain flag and protocol version. The
+				header for a client is a copy of it, with its packet identifier patched in.
+	
+	Notes:
+			- With a topic alias the header is encoded for the client, as the topic and properties
+				differ. It is still only the header, which is a few bytes plus the topic.
+			- An instance is not thread-safe, as it reuses its internal buffer for each header.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_FANOUT_H
+#define NMQTT_FANOUT_H
+
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "message.h"
+#include "outbound.h"
+
+
+class NmqttFanout {
+	struct Variant {
+		std::string header;			// Fixed and variable header, or empty if not yet encoded.
+		uint32_t packetIDOffset = 0;
+	};
+	
+	std::string topic;
+	NmqttSharedBody body;
+	Variant variants[2][3][2];		// Retain, QoS, MQTT 5.
+	std::string local;
+	
+	bool encode(std::string &out, uint8_t qos, bool retain, bool v5, std::string_view topic,
+					uint16_t alias, uint32_t &packetIDOffset);
+
+public:
+	NmqttFanout(std::string_view topic, std::string_view payload);
+	NmqttFanout(std::string_view topic, NmqttSharedBody payload);
+	
+	const std::string& getTopic() { return topic; }
+	const NmqttSharedBody& getBody() { return body; }
+	
+	std::string_view header(MqttQoS qos, bool retain, MqttProtocolVersion version,
+							uint16_t packetID, uint16_t alias = 0, bool aliasKnown = false);
+};
+
+
+#endif
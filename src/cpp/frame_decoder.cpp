@@ -0,0 +1,128 @@
+/*
+	frame_decoder.cpp - Implementation for the NymphMQTT frame decoder class.
+	
+	Revision 0
+	
+	Features:
+			- Incrementally assembles MQTT packets (frames) from arbitrary chunks of received data.
+			
+	Notes:
+			- The remaining length is decoded one byte at a time, so that the fixed header may be
+				split over multiple reads.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "frame_decoder.h"
+
+
+// --- FEED ---
+// Consumes bytes from the provided data until either a full frame has been assembled, or the data
+// has been used up. The number of consumed bytes is returned in 'used'. Any bytes which were not
+// consumed should be fed again after the frame has been taken.
+//
+// Return codes:
+// * (-1)	corrupted data.
+// * (0) 	more bytes needed. All provided bytes were consumed.
+// * (1) 	a full frame is available via takeFrame().
+int NmqttFrameDecoder::feed(const char* data, size_t len, size_t &used) {
+	used = 0;
+	while (used < len) {
+		switch (state) {
+			case FRAME_COMMAND: {
+				// Assume the first byte is fine. This will be validated during message parsing.
+				frame.clear();
+				frame.push_back(data[used++]);
+				remaining = 0;
+				lengthBytes = 0;
+				state = FRAME_LENGTH;
+			}
+			
+			break;
+			case FRAME_LENGTH: {
+				// Variable byte integer: bits 0-6 contain data, bit 7 indicates that another
+				// byte follows. At most four bytes are allowed.
+				uint8_t byte = static_cast<uint8_t>(data[used++]);
+				frame.push_back(byte);
+				remaining |= (uint32_t) (byte & 0x7F) << (7 * lengthBytes++);
+				if (byte & 0x80) {
+					if (lengthBytes == 4) {
+						// Special bit on final byte should never be set.
+						state = FRAME_CORRUPT;
+						return -1;
+					}
+					
+					continue;
+				}
+				
+				if (remaining > maxFrameSize) {
+					state = FRAME_CORRUPT;
+					return -1;
+				}
+				
+				if (remaining == 0) {
+					state = FRAME_COMPLETE;
+					return 1;
+				}
+				
+				frame.reserve(frame.length() + remaining);
+				state = FRAME_BODY;
+			}
+			
+			break;
+			case FRAME_BODY: {
+				// Copy as much of the body as is available in one go.
+				size_t count = len - used;
+				if (count > remaining) { count = remaining; }
+				frame.append(data + used, count);
+				used += count;
+				remaining -= count;
+				if (remaining == 0) {
+					state = FRAME_COMPLETE;
+					return 1;
+				}
+			}
+			
+			break;
+			case FRAME_COMPLETE: {
+				// The previous frame has to be taken first.
+				return 1;
+			}
+			
+			break;
+			case FRAME_CORRUPT: {
+				return -1;
+			}
+			
+			break;
+		};
+	}
+	
+	if (state == FRAME_COMPLETE) { return 1; }
+	else if (state == FRAME_CORRUPT) { return -1; }
+	
+	return 0;
+}
+
+
+// --- TAKE FRAME ---
+// Moves the completed frame into the provided string and prepares for the next frame. The previous
+// contents of 'out' are discarded.
+void NmqttFrameDecoder::takeFrame(std::string &out) {
+	if (state != FRAME_COMPLETE) { return; }
+	
+	out.swap(frame);
+	frame.clear();
+	state = FRAME_COMMAND;
+}
+
+
+// --- RESET ---
+// Discards any partially received frame and clears the corrupted state.
+void NmqttFrameDecoder::reset() {
+	frame.clear();
+	remaining = 0;
+	lengthBytes = 0;
+	state = FRAME_COMMAND;
+}
@@ -0,0 +1,51 @@
+/*
+	frame_decoder.h - Header for the NymphMQTT frame decoder class.
+	
+	Revision 0
+	
+	Features:
+			- Incrementally assembles MQTT packets (frames) from arbitrary chunks of received data.
+			
+	Notes:
+			- A frame consists out of the fixed header (command byte and a 1-4 byte remaining 
+				length) followed by the remaining length number of bytes.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_FRAME_DECODER_H
+#define NMQTT_FRAME_DECODER_H
+
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+
+class NmqttFrameDecoder {
+	enum State {
+		FRAME_COMMAND,		// Waiting for the first byte of the fixed header.
+		FRAME_LENGTH,		// Reading the remaining length variable byte integer.
+		FRAME_BODY,			// Reading the remaining length number of bytes.
+		FRAME_COMPLETE,		// A full frame is available.
+		FRAME_CORRUPT		// Invalid data received. The stream cannot be recovered.
+	};
+	
+	State state = FRAME_COMMAND;
+	std::string frame;				// Frame being assembled, including the fixed header.
+	uint32_t remaining = 0;			// Remaining length of the current frame.
+	uint32_t lengthBytes = 0;		// Number of remaining length bytes read so far.
+	uint32_t maxFrameSize = 268435455;	// Maximum remaining length allowed by MQTT.
+	
+public:
+	int feed(const char* data, size_t len, size_t &used);
+	void takeFrame(std::string &out);
+	void reset();
+	
+	void setMaximumFrameSize(uint32_t size) { maxFrameSize = size; }
+	bool corrupted() { return state == FRAME_CORRUPT; }
+};
+
+
+#endif
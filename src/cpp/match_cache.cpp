@@ -0,0 +1,246 @@
+/*
+	match_cache.cpp - Implementation of the NymphMQTT topic match cache.
+	
+	Revision 0
+	
+	Features:
+			- Bounded cache of the subscribers which match a published topic.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "match_cache.h"
+
+#include <functional>
+#include <iterator>
+
+
+// Returns the first level of a topic or topic filter.
+static std::string_view firstLevel(std::string_view topic) {
+	return topic.substr(0, topic.find('/'));
+}
+
+
+// Returns true if any of the filters matches the topic.
+static bool matchesAny(const std::vector<std::string_view> &filters, std::string_view topic) {
+	for (std::string_view filter : filters) {
+		if (NmqttMatchCache::matches(filter, topic)) { return true; }
+	}
+	
+	return false;
+}
+
+
+// --- CONSTRUCTOR ---
+// The capacity is the maximum number of topics. Zero disables the cache.
+NmqttMatchCache::NmqttMatchCache(size_t capacity) {
+	shardCapacity = (capacity + shardCount - 1) / shardCount;
+}
+
+
+// --- SHARD ---
+NmqttMatchCache::Shard& NmqttMatchCache::shard(std::string_view topic) {
+	return shards[std::hash<std::string_view>()(topic) % shardCount];
+}
+
+
+// --- SET CAPACITY ---
+// Sets the maximum number of cached topics, and clears the cache. Zero disables it.
+void NmqttMatchCache::setCapacity(size_t capacity) {
+	shardCapacity = (capacity + shardCount - 1) / shardCount;
+	clear();
+}
+
+
+// --- LOOKUP ---
+// Copies the cached subscribers of a topic. Returns false if the topic is not cached.
+bool NmqttMatchCache::lookup(std::string_view topic, std::vector<NmqttSubscriber> &out) {
+	if (!enabled()) { return false; }
+	
+	Shard &s = shard(topic);
+	Poco::Mutex::ScopedLock lock(s.mutex);
+	std::unordered_map<std::string_view, std::list<Entry>::iterator>::iterator it;
+	it = s.index.find(topic);
+	if (it == s.index.end()) {
+		s.misses++;
+		return false;
+	}
+	
+	s.hits++;
+	s.entries.splice(s.entries.begin(), s.entries, it->second);
+	out = it->second->subscribers;
+	return true;
+}
+
+
+// --- INSERT ---
+// Stores the subscribers of a topic, as found by a lookup in the topic tree which started at the
+// provided generation. Nothing is stored if a change has been committed since.
+void NmqttMatchCache::insert(std::string_view topic, const std::vector<NmqttSubscriber> &subscribers,
+																	uint64_t gen) {
+	size_t capacity = shardCapacity.load(std::memory_order_relaxed);
+	if (capacity == 0) { return; }
+	
+	Shard &s = shard(topic);
+	Poco::Mutex::ScopedLock lock(s.mutex);
+	if (generation.load(std::memory_order_seq_cst) != gen || s.index.count(topic)) { return; }
+	
+	while (s.entries.size() >= capacity) {
+		remove(s, std::prev(s.entries.end()));
+		s.evictions++;
+	}
+	
+	Entry entry;
+	entry.topic.assign(topic.data(), topic.length());
+	entry.subscribers = subscribers;
+	s.entries.push_front(std::move(entry));
+	Entry &e = s.entries.front();
+	s.index.insert(std::pair<std::string_view, std::list<Entry>::iterator>(e.topic,
+																		s.entries.begin()));
+	
+	// Element pointers of the levels map remain valid when it rehashes.
+	e.level = &*s.levels.try_emplace(std::string(firstLevel(topic))).first;
+	e.levelPos = e.level->second.insert(e.level->second.end(), &e);
+}
+
+
+// --- REMOVE ---
+// Removes an entry from the shard, its index and the group of its first topic level. The shard has
+// to be locked.
+void NmqttMatchCache::remove(Shard &s, std::list<Entry>::iterator it) {
+	Levels::value_type* level = it->level;
+	level->second.erase(it->levelPos);
+	if (level->second.empty()) { s.levels.erase(level->first); }
+	
+	s.index.erase(it->topic);
+	s.entries.erase(it);
+}
+
+
+// --- INVALIDATE ---
+// Removes the topics which match any of the changed topic filters. Called after the changes have
+// been published in the topic tree. Filters with a literal first level only check the entries
+// with that first level.
+void NmqttMatchCache::invalidate(const std::vector<std::string> &filters) {
+	generation.fetch_add(1, std::memory_order_seq_cst);
+	std::unordered_map<std::string, std::vector<std::string_view> > byLevel;
+	std::vector<std::string_view> wildcards;
+	for (const std::string &filter : filters) {
+		std::string_view first = firstLevel(filter);
+		if (first == "+" || first == "#") { wildcards.push_back(filter); }
+		else { byLevel[std::string(first)].push_back(filter); }
+	}
+	
+	bool all = wildcards.size() > maxFilters;
+	for (Shard &s : shards) {
+		Poco::Mutex::ScopedLock lock(s.mutex);
+		if (!all && wildcards.empty()) {
+			// Only visit the groups of the changed first levels.
+			for (const auto &changed : byLevel) {
+				Levels::iterator lv = s.levels.find(changed.first);
+				if (lv == s.levels.end()) { continue; }
+				
+				// The group is removed along with its last entry.
+				std::list<Entry*> &group = lv->second;
+				std::list<Entry*>::iterator it = group.begin();
+				while (it != group.end()) {
+					Entry* e = *it++;
+					bool last = it == group.end();
+					if (!matchesAny(changed.second, e->topic)) { continue; }
+					
+					remove(s, s.index.find(e->topic)->second);
+					s.invalidations++;
+					if (last) { break; }
+				}
+			}
+			
+			continue;
+		}
+		
+		std::list<Entry>::iterator it = s.entries.begin();
+		while (it != s.entries.end()) {
+			std::list<Entry>::iterator next = std::next(it);
+			bool match = all || matchesAny(wildcards, it->topic);
+			if (!match) {
+				std::unordered_map<std::string, std::vector<std::string_view> >::iterator f;
+				f = byLevel.find(it->level->first);
+				match = f != byLevel.end() && matchesAny(f->second, it->topic);
+			}
+			
+			if (match) {
+				remove(s, it);
+				s.invalidations++;
+			}
+			
+			it = next;
+		}
+	}
+}
+
+
+// --- CLEAR ---
+void NmqttMatchCache::clear() {
+	generation.fetch_add(1, std::memory_order_seq_cst);
+	for (Shard &s : shards) {
+		Poco::Mutex::ScopedLock lock(s.mutex);
+		s.index.clear();
+		s.levels.clear();
+		s.entries.clear();
+	}
+}
+
+
+// --- GET STATS ---
+NmqttMatchCacheStats NmqttMatchCache::getStats() {
+	NmqttMatchCacheStats stats;
+	for (Shard &s : shards) {
+		Poco::Mutex::ScopedLock lock(s.mutex);
+		stats.hits += s.hits;
+		stats.misses += s.misses;
+		stats.invalidations += s.invalidations;
+		stats.evictions += s.evictions;
+		stats.entries += s.entries.size();
+	}
+	
+	return stats;
+}
+
+
+// --- MATCHES ---
+// Returns true if a topic filter matches a topic. Wildcards at the first level do not match
+// topics starting with '$'.
+bool NmqttMatchCache::matches(std::string_view filter, std::string_view topic) {
+	if (!topic.empty() && topic[0] == '$' && !filter.empty()
+			&& (filter[0] == '+' || filter[0] == '#')) {
+		return false;
+	}
+	
+	size_t f = 0;
+	size_t t = 0;
+	for (;;) {
+		size_t fEnd = filter.find('/', f);
+		if (fEnd == std::string_view::npos) { fEnd = filter.length(); }
+		std::string_view level = filter.substr(f, fEnd - f);
+		if (level == "#") { return true; }
+		
+		size_t tEnd = topic.find('/', t);
+		if (tEnd == std::string_view::npos) { tEnd = topic.length(); }
+		if (level != "+" && level != topic.substr(t, tEnd - t)) { return false; }
+		
+		bool filterDone = fEnd == filter.length();
+		bool topicDone = tEnd == topic.length();
+		if (filterDone || topicDone) {
+			// A remaining "/#" also matches the parent level.
+			if (filterDone && topicDone) { return true; }
+			if (topicDone) { return filter.substr(fEnd) == "/#"; }
+			return false;
+		}
+		
+		f = fEnd + 1;
+		t = tEnd + 1;
+	}
+}
@@ -0,0 +1,110 @@
+/*
+	match_cache.h - Header for the NymphMQTT topic match cache.
+	
+	Revision 0
+	
+	Features:
+			- Bounded cache of the subscribers which match a published topic, so that the lookup
+				for a frequently published topic is a single hash lookup.
+			- Entries are invalidated when a subscription with a filter matching their topic
+				changes.
+			- Counters for hits, misses, invalidations and evictions.
+	
+	Notes:
+			- The cache is split into shards by topic hash, each with its own lock and least
+				recently used order.
+			- A lookup which misses reads the generation before walking the topic tree, and only
+				stores its result if no change has been committed meanwhile. A change is committed
+				by publishing it in the tree, advancing the generation and then invalidating the
+				matching entries, so a result from before a change is either invalidated or never
+				stored.
+			- Each shard also groups its entries by the first level of their topic. A changed
+				filter with a literal first level only checks the entries in its group, so that a
+				change under one branch of the topics does not scan the whole cache. A filter with
+				a wildcard at the first level checks every entry. A batch of changes with many
+				such filters clears the whole cache instead.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_MATCH_CACHE_H
+#define NMQTT_MATCH_CACHE_H
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include <Poco/Mutex.h>
+
+#include "topic_tree.h"
+
+
+struct NmqttMatchCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t invalidations = 0;		// Entries removed because of a subscription change.
+	uint64_t evictions = 0;			// Entries removed to make room.
+	uint64_t entries = 0;
+	
+	double hitRate() const { return (hits + misses) ? (double) hits / (hits + misses) : 0.0; }
+};
+
+
+class NmqttMatchCache {
+	struct Entry;
+	typedef std::unordered_map<std::string, std::list<Entry*> > Levels;
+	
+	struct Entry {
+		std::string topic;
+		std::vector<NmqttSubscriber> subscribers;
+		Levels::value_type* level;				// Group of the first topic level.
+		std::list<Entry*>::iterator levelPos;	// Position in the group.
+	};
+	
+	struct Shard {
+		std::list<Entry> entries;		// Most recently used first.
+		std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+		Levels levels;					// Entries by the first level of their topic.
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t invalidations = 0;
+		uint64_t evictions = 0;
+		Poco::Mutex mutex;
+	};
+	
+	static const size_t shardCount = 16;
+	static const size_t maxFilters = 32;
+	
+	Shard shards[shardCount];
+	std::atomic<size_t> shardCapacity;
+	std::atomic<uint64_t> generation { 0 };
+	
+	Shard& shard(std::string_view topic);
+	void remove(Shard &s, std::list<Entry>::iterator it);
+
+public:
+	NmqttMatchCache(size_t capacity = 4096);
+	
+	void setCapacity(size_t capacity);
+	bool enabled() { return shardCapacity.load(std::memory_order_relaxed) > 0; }
+	uint64_t getGeneration() { return generation.load(std::memory_order_seq_cst); }
+	
+	bool lookup(std::string_view topic, std::vector<NmqttSubscriber> &out);
+	void insert(std::string_view topic, const std::vector<NmqttSubscriber> &subscribers,
+																	uint64_t gen);
+	void invalidate(const std::vector<std::string> &filters);
+	void clear();
+	NmqttMatchCacheStats getStats();
+	
+	static bool matches(std::string_view filter, std::string_view topic);
+};
+
+
+#endif
@@ -23,10 +23,13 @@
 
 #include "message.h"
 #include "nymph_logger.h"
+#include "utf8_validator.h"
 
 #include <bytebauble.h>
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 
 // debug
 //#define DEBUG 1
@@ -34,6 +37,10 @@
 #endif
 
 
+// Static initialisations.
+std::string NmqttMessage::loggerName = "NmqttMessage";
+
+
 // --- CONSTRUCTOR ---
 // Default. Create empty message.
 NmqttMessage::NmqttMessage() {
@@ -51,7 +58,7 @@ NmqttMessage::NmqttMessage(MqttPacketType type) {
 // Parses the provided binary message, setting the appropriate internal variables and status flags
 // for reading out with other API functions.
 NmqttMessage::NmqttMessage(std::string msg) {
-	parseMessage(msg);
+	parseMessage(std::move(msg));
 }
 
 
@@ -61,60 +68,555 @@ NmqttMessage::~NmqttMessage() {
 }
 
 
+// --- STORE ---
+// Appends the string to the buffer, and sets the slice to it. The string previously in the slice 
+// is left in the buffer, which is compacted once such replaced strings take up most of it.
+void NmqttMessage::store(std::string &str, NmqttSlice &slice) {
+	garbage += slice.length;
+	if (buffer.empty()) {
+		// Take over the string's storage instead of copying it.
+		buffer = std::move(str);
+		slice.offset = 0;
+		slice.length = buffer.length();
+		garbage = 0;
+		return;
+	}
+	
+	slice.offset = buffer.length();
+	slice.length = str.length();
+	buffer += str;
+	if (garbage > buffer.length() / 2) { compact(); }
+}
+
+
+// --- COMPACT ---
+// Rebuilds the buffer with only the strings of the current fields and the properties section, 
+// removing replaced strings and the headers of a received message.
+void NmqttMessage::compact() {
+	std::string compacted;
+	compacted.reserve(buffer.length() - garbage);
+	auto keep = [&](NmqttSlice &slice) {
+		uint32_t offset = compacted.length();
+		compacted.append(buffer, slice.offset, slice.length);
+		slice.offset = offset;
+	};
+	
+	if (NmqttConnectFields* connect = connectFields()) {
+		keep(connect->clientId);
+		keep(connect->willTopic);
+		keep(connect->will);
+		keep(connect->username);
+		keep(connect->password);
+	}
+	else if (NmqttPublishFields* publish = get<NmqttPublishFields>()) {
+		keep(publish->topic);
+		keep(publish->payload);
+	}
+	else if (NmqttSubscribeFields* sub = get<NmqttSubscribeFields>()) {
+		keep(sub->topic);
+		keep(sub->filters);
+	}
+	else if (NmqttAckFields* ack = get<NmqttAckFields>()) {
+		keep(ack->reasonCodes);
+	}
+	
+	// Last, so that new properties can still be appended in place.
+	keep(properties);
+	buffer.swap(compacted);
+	garbage = 0;
+}
+
+
+// --- SET CLIENT ID ---
+void NmqttMessage::setClientId(std::string id) {
+	NmqttConnectFields* connect = connectFields();
+	if (!connect) { return; }
+	
+	store(id, connect->clientId);
+}
+
+
 // --- SET CREDENTIALS ---
 void NmqttMessage::setCredentials(std::string &user, std::string &pass) {
-	username = user;
-	password = pass;
-	usernameFlag = true;
-	passwordFlag = true;
+	NmqttConnectFields* connect = connectFields();
+	if (!connect) { return; }
+	
+	std::string u = user, p = pass;
+	store(u, connect->username);
+	store(p, connect->password);
+	connect->flags |= MQTT_CONNECT_USERNAME | MQTT_CONNECT_PASSWORD;
 }
 
 
 // --- SET WILL ---
 void NmqttMessage::setWill(std::string topic, std::string will, uint8_t qos, bool retain) {
-	this->will = will;
-	this->willTopic = topic;
-	this->willRetainFlag = retain;
-	this->willQoS = qos;
-	this->willFlag = true;
+	NmqttConnectFields* connect = connectFields();
+	if (!connect) { return; }
+	
+	store(will, connect->will);
+	store(topic, connect->willTopic);
+	connect->flags &= ~(MQTT_CONNECT_WILL_QOS_L1 | MQTT_CONNECT_WILL_QOS_L2 | MQTT_CONNECT_WILL_RETAIN);
+	connect->flags |= MQTT_CONNECT_WILL;
+	if (retain) { connect->flags |= MQTT_CONNECT_WILL_RETAIN; }
 	if (qos == 1) { 
-		willQoS1 = true;
+		connect->flags |= MQTT_CONNECT_WILL_QOS_L1;
 	}
 	else if (qos == 2) {
-		willQoS2 = true;
+		connect->flags |= MQTT_CONNECT_WILL_QOS_L2;
+	}
+}
+
+
+// --- SET PACKET ID ---
+void NmqttMessage::setPacketID(uint16_t id) {
+	if (NmqttPublishFields* publish = get<NmqttPublishFields>()) { publish->packetID = id; }
+	else if (NmqttSubscribeFields* sub = get<NmqttSubscribeFields>()) { sub->packetID = id; }
+	else if (NmqttAckFields* ack = get<NmqttAckFields>()) { ack->packetID = id; }
+}
+
+
+// --- SET TOPIC ---
+// Sets the topic for PUBLISH, or the topic filter for SUBSCRIBE and UNSUBSCRIBE.
+void NmqttMessage::setTopic(std::string topic) {
+	if (NmqttPublishFields* publish = get<NmqttPublishFields>()) { store(topic, publish->topic); }
+	else if (NmqttSubscribeFields* sub = get<NmqttSubscribeFields>()) { store(topic, sub->topic); }
+}
+
+
+// --- SET PAYLOAD ---
+// Sets the payload for PUBLISH. Pass the payload using std::move() to avoid copying it, if it is
+// set before the topic.
+void NmqttMessage::setPayload(std::string payload) {
+	if (NmqttPublishFields* publish = get<NmqttPublishFields>()) { 
+		store(payload, publish->payload);
+	}
+}
+
+
+// --- SET REASON CODE ---
+// Sets the reason code of an acknowledgement.
+void NmqttMessage::setReasonCode(MqttReasonCodes code) {
+	if (NmqttConnackFields* connack = get<NmqttConnackFields>()) { connack->reasonCode = code; }
+	else if (NmqttAckFields* ack = get<NmqttAckFields>()) { ack->reasonCode = code; }
+}
+
+
+// --- SET REASON CODES ---
+// Sets the reason codes of a SUBACK or UNSUBACK message, one byte per topic filter of the request.
+void NmqttMessage::setReasonCodes(std::string codes) {
+	NmqttAckFields* ack = get<NmqttAckFields>();
+	if (!ack) { return; }
+	
+	if (!codes.empty()) { ack->reasonCode = (uint8_t) codes[0]; }
+	store(codes, ack->reasonCodes);
+}
+
+
+// --- GETTERS ---
+uint16_t NmqttMessage::getPacketID() const {
+	if (const NmqttPublishFields* publish = get<NmqttPublishFields>()) { return publish->packetID; }
+	else if (const NmqttSubscribeFields* sub = get<NmqttSubscribeFields>()) { return sub->packetID; }
+	else if (const NmqttAckFields* ack = get<NmqttAckFields>()) { return ack->packetID; }
+	
+	return 0;
+}
+
+
+uint8_t NmqttMessage::getConnectFlags() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? connect->flags : 0;
+}
+
+
+uint16_t NmqttMessage::getKeepAlive() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? connect->keepAlive : 0;
+}
+
+
+bool NmqttMessage::getSessionPresent() const {
+	const NmqttConnackFields* connack = get<NmqttConnackFields>();
+	return connack ? connack->sessionPresent : false;
+}
+
+
+MqttReasonCodes NmqttMessage::getReasonCode() const {
+	if (const NmqttConnackFields* connack = get<NmqttConnackFields>()) { 
+		return (MqttReasonCodes) connack->reasonCode;
+	}
+	else if (const NmqttAckFields* ack = get<NmqttAckFields>()) {
+		return (MqttReasonCodes) ack->reasonCode;
+	}
+	
+	return MQTT_CODE_SUCCESS;
+}
+
+
+std::string_view NmqttMessage::getTopicView() const {
+	if (const NmqttPublishFields* publish = get<NmqttPublishFields>()) { 
+		return view(publish->topic);
+	}
+	else if (const NmqttSubscribeFields* sub = get<NmqttSubscribeFields>()) {
+		return view(sub->topic);
+	}
+	
+	return std::string_view();
+}
+
+
+std::string_view NmqttMessage::getPayloadView() const {
+	const NmqttPublishFields* publish = get<NmqttPublishFields>();
+	return publish ? view(publish->payload) : std::string_view();
+}
+
+
+std::string_view NmqttMessage::getWillView() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? view(connect->will) : std::string_view();
+}
+
+
+std::string_view NmqttMessage::getWillTopicView() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? view(connect->willTopic) : std::string_view();
+}
+
+
+std::string_view NmqttMessage::getClientIdView() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? view(connect->clientId) : std::string_view();
+}
+
+
+std::string_view NmqttMessage::getUsernameView() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? view(connect->username) : std::string_view();
+}
+
+
+std::string_view NmqttMessage::getPasswordView() const {
+	NmqttConnectFields* connect = connectFields();
+	return connect ? view(connect->password) : std::string_view();
+}
+
+
+std::string_view NmqttMessage::getReasonCodesView() const {
+	const NmqttAckFields* ack = get<NmqttAckFields>();
+	return ack ? view(ack->reasonCodes) : std::string_view();
+}
+
+
+// --- GET TOPIC FILTER COUNT ---
+uint32_t NmqttMessage::getTopicFilterCount() const {
+	uint32_t count = 0;
+	std::string_view filter;
+	uint8_t options;
+	while (getTopicFilter(count, filter, options)) { count++; }
+	
+	return count;
+}
+
+
+// --- GET TOPIC FILTER ---
+// Returns the n-th topic filter of a received SUBSCRIBE or UNSUBSCRIBE message, with its 
+// subscription options. The list has been validated while parsing. Returns false if there is no
+// such topic filter.
+bool NmqttMessage::getTopicFilter(uint32_t n, std::string_view &filter, uint8_t &options) const {
+	const NmqttSubscribeFields* sub = get<NmqttSubscribeFields>();
+	if (!sub) { return false; }
+	
+	std::string_view list = view(sub->filters);
+	size_t optionBytes = (command == MQTT_SUBSCRIBE) ? 1 : 0;
+	size_t idx = 0;
+	for (;;) {
+		if (idx + 2 > list.length()) { return false; }
+		size_t len = ((uint8_t) list[idx] << 8) | (uint8_t) list[idx + 1];
+		if (idx + 2 + len + optionBytes > list.length()) { return false; }
+		if (n-- == 0) {
+			filter = list.substr(idx + 2, len);
+			options = optionBytes ? (uint8_t) list[idx + 2 + len] : 0;
+			return true;
+		}
+		
+		idx += 2 + len + optionBytes;
+	}
+}
+
+
+// --- FIND PROPERTY ---
+// Returns the index entry for the first property with the provided identifier, or null.
+const NmqttPropertyEntry* NmqttMessage::findProperty(MqttPropertyId id) const {
+	for (const NmqttPropertyEntry &entry : propertyIndex) {
+		if (entry.id == id) { return &entry; }
+	}
+	
+	return 0;
+}
+
+
+// --- GET PROPERTY ---
+// Decodes the integer value of the property. Returns false if the property is not present or not
+// of an integer type.
+bool NmqttMessage::getProperty(MqttPropertyId id, uint32_t &value) const {
+	const NmqttPropertyEntry* entry = findProperty(id);
+	if (!entry) { return false; }
+	
+	MqttPropertyType t = NmqttProperties::type(id);
+	if (t == MQTT_PROP_TYPE_UTF8_STRING || t == MQTT_PROP_TYPE_BINARY_DATA 
+			|| t == MQTT_PROP_TYPE_UTF8_PAIR) { 
+		return false;
+	}
+	
+	value = NmqttProperties::decodeInt(view(properties), *entry);
+	return true;
+}
+
+
+// Decodes the string or binary data value of the property. Returns false if the property is not
+// present or not of a string type.
+bool NmqttMessage::getProperty(MqttPropertyId id, std::string_view &value) const {
+	const NmqttPropertyEntry* entry = findProperty(id);
+	if (!entry) { return false; }
+	
+	MqttPropertyType t = NmqttProperties::type(id);
+	if (t != MQTT_PROP_TYPE_UTF8_STRING && t != MQTT_PROP_TYPE_BINARY_DATA) { return false; }
+	
+	value = NmqttProperties::decodeString(view(properties), *entry);
+	return true;
+}
+
+
+// --- GET USER PROPERTY COUNT ---
+uint32_t NmqttMessage::getUserPropertyCount() const {
+	uint32_t count = 0;
+	for (const NmqttPropertyEntry &entry : propertyIndex) {
+		if (entry.id == MQTT_PROP_USER_PROPERTY) { count++; }
+	}
+	
+	return count;
+}
+
+
+// --- GET USER PROPERTY ---
+// Decodes the n-th User Property. Returns false if there is no such property.
+bool NmqttMessage::getUserProperty(uint32_t n, std::string_view &key, std::string_view &value) const {
+	for (const NmqttPropertyEntry &entry : propertyIndex) {
+		if (entry.id != MQTT_PROP_USER_PROPERTY) { continue; }
+		if (n-- > 0) { continue; }
+		
+		key = NmqttProperties::decodeString(view(properties), entry);
+		value = NmqttProperties::decodePairValue(view(properties), entry);
+		return true;
+	}
+	
+	return false;
+}
+
+
+// --- APPEND PROPERTIES ---
+// Appends encoded properties to the properties section, which is kept contiguous at the end of the
+// buffer.
+void NmqttMessage::appendProperties(std::string_view encoded) {
+	if (properties.length == 0 || properties.offset + properties.length != buffer.length()) {
+		// Move the properties section to the end of the buffer.
+		std::string existing(view(properties));
+		garbage += properties.length;
+		properties.offset = buffer.length();
+		buffer += existing;
+	}
+	
+	buffer.append(encoded.data(), encoded.length());
+	properties.length += encoded.length();
+	NmqttProperties::scan(view(properties), propertyIndex);
+	if (garbage > buffer.length() / 2) { compact(); }
+}
+
+
+// --- REMOVE PROPERTY ---
+// Removes all properties with the provided identifier, by rebuilding the properties section 
+// without them.
+void NmqttMessage::removeProperty(MqttPropertyId id) {
+	if (!findProperty(id)) { return; }
+	
+	// An entry holds the offset of the value, which follows the one-byte identifier.
+	std::string_view section = view(properties);
+	std::string kept;
+	for (size_t i = 0; i < propertyIndex.size(); ++i) {
+		uint32_t start = propertyIndex[i].offset - 1;
+		uint32_t end = (i + 1 < propertyIndex.size()) ? propertyIndex[i + 1].offset - 1 : 
+															section.length();
+		if (propertyIndex[i].id != id) { kept.append(section.substr(start, end - start)); }
 	}
+	
+	clearProperties();
+	if (!kept.empty()) { appendProperties(kept); }
+}
+
+
+// --- SET PROPERTY ---
+// Sets an integer property, replacing any previous value. Returns false if the property is not of 
+// an integer type.
+bool NmqttMessage::setProperty(MqttPropertyId id, uint32_t value) {
+	std::string encoded;
+	if (!NmqttProperties::encode(encoded, id, value)) { return false; }
+	
+	removeProperty(id);
+	appendProperties(encoded);
+	return true;
+}
+
+
+// Sets a string or binary data property, replacing any previous value. Returns false if the 
+// property is not of a string type.
+bool NmqttMessage::setProperty(MqttPropertyId id, std::string_view value) {
+	std::string encoded;
+	if (!NmqttProperties::encode(encoded, id, value)) { return false; }
+	
+	removeProperty(id);
+	appendProperties(encoded);
+	return true;
+}
+
+
+// --- ADD USER PROPERTY ---
+bool NmqttMessage::addUserProperty(std::string_view key, std::string_view value) {
+	std::string encoded;
+	if (!NmqttProperties::encode(encoded, key, value)) { return false; }
+	
+	appendProperties(encoded);
+	return true;
+}
+
+
+// --- SET PROPERTIES ---
+// Replaces the properties with an encoded properties section, such as the one of a received 
+// message. Returns false if the section is malformed.
+bool NmqttMessage::setProperties(std::string_view encoded) {
+	std::vector<NmqttPropertyEntry> index;
+	if (NmqttProperties::scan(encoded, index) < 0) { return false; }
+	
+	clearProperties();
+	appendProperties(encoded);
+	return true;
+}
+
+
+// --- CLEAR PROPERTIES ---
+void NmqttMessage::clearProperties() {
+	garbage += properties.length;
+	properties = NmqttSlice();
+	propertyIndex.clear();
 }
 
 
 // --- CREATE MESSAGE ---
-// Set the command type. Returns false if the command type is invalid, for example when the current
-// protocol version does not support it.
+// Set the command type, with the default fields for this type. Returns false if the command type 
+// is invalid, for example when the current protocol version does not support it.
 bool NmqttMessage::createMessage(MqttPacketType type) {
 	if (type == MQTT_AUTH && mqttVersion == MQTT_PROTOCOL_VERSION_4) { return false; }
 	
-	if (type == MQTT_CONNECT) {
-		// Set default connect options.
-		cleanSessionFlag = true;
-		willFlag = false;
-		willRetainFlag = false;
-		usernameFlag = false;
-		passwordFlag = false;
-		willQoS1 = false;
-		willQoS2 = false;
-	}
-	
+	buffer.clear();
 	command = type;
+	resetFields();
 	
 	return true;
 }
 
 
+// --- RESET FIELDS ---
+// Sets the default fields for the current command type.
+void NmqttMessage::resetFields() {
+	clearProperties();
+	garbage = 0;
+	switch (command) {
+		case MQTT_CONNECT: fields = NmqttBox<NmqttConnectFields>(); break;
+		case MQTT_CONNACK: fields = NmqttConnackFields(); break;
+		case MQTT_PUBLISH: fields = NmqttPublishFields(); break;
+		case MQTT_SUBSCRIBE:
+		case MQTT_UNSUBSCRIBE: fields = NmqttSubscribeFields(); break;
+		case MQTT_PUBACK:
+		case MQTT_PUBREC:
+		case MQTT_PUBREL:
+		case MQTT_PUBCOMP:
+		case MQTT_SUBACK:
+		case MQTT_UNSUBACK:
+		case MQTT_DISCONNECT: fields = NmqttAckFields(); break;
+		default: fields = std::monostate(); break;
+	};
+}
+
+
 // --- PARSE MESSAGE ---
+// Takes ownership of the provided binary message and parses it. Pass the message using std::move()
+// to avoid copying it.
 int NmqttMessage::parseMessage(std::string msg) {
+	buffer = std::move(msg);
+	return parseBuffer();
+}
+
+
+// --- PARSE FRAME ---
+// Swaps the provided binary message into the buffer and parses it. The provided string receives
+// the previous buffer, so that its capacity can be reused for the next message.
+int NmqttMessage::parseFrame(std::string &frame) {
+	buffer.swap(frame);
+	frame.clear();
+	return parseBuffer();
+}
+
+
+// --- READ STRING ---
+// Reads a UTF-8 string with its big-endian, two-byte length header from the buffer at the provided
+// index. The index is moved past the string. Returns false if the string exceeds the buffer.
+bool NmqttMessage::readString(uint32_t &idx, NmqttSlice &slice) {
+	if (idx + 2 > buffer.length()) { return false; }
+	
+	uint16_t len = ((uint8_t) buffer[idx] << 8) | (uint8_t) buffer[idx + 1];
+	idx += 2;
+	if (idx + len > buffer.length()) { return false; }
+	
+	slice.offset = idx;
+	slice.length = len;
+	idx += len;
+	
+	return true;
+}
+
+
+// --- READ PROPERTIES ---
+// Reads an MQTT 5 properties section at the provided index, moving the index past it. The 
+// properties are stored in the provided slice, or as the message's properties if none is provided.
+// Only the latter are indexed. Returns false if the section is malformed.
+bool NmqttMessage::readProperties(uint32_t &idx, NmqttSlice *slice) {
+	uint32_t len;
+	if (idx >= buffer.length()) { return false; }
+	int bytes = NmqttProperties::readVarInt(buffer.data() + idx, buffer.length() - idx, len);
+	if (bytes < 0 || idx + bytes + len > buffer.length()) { return false; }
+	
+	idx += bytes;
+	NmqttSlice section;
+	section.offset = idx;
+	section.length = len;
+	idx += len;
+	
+	if (slice) {
+		*slice = section;
+		return true;
+	}
+	
+	properties = section;
+	return NmqttProperties::scan(view(properties), propertyIndex) >= 0;
+}
+
+
+// --- PARSE BUFFER ---
+// Parses the binary message in the buffer. String fields are stored as slices of the buffer.
+int NmqttMessage::parseBuffer() {
 	// Set initial flags.
 	parseGood = false;
 	
-	int idx = 0;
+	const std::string &msg = buffer;
+	uint32_t idx = 0;
 	
 	// Start by reading the fixed header, determining which command we're dealing with and the
 	// remaining message length.
@@ -134,23 +636,30 @@ int NmqttMessage::parseMessage(std::string msg) {
 	// Read out the first byte. Mask bits 0-3 as they're not used here.
 	// Also read out the DUP, QoS and Retain flags.
 	uint8_t byte0 = static_cast<uint8_t>(msg[0]);
-	command = (MqttPacketType) (byte0 & 0xF0); // TODO: validate range.
+	command = byte0 & 0xF0;
 	duplicateMessage = (byte0 >> 3) & 1U;
-	uint8_t qosCnt = 0;
-	if ((byte0 >> 2) & 1U) { QoS = MQTT_QOS_AT_LEAST_ONCE; qosCnt++; }
-	if ((byte0 >> 1) & 1U) { QoS = MQTT_QOS_EXACTLY_ONCE; qosCnt++; }
-	if (qosCnt > 1) { QoS = MQTT_QOS_AT_MOST_ONCE; }
+	uint8_t qosBits = (byte0 >> 1) & 3U;
+	if (qosBits == 1) { QoS = MQTT_QOS_AT_LEAST_ONCE; }
+	else if (qosBits == 2) { QoS = MQTT_QOS_EXACTLY_ONCE; }
+	else { QoS = MQTT_QOS_AT_MOST_ONCE; }
 	retainMessage = byte0 & 1U;
+	resetFields();
 	idx++;
 	
 	// Debug
 #ifdef DEBUG
-	std::cout << "Found command: 0x" << std::hex << command << std::endl;
+	std::cout << "Found command: 0x" << std::hex << (int) command << std::endl;
 #endif
 		
 	// Get the message length decoded using ByteBauble's method.
-	uint32_t pInt = (uint32_t) msg[1];
-	int pblen = bytebauble.readPackedInt(pInt, messageLength);
+	// Up to four bytes are used for the packed integer, the first of which is in the LSB.
+	uint32_t pInt = 0;
+	for (uint32_t i = 1; i < 5 && i < msg.length(); ++i) {
+		pInt |= (uint32_t) (uint8_t) msg[i] << ((i - 1) * 8);
+	}
+	
+	uint32_t messageLength;
+	int pblen = ByteBauble::readPackedInt(pInt, messageLength);
 	idx += pblen;
 	
 	// debug
@@ -173,74 +682,77 @@ int NmqttMessage::parseMessage(std::string msg) {
 			// Server.
 			// Decode variable header.
 			// First field: protocol name '0x00 0x04 M Q T T'.
-			std::string protName = msg.substr(idx, 6);
-			std::string protMatch = { 0x00, 0x04, 'M', 'Q', 'T', 'T' };
-			if (protName != protMatch) {
+			std::string_view protName(msg.data() + idx, std::min<size_t>(6, msg.length() - idx));
+			static const char protMatch[] = { 0x00, 0x04, 'M', 'Q', 'T', 'T' };
+			if (protName != std::string_view(protMatch, 6)) {
 				std::cerr << "CONNECT protocol name incorrect, got: " << protName << std::endl;
 				return -1;
 			}
 			
 			idx += 6;
 			
-			// Protocol level: one byte.
+			// Protocol level and connect flags: one byte each, followed by the keep alive value: 
+			// two bytes (MSB, LSB).
+			if (idx + 4 > msg.length()) { return -1; }
+			NmqttConnectFields* connect = connectFields();
 			uint8_t protver = (uint8_t) msg[idx++];
 			if (protver == 4) { mqttVersion = MQTT_PROTOCOL_VERSION_4; }
-			else if (protver == 5) { mqttVersion == MQTT_PROTOCOL_VERSION_5; }
+			else if (protver == 5) { mqttVersion = MQTT_PROTOCOL_VERSION_5; }
 			else {
 				std::cerr << "Invalid MQTT version: " << (uint16_t) protver << std::endl;
 				// FIXME: Server must return CONNACK with code 0x01 in this case.
 				return -1;
 			}
 			
-			// Connect flags: one byte.
-			uint8_t connflags = (uint8_t) msg[idx++];
-			usernameFlag = (connflags >> 7) & 1U;
-			passwordFlag = (connflags >> 6) & 1U;
-			willRetainFlag = (connflags >> 5) & 1U;
-			willQoS = (((connflags >> 4) & 1U) << 1) + (connflags >> 3) & 1U;
-			willFlag = (connflags >> 2) & 1U;
-			cleanSessionFlag = (connflags >> 1) & 1U;
-			if (connflags & 1U) {
+			// Connect flags.
+			connect->flags = (uint8_t) msg[idx++];
+			if (connect->flags & 1U) {
 				std::cerr << "Reserved flag in connect flags set. Aborting parse." << std::endl;
 				return -1;
 			}
 			
-			// Keep alive value: two bytes.
-			keepAlive = (uint16_t) msg[idx];
+			connect->keepAlive = ((uint8_t) msg[idx] << 8) | (uint8_t) msg[idx + 1];
 			idx += 2;
 			
+			// MQTT 5: CONNECT properties.
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && !readProperties(idx)) {
+				std::cerr << "CONNECT properties malformed." << std::endl;
+				return -1;
+			}
+			
 			// Payload section.
 			// Client ID. UTF-8 string, preceded by two bytes (MSB, LSB) with the length.
-			// TODO: convert BE length int to host int.
-			uint16_t len = (uint16_t) msg[idx];
-			idx += 2;
-			clientId = msg.substr(idx, len);
-			idx += len;
-			
-			if (willFlag) {
-				uint16_t len = (uint16_t) msg[idx];
-				idx += 2;
-				willTopic = msg.substr(idx, len);
-				idx += len;
+			if (!readString(idx, connect->clientId)) { return -1; }
+			if (!NmqttUtf8Validator::validString(view(connect->clientId))) {
+				std::cerr << "CONNECT client ID is not valid UTF-8." << std::endl;
+				return -1;
+			}
 			
-				len = (uint16_t) msg[idx];
-				idx += 2;
-				will = msg.substr(idx, len);
-				idx += len;
+			if (connect->flags & MQTT_CONNECT_WILL) {
+				// MQTT 5: Will properties. These are not indexed.
+				NmqttSlice willProperties;
+				if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && !readProperties(idx, &willProperties)) {
+					return -1;
+				}
+				
+				if (!readString(idx, connect->willTopic)) { return -1; }
+				if (!readString(idx, connect->will)) { return -1; }
+				if (!NmqttUtf8Validator::validTopicName(view(connect->willTopic))) {
+					std::cerr << "CONNECT will topic is invalid." << std::endl;
+					return -1;
+				}
 			}
 			
-			if (usernameFlag) {
-				uint16_t len = (uint16_t) msg[idx];
-				idx += 2;
-				username = msg.substr(idx, len);
-				idx += len;
+			if (connect->flags & MQTT_CONNECT_USERNAME) {
+				if (!readString(idx, connect->username)) { return -1; }
+				if (!NmqttUtf8Validator::validString(view(connect->username))) {
+					std::cerr << "CONNECT username is not valid UTF-8." << std::endl;
+					return -1;
+				}
 			}
 			
-			if (passwordFlag) {
-				uint16_t len = (uint16_t) msg[idx];
-				idx += 2;
-				password = msg.substr(idx, len);
-				idx += len;
+			if (connect->flags & MQTT_CONNECT_PASSWORD) {
+				if (!readString(idx, connect->password)) { return -1; }
 			}
 		}
 		
@@ -250,111 +762,205 @@ int NmqttMessage::parseMessage(std::string msg) {
 			
 			// Basic parse: just get the variable header up till the reason code.
 			// For MQTT 5 we also need to read out the properties that follow after the reason code.
-			sessionPresent = msg[idx++];
-			reasonCode = (MqttReasonCodes) msg[idx++];
+			if (idx + 2 > msg.length()) { return -1; }
+			NmqttConnackFields* connack = get<NmqttConnackFields>();
+			connack->sessionPresent = msg[idx++] & 1U;
+			connack->reasonCode = (uint8_t) msg[idx++];
+			
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && idx < msg.length()) {
+				if (!readProperties(idx)) {
+					std::cerr << "CONNACK properties malformed." << std::endl;
+					return -1;
+				}
+			}
 		}
 		
 		break;
 		case MQTT_PUBLISH: {
 			NYMPH_LOG_INFORMATION("Received PUBLISH message.");
 			
-			// Expect just the topic length (two bytes) and the topic string.
-			// UTF-8 strings in MQTT have a big-endian, two-byte length header.
-			uint16_t lenBE = *((uint16_t*) &msg[idx]);
+			// Both QoS bits set is a malformed packet (MQTT-3.3.1-4).
+			if (qosBits == 3) {
+				std::cerr << "PUBLISH QoS is invalid." << std::endl;
+				return -1;
+			}
 			
-			// Debug
-#ifdef DEBUG
-			std::cout << "String length (BE): 0x" << std::hex << lenBE << std::endl;
-#endif
+			// Expect just the topic length (two bytes) and the topic string.
+			// UTF-8 strings in MQTT have a big-endian, two-byte length header. The fields are only
+			// set once the whole message has been validated.
+			NmqttSlice topic;
+			if (!readString(idx, topic)) {
+				std::cerr << "PUBLISH topic exceeds message length." << std::endl;
+				return -1;
+			}
 			
-			uint16_t strlen = bytebauble.toHost(lenBE, BB_BE);
-			idx += 2;
-			topic = msg.substr(idx, strlen);
+			// The topic has to be valid UTF-8 and cannot contain wildcards.
+			if (!NmqttUtf8Validator::validTopicName(view(topic))) {
+				std::cerr << "PUBLISH topic is invalid." << std::endl;
+				return -1;
+			}
 			
 			// Debug
 #ifdef DEBUG
-			std::cout << "Strlen: " << strlen << ", topic: " << topic << std::endl;
+			std::cout << "Strlen: " << topic.length << ", topic: " << view(topic) << std::endl;
 #endif
 			
-			idx += strlen;
-		
 			// Handle QoS 1+ here.
 			// Parse out the two bytes containing the packet identifier. This is in BE format
 			// (MSB/LSB).
-			if (qosCnt > 0) {
-				uint16_t pIDBE = *((uint16_t*) &msg[idx]);
-				packetID = bytebauble.toHost(pIDBE, BB_BE);
+			uint16_t packetID = 0;
+			if (QoS != MQTT_QOS_AT_MOST_ONCE) {
+				if (idx + 2 > msg.length()) { return -1; }
+				packetID = ((uint8_t) msg[idx] << 8) | (uint8_t) msg[idx + 1];
 				idx += 2;
 			}
 			
+			NmqttSlice section;
+			std::vector<NmqttPropertyEntry> index;
 			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
-				// MQTT 5: Expect no properties here (0x00).
+				// MQTT 5: PUBLISH properties. These are only scanned here, values are decoded on
+				// access.
 				
 				// Debug
 #ifdef DEBUG
 				std::cout << "Index for properties: " << idx << std::endl;
 #endif
 				
-				uint8_t properties = msg[idx++];
-				if (properties != 0x00) {
-					std::cerr << "Expected no properties. Got: " << (int) properties << std::endl;
+				if (!readProperties(idx, &section)
+						|| NmqttProperties::scan(view(section), index) < 0) {
+					std::cerr << "PUBLISH properties malformed." << std::endl;
+					return -1;
 				}
 			}
 			
-			// Read the payload. This is the remaining section of the message (if any).
-			if (idx + 1 != msg.length()) {
-				payload = msg.substr(idx);
-			}
-		}
-		
-		break;
-		case MQTT_PUBACK: {
-			NYMPH_LOG_INFORMATION("Received PUBACK message.");
+			NmqttPublishFields* publish = get<NmqttPublishFields>();
+			publish->topic = topic;
+			publish->packetID = packetID;
+			properties = section;
+			propertyIndex.swap(index);
 			
-			//
-		}
-		
-		break;
-		case MQTT_PUBREC: {
-			//
-		}
-		
-		break;
-		case MQTT_PUBREL: {
-			//
+			// The payload is the remaining section of the message (if any).
+			if (idx < msg.length()) {
+				publish->payload.offset = idx;
+				publish->payload.length = msg.length() - idx;
+			}
 		}
 		
 		break;
+		case MQTT_PUBACK:
+		case MQTT_PUBREC:
+		case MQTT_PUBREL:
 		case MQTT_PUBCOMP: {
-			//
-		}
-		
-		break;
-		case MQTT_SUBSCRIBE: {
-			// Server.
-			// TODO: implement.
-			// 
-		}
-		
-		break;
-		case MQTT_SUBACK: {
-			NYMPH_LOG_INFORMATION("Received SUBACK message.");
+			// Packet identifier, followed by the reason code and properties with MQTT 5. These 
+			// may be left out when the reason code is success and there are no properties.
+			if (idx + 2 > msg.length()) { return -1; }
+			NmqttAckFields* ack = get<NmqttAckFields>();
+			ack->packetID = ((uint8_t) msg[idx] << 8) | (uint8_t) msg[idx + 1];
+			idx += 2;
 			
-			//
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && idx < msg.length()) {
+				ack->reasonCode = (uint8_t) msg[idx++];
+				if (idx < msg.length() && !readProperties(idx)) { return -1; }
+			}
 		}
 		
 		break;
+		case MQTT_SUBSCRIBE:
 		case MQTT_UNSUBSCRIBE: {
 			// Server.
-			// TODO: implement.
-			//
+			// The fixed header flags have the required value 0x2 (MQTT-3.8.1-1, MQTT-3.10.1-1).
+			if ((byte0 & 0x0F) != MQTT_FLAGS_SUBSCRIBE) {
+				std::cerr << "SUBSCRIBE or UNSUBSCRIBE with invalid flags." << std::endl;
+				return -1;
+			}
+			
+			// The fields are only set once the whole message has been validated.
+			if (idx + 2 > msg.length()) { return -1; }
+			uint16_t packetID = ((uint8_t) msg[idx] << 8) | (uint8_t) msg[idx + 1];
+			idx += 2;
+			
+			NmqttSlice section;
+			std::vector<NmqttPropertyEntry> index;
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && (!readProperties(idx, &section)
+						|| NmqttProperties::scan(view(section), index) < 0)) {
+				std::cerr << "SUBSCRIBE or UNSUBSCRIBE properties malformed." << std::endl;
+				return -1;
+			}
+			
+			// Payload: the list of topic filters. With SUBSCRIBE each filter is followed by its
+			// subscription options. The reserved bits are zero, and QoS 3 is invalid. MQTT 5 adds
+			// the No Local, Retain As Published and Retain Handling options.
+			NmqttSlice filters;
+			filters.offset = idx;
+			filters.length = msg.length() - idx;
+			uint8_t reserved = (mqttVersion == MQTT_PROTOCOL_VERSION_5) ? 0xC0 : 0xFC;
+			NmqttSlice topic;
+			uint8_t topicOptions = 0;
+			bool first = true;
+			while (idx < msg.length()) {
+				NmqttSlice filter;
+				if (!readString(idx, filter)) { return -1; }
+				if (!NmqttUtf8Validator::validTopicFilter(view(filter))) {
+					std::cerr << "SUBSCRIBE or UNSUBSCRIBE topic filter is invalid." << std::endl;
+					return -1;
+				}
+				
+				uint8_t options = 0;
+				if (command == MQTT_SUBSCRIBE) {
+					if (idx >= msg.length()) { return -1; }
+					options = (uint8_t) msg[idx++];
+					if ((options & 0x03) == 0x03 || (options & reserved)
+							|| (options & 0x30) == 0x30) {
+						std::cerr << "SUBSCRIBE options are invalid." << std::endl;
+						return -1;
+					}
+				}
+				
+				if (first) {
+					topic = filter;
+					topicOptions = options;
+					first = false;
+				}
+			}
+			
+			// At least one topic filter is required (MQTT-3.8.3-2, MQTT-3.10.3-2).
+			if (first) {
+				std::cerr << "SUBSCRIBE or UNSUBSCRIBE without topic filters." << std::endl;
+				return -1;
+			}
+			
+			NmqttSubscribeFields* sub = get<NmqttSubscribeFields>();
+			sub->packetID = packetID;
+			sub->filters = filters;
+			sub->topic = topic;
+			sub->options = topicOptions;
+			properties = section;
+			propertyIndex.swap(index);
 		}
 		
 		break;
+		case MQTT_SUBACK:
 		case MQTT_UNSUBACK: {
 			// Client.
-			//
-			NYMPH_LOG_INFORMATION("Received UNSUBACK message.");
+			if (command == MQTT_SUBACK) { NYMPH_LOG_INFORMATION("Received SUBACK message."); }
+			else { NYMPH_LOG_INFORMATION("Received UNSUBACK message."); }
+			
+			// Packet identifier and properties, followed by a reason code per topic filter. An 
+			// MQTT 3.1.1 UNSUBACK has no reason codes.
+			if (idx + 2 > msg.length()) { return -1; }
+			NmqttAckFields* ack = get<NmqttAckFields>();
+			ack->packetID = ((uint8_t) msg[idx] << 8) | (uint8_t) msg[idx + 1];
+			idx += 2;
+			
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && !readProperties(idx)) {
+				std::cerr << "SUBACK or UNSUBACK properties malformed." << std::endl;
+				return -1;
+			}
+			
+			ack->reasonCodes.offset = idx;
+			ack->reasonCodes.length = msg.length() - idx;
+			if (idx < msg.length()) { ack->reasonCode = (uint8_t) msg[idx]; }
+			else if (command == MQTT_SUBACK) { return -1; }
 		}
 		
 		break;
@@ -374,7 +980,12 @@ int NmqttMessage::parseMessage(std::string msg) {
 		case MQTT_DISCONNECT: {
 			NYMPH_LOG_INFORMATION("Received DISCONNECT message.");
 			
-			// A disconnect message has no variable header and no payload.
+			// MQTT 5: the reason code and properties, which may be left out when the reason code
+			// is success and there are no properties. There is no payload.
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 && idx < msg.length()) {
+				get<NmqttAckFields>()->reasonCode = (uint8_t) msg[idx++];
+				if (idx < msg.length() && !readProperties(idx)) { return -1; }
+			}
 		}
 		
 		break;
@@ -422,7 +1033,7 @@ int NmqttMessage::parseHeader(char* buff, int len, uint32_t &msglen, int& idx) {
 				}
 			}
 		}
-
+	
 	}
 	
 	// Use ByteBauble to decode this variable byte integer.
@@ -434,31 +1045,92 @@ int NmqttMessage::parseHeader(char* buff, int len, uint32_t &msglen, int& idx) {
 }
 
 
-// --- SERIALIZE ---
-std::string NmqttMessage::serialize() {
-	// First byte contains the command and any flags.
-	// Second byte is a Variable Byte, indicating the length of the rest of the message.
-	// We'll fill this one in later.
+// Byte writers used by the two serialisation passes. The first pass uses the size writer to 
+// determine the exact size of the message, the second pass uses the buffer writer to write the
+// message into a buffer of that size. Integers are written in big-endian (network) order.
+struct NmqttSizeWriter {
+	uint32_t size = 0;
+	
+	void byte(uint8_t) { size += 1; }
+	void uint16(uint16_t) { size += 2; }
+	void uint32(uint32_t) { size += 4; }
+	void bytes(std::string_view str) { size += str.length(); }
+	void utf8(std::string_view str) { size += 2 + str.length(); }
+	void varint(uint32_t i) { size += 1 + (i > 0x7F) + (i > 0x3FFF) + (i > 0x1FFFFF); }
+};
+
+
+struct NmqttBufferWriter {
+	char* out;
+	
+	void byte(uint8_t b) { *out++ = (char) b; }
+	void uint16(uint16_t i) { 
+		*out++ = (char) (i >> 8); 
+		*out++ = (char) i; 
+	}
 	
-	// Next is the optional (variable) header section.
-	// This is present for these types:
-	// 
-	// PUBLISH		Required
+	void uint32(uint32_t i) {
+		*out++ = (char) (i >> 24);
+		*out++ = (char) (i >> 16);
+		*out++ = (char) (i >> 8);
+		*out++ = (char) i;
+	}
+	
+	void bytes(std::string_view str) {
+		std::memcpy(out, str.data(), str.length());
+		out += str.length();
+	}
+	
+	void utf8(std::string_view str) {
+		uint16(str.length());
+		bytes(str);
+	}
+	
+	void varint(uint32_t i) {
+		do {
+			uint8_t b = i & 0x7F;
+			i >>= 7;
+			*out++ = (char) (i ? (b | 0x80) : b);
+		} while (i);
+	}
+};
+
+
+// --- FIXED HEADER BYTE ---
+// Returns the first byte of the fixed header, containing the command and any flags.
+uint8_t NmqttMessage::fixedHeaderByte() {
+	uint8_t b0 = command;
+	if (command == MQTT_PUBLISH) {
+		// Add flags as required.
+		if (duplicateMessage) { b0 += 8; }
+		if (QoS == MQTT_QOS_AT_LEAST_ONCE) { b0 += 2; }
+		if (QoS == MQTT_QOS_EXACTLY_ONCE) { b0 += 4; }
+		if (retainMessage) { b0 += 1; }
+	}
+	else if (command == MQTT_SUBSCRIBE || command == MQTT_UNSUBSCRIBE || command == MQTT_PUBREL) {
+		// Fixed header has one required value: 0x2.
+		b0 += 0x2;
+	}
 	
-	// Finally the payload section. This is present for the following message types:
+	return b0;
+}
+
+
+// --- ENCODE BODY ---
+// Writes the section of the message after the fixed header using the provided writer. Without 
+// withPayload, the payload of a PUBLISH message is left out.
+template <typename W>
+void NmqttMessage::encodeBody(W &out, bool withPayload) {
+	// The optional (variable) header section comes first, followed by the payload section. 
+	// The payload section is present for the following message types:
 	// CONNECT 		Required
 	// PUBLISH 		Optional
 	// SUBSCRIBE 	Required
 	// SUBACK 		Required
 	// UNSUBSCRIBE 	Required
 	// UNSUBACK 	Required
-	uint8_t b0 = command;
-	std::string varHeader;
-	bytebauble.setGlobalEndianness(BB_BE);
 	switch (command) {
 		case MQTT_CONNECT: {
-			// Fixed header has no flags.
-			
 			// The Variable Header for the CONNECT Packet contains the following fields in this 
 			// order: 
 			// * Protocol Name, 
@@ -466,86 +1138,40 @@ std::string NmqttMessage::serialize() {
 			// * Connect Flags, 
 			// * Keep Alive, and
 			// * Properties. (MQTT 5)
-			bytebauble.setGlobalEndianness(BB_BE);
-			uint16_t protNameLenHost = 0x0004;
-			uint16_t protNameLenBE = bytebauble.toGlobal(protNameLenHost, bytebauble.getHostEndian());
-			varHeader.append((char*) &protNameLenBE, 2);
-			varHeader += "MQTT"; // The fixed protocol name.
-			
-			uint8_t protVersion;
-			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
-				protVersion = 5;
-			}
-			else {
-				protVersion = 4;	// Protocol version default is 4 (3.1.1).
-			}
-			
-			varHeader.append((char*) &protVersion, 1);
+			out.utf8("MQTT"); // The fixed protocol name.
 			
-			uint8_t connectFlags = 0;
-			if (cleanSessionFlag) { connectFlags += (uint8_t) MQTT_CONNECT_CLEAN_START; }
-			if (willFlag) { connectFlags += (uint8_t) MQTT_CONNECT_WILL; }
-			if (willQoS1) { connectFlags += (uint8_t) MQTT_CONNECT_WILL_QOS_L1; }
-			if (willQoS2) { connectFlags += (uint8_t) MQTT_CONNECT_WILL_QOS_L2; }
-			if (willRetainFlag) { connectFlags += (uint8_t) MQTT_CONNECT_WILL_RETAIN; }
-			if (passwordFlag) { connectFlags += (uint8_t) MQTT_CONNECT_PASSWORD; }
-			if (usernameFlag) { connectFlags += (uint8_t) MQTT_CONNECT_USERNAME; }
-			varHeader.append((char*) &connectFlags, 1);
+			// Protocol version default is 4 (3.1.1).
+			out.byte((mqttVersion == MQTT_PROTOCOL_VERSION_5) ? 5 : 4);
 			
-			uint16_t keepAliveHost = 60; // In seconds.
-			uint16_t keepAliveBE = bytebauble.toGlobal(keepAliveHost, bytebauble.getHostEndian());
-			varHeader.append((char*) &keepAliveBE, 2);
+			NmqttConnectFields* connect = connectFields();
+			out.byte(connect->flags);
+			out.uint16(connect->keepAlive);
 			
 			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
-				uint8_t propertiesLen = 0x05;
-				uint8_t sessionExpIntervalId = 0x11;
-				uint32_t sessionExpInterval = 0x0A;
-				varHeader.append((char*) &propertiesLen, 1);
-				varHeader.append((char*) &sessionExpIntervalId, 1);
-				varHeader.append((char*) &sessionExpInterval, 4);
+				out.varint(properties.length);
+				out.bytes(view(properties));
 			}
 			
 			// The payload section depends on previously set flags.
 			// These fields, if present, MUST appear in the order Client Identifier,
 			// Will Properties, Will Topic, Will Payload, User Name, Password.
-			
-			// UTF8-encoded string with 16-bit uint BE header indicating string length.
-			uint16_t clientIdLenHost = clientId.length();
-			uint16_t clientIdLenBE = bytebauble.toGlobal(clientIdLenHost, bytebauble.getHostEndian());
-			payload.append((char*) &clientIdLenBE, 2);
-			payload += clientId;
+			// Each is an UTF8-encoded string with 16-bit uint BE header indicating string length.
+			out.utf8(view(connect->clientId));
 			
 			// Will properties (MQTT 5), will topic, will payload.
-			if (willFlag) {
-				uint16_t willTopicLenBE = bytebauble.toGlobal(willTopic.length(), 
-																bytebauble.getHostEndian());
-				payload.append((char*) &willTopicLenBE, 2);
-				payload += willTopic;
-				
-				uint16_t willLenBE = bytebauble.toGlobal(will.length(), bytebauble.getHostEndian());
-				payload.append((char*) &willLenBE, 2);
-				payload += will;
+			if (connect->flags & MQTT_CONNECT_WILL) {
+				if (mqttVersion == MQTT_PROTOCOL_VERSION_5) { out.byte(0); }
+				out.utf8(view(connect->willTopic));
+				out.utf8(view(connect->will));
 			}
 			
 			// Username, password.
-			if (usernameFlag) {
-				uint16_t usernameLenBE = bytebauble.toGlobal(willTopic.length(), 
-																bytebauble.getHostEndian());
-				payload.append((char*) &usernameLenBE, 2);
-				payload += username;
-			}
-				
-			if (passwordFlag) {
-				uint16_t passwordLenBE = bytebauble.toGlobal(password.length(), bytebauble.getHostEndian());
-				payload.append((char*) &passwordLenBE, 2);
-				payload += password;
-			}
+			if (connect->flags & MQTT_CONNECT_USERNAME) { out.utf8(view(connect->username)); }
+			if (connect->flags & MQTT_CONNECT_PASSWORD) { out.utf8(view(connect->password)); }
 		}
 		
 		break;
 		case MQTT_CONNACK: {
-			// Fixed header has no flags.
-			
 			// The Variable Header of the CONNACK Packet contains the following fields in the order: 
 			// * Connect Acknowledge Flags
 			// * Connect Reason Code
@@ -554,171 +1180,235 @@ std::string NmqttMessage::serialize() {
 			// Connect acknowledge flags. 1 byte. Bits 1-7 are reserved and set to 0.
 			// Bit 0 is the session present flag. It's set to 0 if no existing session exists, or
 			// the clean session flag was set in the Connect message.
-			uint8_t connAckFlags = 0x0; // TODO: allow setting of this property.
-			varHeader.append((char*) &connAckFlags, 1);
+			const NmqttConnackFields* connack = get<NmqttConnackFields>();
+			out.byte(connack->sessionPresent ? 1 : 0);
 			
 			// Connect reason code.
 			// Single byte indicating the result of the connection attempt.
-			uint8_t connRes = 0; // TODO: make settable.
-			varHeader.append((char*) &connRes, 1);
+			out.byte(connack->reasonCode);
 			
 			// Properties.
-			// TODO: implement.
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
+				out.varint(properties.length);
+				out.bytes(view(properties));
+			}
 		}
 		
 		break;
 		case MQTT_PUBLISH: {
-			// Add flags as required.
-			if (duplicateMessage) { b0 += 8; }
-			if (QoS == MQTT_QOS_AT_LEAST_ONCE) { b0 += 2; }
-			if (QoS == MQTT_QOS_EXACTLY_ONCE) { b0 += 4; }
-			if (retainMessage) { b0 += 1; }
-			
 			// Variable header.
-			// Get the length of the topic, convert it to big endian format.
-			uint16_t topLenHost = topic.length();
-			uint16_t topLenBE = bytebauble.toGlobal(topLenHost, bytebauble.getHostEndian());
-			
-			varHeader.append((char*) &topLenBE, 2);
-			varHeader += topic;
+			// The topic, with its length in big endian format.
+			const NmqttPublishFields* publish = get<NmqttPublishFields>();
+			out.utf8(view(publish->topic));
 			
 			// Add packet identifier if QoS > 0.
-			// TODO: keep track of unused IDs.
 			if (QoS != MQTT_QOS_AT_MOST_ONCE) {
-				uint16_t pIDBE = bytebauble.toGlobal(packetID, bytebauble.getHostEndian());
-				varHeader.append((char*) &pIDBE, 2);
+				out.uint16(publish->packetID);
 			}
 			
-			// Set properties. 
-			// TODO: implement. Set to 0 for now.
+			// Properties.
 			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
-				uint8_t properties = 0x00;
-				varHeader.append((char*) &properties, 1);
+				out.varint(properties.length);
+				out.bytes(view(properties));
 			}
-		}
-		
-		break;
-		case MQTT_PUBACK: {
-			//
-		}
-		
-		break;
-		case MQTT_PUBREC: {
-			//
-		}
-		
-		break;
-		case MQTT_PUBREL: {
-			//
-		}
-		
-		break;
-		case MQTT_PUBCOMP: {
-			//
+			
+			if (withPayload) { out.bytes(view(publish->payload)); }
 		}
 		
 		break;
 		case MQTT_SUBSCRIBE: {
-			// Fixed header has one required value: 0x2.
-			b0 += 0x2;
-			
 			// Variable header. 
-			uint16_t packetIdHost = 10;
-			uint16_t packetIdBE = bytebauble.toGlobal(packetIdHost, bytebauble.getHostEndian());
-			varHeader.append((char*) &packetIdBE, 2);
+			const NmqttSubscribeFields* sub = get<NmqttSubscribeFields>();
+			out.uint16(sub->packetID);
 			
 			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
-				uint8_t propLength = 0;
-				varHeader.append((char*) &propLength, 1);
+				out.varint(properties.length);
+				out.bytes(view(properties));
 			}
 			
 			// Payload.
-			uint16_t topicLenHost = topic.length();
-			uint16_t topicLenBE = bytebauble.toGlobal(topicLenHost, bytebauble.getHostEndian());
-			payload.append((char*) &topicLenBE, 2);
-			payload += topic;
+			out.utf8(view(sub->topic));
 			
 			// Subscribe flags.
-			// TODO: implement settability.
-			uint8_t subFlags = 0;
-			payload.append((char*) &subFlags, 1);
-		}
-		
-		break;
-		case MQTT_SUBACK: {
-			//
+			out.byte(sub->options);
 		}
 		
 		break;
 		case MQTT_UNSUBSCRIBE: {
-			// Client.
-			// Fixed header has one required value: 0x2.
-			b0 += 0x2;
-			
 			// Variable header. 
-			uint16_t packetIdHost = 10;
-			uint16_t packetIdBE = bytebauble.toGlobal(packetIdHost, bytebauble.getHostEndian());
-			varHeader.append((char*) &packetIdBE, 2);
+			const NmqttSubscribeFields* sub = get<NmqttSubscribeFields>();
+			out.uint16(sub->packetID);
 			
-			// Set packet ID.
-			// TODO: implement packet ID handling.
-			uint16_t pIDBE = bytebauble.toGlobal(packetID, bytebauble.getHostEndian());
-			varHeader.append((char*) &pIDBE, 2);
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
+				out.varint(properties.length);
+				out.bytes(view(properties));
+			}
 			
 			// Payload is the topic to unsubscribe from.
-			uint16_t topicLenBE = bytebauble.toGlobal(topic.length(), bytebauble.getHostEndian());
-			payload.append((char*) &topicLenBE, 2);
-			payload += topic;
+			out.utf8(view(sub->topic));
 		}
 		
 		break;
-		case MQTT_UNSUBACK: {
-			//
+		case MQTT_PUBACK:
+		case MQTT_PUBREC:
+		case MQTT_PUBREL:
+		case MQTT_PUBCOMP: {
+			// Packet identifier. With MQTT 5 the reason code and properties follow, unless the
+			// reason code is success and there are no properties.
+			const NmqttAckFields* ack = get<NmqttAckFields>();
+			out.uint16(ack->packetID);
+			
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 
+					&& (ack->reasonCode != MQTT_CODE_SUCCESS || properties.length > 0)) {
+				out.byte(ack->reasonCode);
+				out.varint(properties.length);
+				out.bytes(view(properties));
+			}
 		}
 		
 		break;
-		case MQTT_PINGREQ: {
-			// Server.
-			// This command has no variable header and no payload.
-			// Generate a PINGRESP ping response packet to send back to the client.
+		case MQTT_SUBACK:
+		case MQTT_UNSUBACK: {
+			// Packet identifier and properties, followed by the reason codes. An MQTT 3.1.1 
+			// UNSUBACK has no reason codes.
+			const NmqttAckFields* ack = get<NmqttAckFields>();
+			out.uint16(ack->packetID);
+			
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5) {
+				out.varint(properties.length);
+				out.bytes(view(properties));
+			}
+			
+			if (command == MQTT_SUBACK || mqttVersion == MQTT_PROTOCOL_VERSION_5) {
+				out.bytes(view(ack->reasonCodes));
+			}
 		}
 		
 		break;
-		case MQTT_PINGRESP: {
-			// A ping response has no variable header and no payload.
+		case MQTT_DISCONNECT: {
+			// No variable header with MQTT 3.1.1. With MQTT 5 the reason code and properties, 
+			// unless the reason code is success and there are no properties.
+			const NmqttAckFields* ack = get<NmqttAckFields>();
+			if (mqttVersion == MQTT_PROTOCOL_VERSION_5 
+					&& (ack->reasonCode != MQTT_CODE_SUCCESS || properties.length > 0)) {
+				out.byte(ack->reasonCode);
+				out.varint(properties.length);
+				out.bytes(view(properties));
+			}
 		}
 		
 		break;
-		case MQTT_DISCONNECT: {
-			// A disconnect message has no variable header and no payload.
+		case MQTT_PINGREQ:
+		case MQTT_PINGRESP: {
+			// These messages have no variable header and no payload.
 		}
 		
 		break;
-		case MQTT_AUTH: {
-			// MQTT 5.
+		default: {
+			// TODO: implement AUTH (MQTT 5).
 		}
 		
 		break;
 	};
-		
-	// Calculate message length after the fixed header. Encode as packed integer.
-	uint32_t msgLen = varHeader.length() + payload.length();
+}
+
+
+// --- SERIALIZED SIZE ---
+// Returns the exact number of bytes of the serialised message, or 0 if the message is too large.
+uint32_t NmqttMessage::serializedSize() {
+	NmqttSizeWriter body;
+	encodeBody(body);
+	
+	uint32_t msgLenPacked;
+	uint32_t lenBytes = ByteBauble::writePackedInt(body.size, msgLenPacked);
+	if (lenBytes == 0) { return 0; }
+	
+	return 1 + lenBytes + body.size;
+}
+
+
+// --- SERIALIZE INTO ---
+// Writes the serialised message into the provided buffer. Returns the number of bytes written, or
+// 0 if the buffer is too small or the message too large.
+uint32_t NmqttMessage::serializeInto(char* buff, uint32_t len) {
+	// First pass determines the length of the message after the fixed header.
+	NmqttSizeWriter body;
+	encodeBody(body);
+	
+	// Encode the message length as packed integer.
 	uint32_t msgLenPacked;
-	uint32_t lenBytes = bytebauble.writePackedInt(msgLen, msgLenPacked);
+	uint32_t lenBytes = ByteBauble::writePackedInt(body.size, msgLenPacked);
+	if (lenBytes == 0 || 1 + lenBytes + body.size > len) { return 0; }
 	
 	// Debug
 #ifdef DEBUG
-	std::cout << "Message length: 0x" << std::hex << msgLen << std::endl;
+	std::cout << "Message length: 0x" << std::hex << body.size << std::endl;
 	std::cout << "Message length (packed): 0x" << std::hex << msgLenPacked << std::endl;
 	std::cout << "Message length bytes: 0x" << std::hex << lenBytes << std::endl;
 #endif
 	
-	std::string output; // TODO: preallocate size.
-	output.append((char*) &b0, 1);
-	output.append(((char*) &msgLenPacked), lenBytes); // FIXME: validate
-	output += varHeader;
-	output += payload;
+	// Second pass writes the fixed header, followed by the rest of the message.
+	NmqttBufferWriter out { buff };
+	out.byte(fixedHeaderByte());
+	for (uint32_t i = 0; i < lenBytes; ++i) {
+		out.byte((uint8_t) (msgLenPacked >> (i * 8)));
+	}
+	
+	encodeBody(out);
+	
+	return out.out - buff;
+}
+
+
+// --- SERIALIZE ---
+// Returns the serialised message. The string is allocated once, with the exact size.
+std::string NmqttMessage::serialize() {
+	std::string output(serializedSize(), '\0');
+	output.resize(serializeInto(&output[0], output.length()));
 	
 	return output;
+}
+
+
+// --- SERIALIZE LOCAL ---
+// Serialises the message into a buffer which is reused by all messages on the calling thread. 
+// The returned view is valid until the next call to this method on the same thread.
+std::string_view NmqttMessage::serializeLocal() {
+	static thread_local std::string localBuffer;
+	localBuffer.resize(serializedSize());
+	uint32_t len = serializeInto(&localBuffer[0], localBuffer.length());
+	
+	return std::string_view(localBuffer.data(), len);
+}
+
+
+// --- SERIALIZE HEADER LOCAL ---
+// Serialises a PUBLISH message up to its payload, for a payload of the provided length which is 
+// sent right after it. Any payload set on the message is ignored. This allows for the payload to
+// be sent from the caller's buffer without copying it. Like serializeLocal() the returned view is
+// valid until the next call on the same thread. An empty view is returned if the message would be
+// too large.
+std::string_view NmqttMessage::serializeHeaderLocal(uint32_t payloadLength) {
+	NmqttSizeWriter header;
+	encodeBody(header, false);
+	
+	uint32_t msgLenPacked;
+	uint32_t lenBytes = 0;
+	if (payloadLength <= 0x0FFFFFFF - header.size) {
+		lenBytes = ByteBauble::writePackedInt(header.size + payloadLength, msgLenPacked);
+	}
+	
+	if (lenBytes == 0) { return std::string_view(); }
+	
+	static thread_local std::string localHeader;
+	localHeader.resize(1 + lenBytes + header.size);
+	NmqttBufferWriter out { &localHeader[0] };
+	out.byte(fixedHeaderByte());
+	for (uint32_t i = 0; i < lenBytes; ++i) {
+		out.byte((uint8_t) (msgLenPacked >> (i * 8)));
+	}
+	
+	encodeBody(out, false);
 	
+	return std::string_view(localHeader.data(), localHeader.length());
 }
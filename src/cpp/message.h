@@ -7,7 +7,11 @@
 			- 
 			
 	Notes:
-			- 
+			- Parsed messages keep the received binary message as their buffer. String fields are
+				exposed as views into this buffer, instead of being copied out.
+			- MQTT 5 properties are scanned once during parsing. Their values are decoded on access.
+			- Only the fields for the message's packet type are stored. Fields for CONNECT are
+				kept on the heap, as this type is sent just once per connection.
 			
 	2019/05/08 - Maya Posch
 */
@@ -18,9 +22,13 @@
 
 
 #include <string>
+#include <string_view>
+#include <variant>
+#include <memory>
+#include <vector>
 #include <cstdint>
 
-#include <bytebauble.h>
+#include "properties.h"
 
 
 // MQTT version
@@ -86,10 +94,13 @@ enum MqttReasonCodes {
 	MQTT_CODE_4_SERVER_UNAVAILABLE = 0x03,
 	MQTT_CODE_4_BAD_USERNAME_PASSWORD = 0x04,
 	MQTT_CODE_4_NOT_AUTHORIZED = 0x05,
+	MQTT_CODE_NO_SUBSCRIPTION_EXISTED = 0x11,
 	MQTT_CODE_UNSPECIFIED = 0x80,
 	MQTT_CODE_MALFORMED_PACKET = 0x81,
 	MQTT_CODE_PROTOCOL_ERROR = 0x82,
+	MQTT_CODE_TOPIC_FILTER_INVALID = 0x8F,
 	MQTT_CODE_RECEIVE_MAX_EXCEEDED = 0x93,
+	MQTT_CODE_TOPIC_ALIAS_INVALID = 0x94,
 	MQTT_CODE_PACKAGE_TOO_LARGE = 0x95,
 	MQTT_CODE_RETAIN_UNSUPPORTED = 0x9A,
 	MQTT_CODE_QOS_UNSUPPORTED = 0x9B,
@@ -99,67 +110,156 @@ enum MqttReasonCodes {
 };
 
 
+// A section of the message buffer. Stored as offset and length instead of a pointer, so that
+// copies of a message remain valid.
+struct NmqttSlice {
+	uint32_t offset = 0;
+	uint32_t length = 0;
+};
+
+
+// Heap-allocated value with value semantics. Used for the fields of rarely sent packet types, so
+// that these do not increase the size of every message.
+template <typename T>
+class NmqttBox {
+	std::unique_ptr<T> ptr;
+	
+public:
+	NmqttBox() : ptr(new T) { }
+	NmqttBox(const NmqttBox &other) : ptr(other.ptr ? new T(*other.ptr) : 0) { }
+	NmqttBox(NmqttBox &&other) = default;
+	NmqttBox& operator=(const NmqttBox &other) { 
+		ptr.reset(other.ptr ? new T(*other.ptr) : 0);
+		return *this;
+	}
+	
+	NmqttBox& operator=(NmqttBox &&other) = default;
+	T* get() const { return ptr.get(); }
+};
+
+
+// Packet type specific fields. String fields are slices of the message buffer.
+struct NmqttConnectFields {
+	NmqttSlice clientId;
+	NmqttSlice willTopic;
+	NmqttSlice will;
+	NmqttSlice username;
+	NmqttSlice password;
+	uint16_t keepAlive = 60;							// In seconds.
+	uint8_t flags = MQTT_CONNECT_CLEAN_START;		// Connect flags, as on the wire.
+};
+
+
+struct NmqttConnackFields {
+	bool sessionPresent = false;
+	uint8_t reasonCode = MQTT_CODE_SUCCESS;
+};
+
+
+struct NmqttPublishFields {
+	NmqttSlice topic;
+	NmqttSlice payload;
+	uint16_t packetID = 0;
+};
+
+
+// SUBSCRIBE and UNSUBSCRIBE. A received message keeps the list of topic filters, with the first
+// one as topic.
+struct NmqttSubscribeFields {
+	NmqttSlice topic;
+	NmqttSlice filters;			// Topic filter list of a received message.
+	uint16_t packetID = 10;		// TODO: implement packet ID handling.
+	uint8_t options = 0;		// Subscription options (SUBSCRIBE).
+};
+
+
+// PUBACK, PUBREC, PUBREL, PUBCOMP, SUBACK and UNSUBACK. DISCONNECT only uses the reason code.
+struct NmqttAckFields {
+	NmqttSlice reasonCodes;		// Reason code per topic filter (SUBACK, UNSUBACK).
+	uint16_t packetID = 0;
+	uint8_t reasonCode = MQTT_CODE_SUCCESS;
+};
+
+
 class NmqttMessage {
-	MqttProtocolVersion mqttVersion = MQTT_PROTOCOL_VERSION_4;
-	MqttPacketType command;
-	std::string loggerName = "NmqttMessage";
+	static std::string loggerName;
 	
-	// For Publish message.
-	bool duplicateMessage = false;
-	MqttQoS QoS = MQTT_QOS_AT_MOST_ONCE;
-	bool retainMessage = false;
-	uint16_t packetID;
+	// Buffer holding the received binary message, or the strings set on a new message. All string
+	// fields are slices of this buffer.
+	std::string buffer;
+	
+	// Fields specific to the packet type. PINGREQ, PINGRESP and AUTH have none.
+	std::variant<std::monostate, 
+					NmqttBox<NmqttConnectFields>, 
+					NmqttConnackFields, 
+					NmqttPublishFields, 
+					NmqttSubscribeFields, 
+					NmqttAckFields> fields;
+	
+	// MQTT 5 properties section (excluding its length) and the index of its properties.
+	NmqttSlice properties;
+	std::vector<NmqttPropertyEntry> propertyIndex;
+	
+	// Bytes of the buffer taken up by replaced strings.
+	uint32_t garbage = 0;
 	
 	// Fixed header.
-	uint32_t messageLength;
-	
-	// Variable header.
-	std::string topic;
-	bool sessionPresent;
-	MqttReasonCodes reasonCode;
-	
-	// Connect message.
-	//MqttConnectFlags connectFlags;
-	uint8_t connectFlags;
-	bool cleanSessionFlag;
-	bool willFlag;
-	bool willRetainFlag;
-	bool usernameFlag;
-	bool passwordFlag;
-	uint8_t willQoS;
-	bool willQoS1;
-	bool willQoS2;
-	std::string will;
-	std::string willTopic;
-	std::string clientId;
-	std::string username;
-	std::string password;
-	uint16_t keepAlive;
+	uint8_t command = 0;
+	uint8_t mqttVersion = MQTT_PROTOCOL_VERSION_4;
+	
+	// Fixed header flags (PUBLISH).
+	bool duplicateMessage = false;
+	uint8_t QoS = MQTT_QOS_AT_MOST_ONCE;
+	bool retainMessage = false;
 	
 	// Status flags.
-	bool empty = true;		// Is this an empty message?
 	bool parseGood = false; // Did the last binary message get parsed successfully?
 	
-	// Payload.
-	std::string payload;
+	void resetFields();
+	int parseBuffer();
+	bool readString(uint32_t &idx, NmqttSlice &slice);
+	bool readProperties(uint32_t &idx, NmqttSlice *slice = 0);
+	void appendProperties(std::string_view encoded);
+	void removeProperty(MqttPropertyId id);
+	const NmqttPropertyEntry* findProperty(MqttPropertyId id) const;
+	void store(std::string &str, NmqttSlice &slice);
+	void compact();
+	std::string_view view(const NmqttSlice &slice) const { 
+		return std::string_view(buffer.data() + slice.offset, slice.length);
+	}
+	
+	NmqttConnectFields* connectFields() const { 
+		const NmqttBox<NmqttConnectFields>* box = std::get_if<NmqttBox<NmqttConnectFields> >(&fields);
+		return box ? box->get() : 0;
+	}
+	
+	template <typename T> T* get() { return std::get_if<T>(&fields); }
+	template <typename T> const T* get() const { return std::get_if<T>(&fields); }
 	
-	ByteBauble bytebauble;
+	uint8_t fixedHeaderByte();
+	template <typename W> void encodeBody(W &out, bool withPayload = true);
 	
 public:
 	NmqttMessage();
 	NmqttMessage(MqttPacketType type);
 	NmqttMessage(std::string msg);
+	NmqttMessage(const NmqttMessage &other) = default;
+	NmqttMessage(NmqttMessage &&other) = default;
 	~NmqttMessage();
 	
+	NmqttMessage& operator=(const NmqttMessage &other) = default;
+	NmqttMessage& operator=(NmqttMessage &&other) = default;
+	
 	bool createMessage(MqttPacketType type);
 	int parseMessage(std::string msg);
+	int parseFrame(std::string &frame);
 	int parseHeader(char* buff, int len, uint32_t &msglen, int& idx);
 	bool valid() { return parseGood; }
 	
 	void setProtocolVersion(MqttProtocolVersion version) { mqttVersion = version; }
 	
 	// For Connect message.
-	void setClientId(std::string id) { clientId = id; }
+	void setClientId(std::string id);
 	void setCredentials(std::string &user, std::string &pass);
 	void setWill(std::string topic, std::string will, uint8_t qos = 0, bool retain = false);
 	
@@ -167,18 +267,60 @@ public:
 	void setDuplicateMessage(bool dup) { duplicateMessage = dup; }
 	void setQoS(MqttQoS q) { QoS = q; }
 	void setRetain(bool retain) { retainMessage = retain; }
+	void setPacketID(uint16_t id);
+	
+	void setTopic(std::string topic);
+	void setPayload(std::string payload);
+	
+	// For acknowledgements.
+	void setReasonCode(MqttReasonCodes code);
+	void setReasonCodes(std::string codes);
+	
+	MqttPacketType getCommand() const { return (MqttPacketType) command; }
+	MqttProtocolVersion getProtocolVersion() const { return (MqttProtocolVersion) mqttVersion; }
+	MqttQoS getQoS() const { return (MqttQoS) QoS; }
+	bool getRetain() const { return retainMessage; }
+	uint16_t getPacketID() const;
+	uint8_t getConnectFlags() const;
+	uint16_t getKeepAlive() const;
+	std::string getTopic() { return std::string(getTopicView()); }
+	std::string getPayload() { return std::string(getPayloadView()); }
+	std::string getWill() { return std::string(getWillView()); }
+	bool getSessionPresent() const;
+	MqttReasonCodes getReasonCode() const;
+	
+	// Views remain valid for as long as this message instance is not modified or destroyed.
+	std::string_view getTopicView() const;
+	std::string_view getPayloadView() const;
+	std::string_view getWillView() const;
+	std::string_view getWillTopicView() const;
+	std::string_view getClientIdView() const;
+	std::string_view getUsernameView() const;
+	std::string_view getPasswordView() const;
+	std::string_view getReasonCodesView() const;
 	
-	void setTopic(std::string topic) { this->topic = topic; }
-	void setPayload(std::string payload) { this->payload = payload; }
+	// Topic filters of a received SUBSCRIBE or UNSUBSCRIBE message. Options are zero for the latter.
+	uint32_t getTopicFilterCount() const;
+	bool getTopicFilter(uint32_t n, std::string_view &filter, uint8_t &options) const;
 	
-	MqttPacketType getCommand() { return command; }
-	std::string getTopic() { return topic; }
-	std::string getPayload() { return payload; }
-	std::string getWill() { return will; }
-	bool getSessionPresent() { return sessionPresent; }
-	MqttReasonCodes getReasonCode() { return reasonCode; }
+	// MQTT 5 properties.
+	bool hasProperty(MqttPropertyId id) const { return findProperty(id) != 0; }
+	bool getProperty(MqttPropertyId id, uint32_t &value) const;
+	bool getProperty(MqttPropertyId id, std::string_view &value) const;
+	uint32_t getUserPropertyCount() const;
+	bool getUserProperty(uint32_t n, std::string_view &key, std::string_view &value) const;
+	std::string_view getPropertiesView() const { return view(properties); }
+	bool setProperty(MqttPropertyId id, uint32_t value);
+	bool setProperty(MqttPropertyId id, std::string_view value);
+	bool addUserProperty(std::string_view key, std::string_view value);
+	bool setProperties(std::string_view encoded);
+	void clearProperties();
 	
+	uint32_t serializedSize();
+	uint32_t serializeInto(char* buff, uint32_t len);
 	std::string serialize();
+	std::string_view serializeLocal();
+	std::string_view serializeHeaderLocal(uint32_t payloadLength);
 };
 
 
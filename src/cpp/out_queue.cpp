@@ -0,0 +1,94 @@
+/*
+	out_queue.cpp - Implementation of the NymphMQTT outbound queue class.
+	
+	Revision 0
+	
+	Features:
+			- Queue of data to send, filled by worker threads and emptied by a server reactor.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "out_queue.h"
+
+
+// Static initialisations.
+uint32_t NmqttOutQueue::flushLatency = 0;
+uint32_t NmqttOutQueue::flushSize = 64 * 1024;
+
+
+// --- SET FLUSH LATENCY ---
+// Sets the time in milliseconds that queued data may be held back to be coalesced with later data,
+// and the amount of queued data at which it is sent regardless.
+void NmqttOutQueue::setFlushLatency(uint32_t ms, uint32_t size) {
+	flushLatency = ms;
+	flushSize = (size > 0) ? size : 1;
+}
+
+
+// --- PUSH ---
+// Copies the parts into the header of a single queued message, which is followed by the shared 
+// body, if any. A message without any data is a drain marker. Returns true if the reactor has to
+// be woken up, which is the case for the first message in the queue, and when the flush size is
+// reached.
+bool NmqttOutQueue::push(uint64_t handle, const std::string_view* parts, size_t count,
+							const NmqttSharedBody &body) {
+	Message msg;
+	msg.handle = handle;
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i) { total += parts[i].length(); }
+	msg.frame.header.reserve(total);
+	for (size_t i = 0; i < count; ++i) {
+		msg.frame.header.append(parts[i].data(), parts[i].length());
+	}
+	
+	msg.frame.body = body;
+	if (body) { total += body->length(); }
+	msg.frame.drain = (total == 0);
+	
+	Poco::Mutex::ScopedLock lock(messagesMutex);
+	bool first = messages.empty();
+	if (first) { firstQueued = std::chrono::steady_clock::now(); }
+	messages.push_back(std::move(msg));
+	
+	size_t before = bytes;
+	bytes += total;
+	return first || (before < flushSize && bytes >= flushSize);
+}
+
+
+// --- TAKE ---
+// Moves the queued messages into the provided vector, once they are due to be sent. Returns the
+// time in milliseconds until they are due, or -1 if there are no messages left in the queue.
+int NmqttOutQueue::take(std::vector<Message> &out) {
+	Poco::Mutex::ScopedLock lock(messagesMutex);
+	if (messages.empty()) { return -1; }
+	
+	if (flushLatency > 0 && bytes < flushSize) {
+		std::chrono::steady_clock::time_point due = firstQueued +
+											std::chrono::milliseconds(flushLatency);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now < due) {
+			// Round up, so that the reactor does not wake up just before the deadline.
+			return std::chrono::duration_cast<std::chrono::milliseconds>(due - now
+											+ std::chrono::microseconds(999)).count();
+		}
+	}
+	
+	out.swap(messages);
+	messages.clear();
+	bytes = 0;
+	return -1;
+}
+
+
+// --- CLEAR ---
+void NmqttOutQueue::clear() {
+	Poco::Mutex::ScopedLock lock(messagesMutex);
+	messages.clear();
+	bytes = 0;
+}
@@ -0,0 +1,63 @@
+/*
+	out_queue.h - Header for the NymphMQTT outbound queue class.
+	
+	Revision 0
+	
+	Features:
+			- Queue of data to send, filled by worker threads and emptied by a server reactor.
+			- Bounds the latency of queued data, so that small messages can be coalesced.
+			- A shared body is queued by reference, without copying it.
+	
+	Notes:
+			- With a flush latency of zero (the default), the reactor is woken up for the first
+				message in the queue, and sends whatever has been queued by the time it runs.
+			- With a flush latency, queued data is held back until the oldest message has waited
+				for that long, or the queued data reaches the flush size.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_OUT_QUEUE_H
+#define NMQTT_OUT_QUEUE_H
+
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include <Poco/Mutex.h>
+
+#include "outbound.h"
+
+
+class NmqttOutQueue {
+public:
+	struct Message {
+		uint64_t handle;
+		NmqttFrame frame;
+	};
+
+private:
+	std::vector<Message> messages;
+	size_t bytes = 0;
+	std::chrono::steady_clock::time_point firstQueued;
+	Poco::Mutex messagesMutex;
+	
+	static uint32_t flushLatency;
+	static uint32_t flushSize;
+
+public:
+	static void setFlushLatency(uint32_t ms, uint32_t size);
+	
+	bool push(uint64_t handle, const std::string_view* parts, size_t count,
+				const NmqttSharedBody &body = NmqttSharedBody());
+	int take(std::vector<Message> &out);
+	void clear();
+};
+
+
+#endif
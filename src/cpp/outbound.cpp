@@ -0,0 +1,238 @@
+/*
+	outbound.cpp - Implementation of the NymphMQTT outbound queue of a client connection.
+	
+	Revision 0
+	
+	Features:
+			- Holds the messages which are waiting to be sent to a client, on its reactor thread.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "outbound.h"
+#include "message.h"
+
+
+// Static initialisations.
+NmqttOutboundLimits NmqttOutbound::limits;
+std::function<void(uint64_t)> NmqttOutbound::highWaterHandler;
+std::function<void(uint64_t)> NmqttOutbound::lowWaterHandler;
+std::function<void(uint64_t)> NmqttOutbound::drainHandler;
+
+
+// Returns the QoS of a serialised PUBLISH message, or -1 for other messages.
+static int publishQoS(const NmqttFrame &frame) {
+	const std::string &h = frame.header;
+	if (h.empty() || ((uint8_t) h[0] & 0xF0) != MQTT_PUBLISH) { return -1; }
+	return ((uint8_t) h[0] >> 1) & 0x3;
+}
+
+
+// --- SET LIMITS ---
+// Sets the limits for new connections.
+void NmqttOutbound::setLimits(const NmqttOutboundLimits &limits) {
+	NmqttOutbound::limits = limits;
+}
+
+
+// --- SET HANDLERS ---
+// Sets the functions called with the handle of a connection when its queue goes above the
+// high-water mark, and when it returns to the low-water mark. These are called on the reactor
+// thread, and should not block.
+void NmqttOutbound::setHandlers(std::function<void(uint64_t)> highWater,
+								std::function<void(uint64_t)> lowWater) {
+	highWaterHandler = highWater;
+	lowWaterHandler = lowWater;
+}
+
+
+// --- NOTIFY ---
+void NmqttOutbound::notify(uint64_t handle, bool high) {
+	if (high && highWaterHandler) { highWaterHandler(handle); }
+	else if (!high && lowWaterHandler) { lowWaterHandler(handle); }
+}
+
+
+// --- SET DRAIN HANDLER ---
+// Sets the function called with the handle of a connection once the data queued in front of a 
+// drain marker has been sent. It is called on the reactor thread, and should not block.
+void NmqttOutbound::setDrainHandler(std::function<void(uint64_t)> drain) {
+	drainHandler = drain;
+}
+
+
+// --- NOTIFY DRAINED ---
+void NmqttOutbound::notifyDrained(uint64_t handle) {
+	if (drainHandler) { drainHandler(handle); }
+}
+
+
+// --- FULL ---
+// Returns true if a message of the provided length would exceed a limit. A single message is
+// always accepted into an empty queue.
+bool NmqttOutbound::full(size_t length) {
+	if (messages == 0) { return false; }
+	return messages + 1 > limits.maxMessages || bytes + length > limits.maxBytes;
+}
+
+
+// --- DROP OLDEST ---
+// Drops the oldest QoS 0 messages which are not pinned, until a message of the provided length
+// fits. Returns false if it does not fit.
+bool NmqttOutbound::dropOldest(size_t length) {
+	// A partially sent message has to be completed.
+	size_t start = (pinned == 0 && offset > 0) ? 1 : pinned;
+	for (size_t i = start; i < queue.size() && full(length); ++i) {
+		NmqttFrame &msg = queue[i];
+		if (publishQoS(msg) != 0) { continue; }
+		
+		bytes -= msg.length();
+		--messages;
+		++dropped;
+		std::string().swap(msg.header);
+		msg.body.reset();
+	}
+	
+	return !full(length);
+}
+
+
+// --- REFILL ---
+// Moves held back messages into the queue while they fit, and leaves the high-water state once
+// the queue has drained far enough.
+void NmqttOutbound::refill() {
+	while (!spill.empty() && !full(spill.front().length())) {
+		spillBytes -= spill.front().length();
+		bytes += spill.front().length();
+		if (!spill.front().drain) { ++messages; }
+		queue.push_back(std::move(spill.front()));
+		spill.pop_front();
+	}
+	
+	if (high && spill.empty() && bytes <= limits.lowWaterBytes
+			&& messages <= limits.lowWaterMessages) {
+		high = false;
+	}
+}
+
+
+// --- PUSH ---
+// Adds a serialised message, applying the limits. Returns false if the client should be
+// disconnected. The limits count the shared body of a message in full. A drain marker is queued
+// behind held back messages, and is reached at once if nothing is queued.
+bool NmqttOutbound::push(NmqttFrame &&frame) {
+	if (frame.drain) {
+		if (!spill.empty()) { spill.push_back(std::move(frame)); }
+		else if (!queue.empty()) { queue.push_back(std::move(frame)); }
+		else { drained = true; }
+		return true;
+	}
+	
+	int qos = publishQoS(frame);
+	size_t length = frame.length();
+	if (qos > 0 && (!spill.empty() || full(length))) {
+		// Hold back QoS 1 and 2 messages, in order, until the queue has room again.
+		high = true;
+		if (spillBytes + length > limits.maxSpillBytes) { return false; }
+		
+		spillBytes += length;
+		spill.push_back(std::move(frame));
+		return true;
+	}
+	
+	if (qos == 0 && full(length)) {
+		high = true;
+		if (limits.qos0Policy == NMQTT_DROP_DISCONNECT) { return false; }
+		if (limits.qos0Policy == NMQTT_DROP_NEWEST || !dropOldest(length)) {
+			++dropped;
+			return true;
+		}
+	}
+	
+	bytes += length;
+	++messages;
+	queue.push_back(std::move(frame));
+	return true;
+}
+
+
+// --- GATHER ---
+// Returns up to max parts to send, starting with the unsent remainder of the first message. A 
+// message with a body takes two parts, and may be split over two calls. The messages are pinned 
+// until consume() is called, and must not be changed meanwhile.
+size_t NmqttOutbound::gather(std::string_view* parts, size_t max) {
+	size_t count = 0;
+	size_t i = 0;
+	for (; i < queue.size() && count < max; ++i) {
+		const NmqttFrame &msg = queue[i];
+		size_t skip = (i == 0) ? offset : 0;
+		if (skip < msg.header.length()) {
+			parts[count++] = std::string_view(msg.header).substr(skip);
+			skip = 0;
+		}
+		else {
+			skip -= msg.header.length();
+		}
+		
+		if (msg.body && skip < msg.body->length() && count < max) {
+			parts[count++] = std::string_view(*msg.body).substr(skip);
+		}
+	}
+	
+	pinned = i;
+	return count;
+}
+
+
+// --- CONSUME ---
+// Removes the sent bytes from the front of the queue, and unpins the messages.
+void NmqttOutbound::consume(size_t sent) {
+	pinned = 0;
+	while (!queue.empty()) {
+		NmqttFrame &msg = queue.front();
+		size_t rest = msg.length() - offset;
+		if (rest > sent) {
+			offset += sent;
+			break;
+		}
+		
+		sent -= rest;
+		if (msg.drain) { drained = true; }
+		else if (!msg.empty()) {
+			bytes -= msg.length();
+			--messages;
+		}
+		
+		queue.pop_front();
+		offset = 0;
+	}
+	
+	refill();
+}
+
+
+// --- CLEAR ---
+// Discards all messages which are not pinned.
+void NmqttOutbound::clear() {
+	while (queue.size() > pinned) {
+		bytes -= queue.back().length();
+		if (!queue.back().empty() && !queue.back().drain) { --messages; }
+		queue.pop_back();
+	}
+	
+	spill.clear();
+	spillBytes = 0;
+}
+
+
+// --- TAKE DRAINED ---
+// Returns true once if a drain marker was reached since the last call.
+bool NmqttOutbound::takeDrained() {
+	if (!drained) { return false; }
+	drained = false;
+	return true;
+}
@@ -0,0 +1,125 @@
+/*
+	outbound.h - Header for the NymphMQTT outbound queue of a client connection.
+	
+	Revision 0
+	
+	Features:
+			- Holds the messages which are waiting to be sent to a client, on its reactor thread.
+			- Bounds the queued messages and bytes, with a drop policy for QoS 0 messages.
+			- Holds back QoS 1 and 2 messages in a spill queue while the limits are reached.
+			- Messages can share their body with the same message queued for other clients.
+	
+	Notes:
+			- Reaching a limit puts the queue above its high-water mark. It stays there until the
+				spill queue is empty, and the queue has drained to the low-water mark. The reactor
+				stops reading from the connection meanwhile, and calls the high- and low-water
+				handlers on these transitions.
+			- Messages which are being sent are pinned, and are never dropped. Dropped messages are
+				emptied in place, so that pinned messages do not move in memory.
+			- Messages other than PUBLISH are always queued.
+			- A message is a header, followed by an optional shared body. A PUBLISH which is sent
+				to many clients is queued with a header per client, which holds the packet
+				identifier and topic alias, and a single copy of its payload. The header and body
+				are sent as separate parts.
+			- A drain marker is an empty message which is queued behind the data it follows,
+				including held back messages. The drain handler is called once the data in front
+				of it has been sent, which lets the sender queue more data at the pace of the
+				client.
+			- An instance is only used from the reactor thread which owns the connection.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_OUTBOUND_H
+#define NMQTT_OUTBOUND_H
+
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+
+enum NmqttDropPolicy {
+	NMQTT_DROP_OLDEST = 0,		// Drop queued QoS 0 messages to make room.
+	NMQTT_DROP_NEWEST,			// Drop the new QoS 0 message.
+	NMQTT_DROP_DISCONNECT		// Disconnect the client.
+};
+
+
+// Immutable data which is shared by messages in the outbound queues of multiple clients.
+typedef std::shared_ptr<const std::string> NmqttSharedBody;
+
+
+// A queued message: its header, followed by the shared body, if any.
+struct NmqttFrame {
+	std::string header;
+	NmqttSharedBody body;
+	bool drain = false;				// Drain marker, without data.
+	
+	NmqttFrame() { }
+	NmqttFrame(std::string &&header, NmqttSharedBody body = NmqttSharedBody()) :
+		header(std::move(header)), body(std::move(body)) { }
+	
+	size_t length() const { return header.length() + (body ? body->length() : 0); }
+	bool empty() const { return length() == 0; }
+};
+
+
+struct NmqttOutboundLimits {
+	uint32_t maxBytes = 8 * 1024 * 1024;			// High-water mark.
+	uint32_t maxMessages = 16 * 1024;
+	uint32_t lowWaterBytes = 2 * 1024 * 1024;		// Low-water mark.
+	uint32_t lowWaterMessages = 4 * 1024;
+	uint32_t maxSpillBytes = 32 * 1024 * 1024;		// Beyond this the client is disconnected.
+	NmqttDropPolicy qos0Policy = NMQTT_DROP_OLDEST;
+};
+
+
+class NmqttOutbound {
+	std::deque<NmqttFrame> queue;
+	std::deque<NmqttFrame> spill;
+	size_t offset = 0;				// Bytes of the first message which have been sent.
+	size_t pinned = 0;				// Messages at the front which are being sent.
+	size_t bytes = 0;
+	size_t messages = 0;
+	size_t spillBytes = 0;
+	bool high = false;
+	bool drained = false;			// A drain marker was reached.
+	uint64_t dropped = 0;
+	
+	static NmqttOutboundLimits limits;
+	static std::function<void(uint64_t)> highWaterHandler;
+	static std::function<void(uint64_t)> lowWaterHandler;
+	static std::function<void(uint64_t)> drainHandler;
+	
+	bool full(size_t length);
+	bool dropOldest(size_t length);
+	void refill();
+
+public:
+	static void setLimits(const NmqttOutboundLimits &limits);
+	static void setHandlers(std::function<void(uint64_t)> highWater,
+							std::function<void(uint64_t)> lowWater);
+	static void notify(uint64_t handle, bool high);
+	static void setDrainHandler(std::function<void(uint64_t)> drain);
+	static void notifyDrained(uint64_t handle);
+	
+	bool push(NmqttFrame &&frame);
+	bool push(std::string &&data) { return push(NmqttFrame(std::move(data))); }
+	size_t gather(std::string_view* parts, size_t max);
+	void consume(size_t sent);
+	void clear();
+	bool takeDrained();
+	
+	bool empty() const { return queue.empty(); }
+	bool aboveHighWater() const { return high; }
+	uint64_t droppedCount() const { return dropped; }
+};
+
+
+#endif
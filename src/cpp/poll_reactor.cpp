@@ -0,0 +1,324 @@
+/*
+	poll_reactor.cpp - Implementation of the NymphMQTT poll-based server reactor class.
+	
+	Revision 0
+	
+	Features:
+			- Event loop thread which accepts client connections and receives their data, using
+				NmqttPoller.
+			
+	Notes:
+			- 
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "poll_reactor.h"
+#include "nymph_logger.h"
+#include "socket_writer.h"
+
+#include <Poco/Net/NetException.h>
+#include <Poco/NumberFormatter.h>
+
+
+// Poller key of the listening socket. Session handles are used as key for their sockets. The 
+// highest key is used by the poller itself on Linux.
+static const uint64_t acceptorKey = ~(uint64_t) 0 - 1;
+
+
+// --- DECONSTRUCTOR ---
+NmqttPollReactor::~NmqttPollReactor() {
+	stop();
+}
+
+
+// --- LISTEN ---
+// Creates a listening socket for this reactor, on all interfaces, IPv4 and IPv6.
+bool NmqttPollReactor::listen(int port, bool reusePort) {
+	try {
+		acceptor.bind6(port, true, reusePort, false); // Port, SO_REUSEADDR, SO_REUSEPORT, IPv6-only.
+		std::string result;
+		if (!socketOptions.apply(acceptor, result)) {
+			NYMPH_LOG_WARNING("Failed to set socket options: " + result);
+		}
+		
+		acceptor.listen(socketOptions.listenBacklog);
+		acceptor.setBlocking(false);
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_ERROR("Error creating listening socket: " + e.message());
+		return false;
+	}
+	
+	accepting = true;
+	return true;
+}
+
+
+// --- START ---
+bool NmqttPollReactor::start() {
+	if (!poller.valid()) {
+		NYMPH_LOG_ERROR("Failed to create poller.");
+		return false;
+	}
+	
+	if (accepting && !poller.add(acceptor.impl()->sockfd(), acceptorKey)) {
+		NYMPH_LOG_ERROR("Failed to add listening socket to poller.");
+		return false;
+	}
+	
+	running = true;
+	thread.start(*this);
+	return true;
+}
+
+
+// --- STOP ---
+// Stops the reactor thread and closes all sessions.
+void NmqttPollReactor::stop() {
+	if (!running) { return; }
+	
+	running = false;
+	poller.wake();
+	thread.join();
+	
+	if (accepting) {
+		poller.remove(acceptor.impl()->sockfd());
+		acceptor.close();
+		accepting = false;
+	}
+	
+	while (!connections.empty()) { closeSession(connections.begin()); }
+	
+	pendingMutex.lock();
+	pending.clear();
+	pendingMutex.unlock();
+	outQueue.clear();
+}
+
+
+// --- RUN ---
+void NmqttPollReactor::run() {
+	NYMPH_LOG_INFORMATION("Start listening...");
+	
+	std::vector<NmqttPollEvent> events;
+	int timeout = -1;
+	while (running) {
+		if (poller.wait(events, timeout) < 0) {
+			NYMPH_LOG_ERROR("Failed to wait for socket events. Terminating reactor thread.");
+			break;
+		}
+		
+		addPending();
+		
+		for (const NmqttPollEvent &ev : events) {
+			if (ev.key == acceptorKey) {
+				acceptConnection();
+				continue;
+			}
+			
+			std::map<uint64_t, Connection*>::iterator it = connections.find(ev.key);
+			if (it == connections.end()) { continue; }
+			
+			// Errors are reported by the read. The socket is blocking, so it is only read when
+			// data is available.
+			if ((ev.readable || ev.error) && !it->second->session->readable()) {
+				closeSession(it);
+				continue;
+			}
+			
+			if (ev.writable && !flush(it->second)) { closeSession(it); }
+		}
+		
+		// Send the data queued by worker threads, or wait until it is due.
+		timeout = takeQueue();
+	}
+	
+	NYMPH_LOG_INFORMATION("Stopping thread...");
+}
+
+
+// --- ACCEPT CONNECTION ---
+// Accepts a pending connection on the listening socket. The session is added to this reactor, or
+// handed to the next peer reactor.
+void NmqttPollReactor::acceptConnection() {
+	Poco::Net::StreamSocket socket;
+	try {
+		socket = acceptor.acceptConnection();
+		socket.setBlocking(true);
+	}
+	catch (Poco::Exception &e) {
+		// The connection may have been reset before it was accepted.
+		NYMPH_LOG_WARNING("Failed to accept connection: " + e.message());
+		return;
+	}
+	
+	if (peers.empty()) {
+		addSession(socket);
+		return;
+	}
+	
+	NmqttServerReactor* peer = peers[nextPeer++ % peers.size()];
+	if (peer == this) { addSession(socket); }
+	else { peer->adopt(socket); }
+}
+
+
+// --- ADOPT ---
+// Hands an accepted connection to this reactor. Can be called from any thread.
+void NmqttPollReactor::adopt(const Poco::Net::StreamSocket &socket) {
+	pendingMutex.lock();
+	pending.push_back(socket);
+	pendingMutex.unlock();
+	poller.wake();
+}
+
+
+// --- ADD PENDING ---
+// Adds the connections handed over by other reactors.
+void NmqttPollReactor::addPending() {
+	pendingMutex.lock();
+	if (pending.empty()) {
+		pendingMutex.unlock();
+		return;
+	}
+	
+	std::vector<Poco::Net::StreamSocket> sockets;
+	sockets.swap(pending);
+	pendingMutex.unlock();
+	
+	for (const Poco::Net::StreamSocket &socket : sockets) { addSession(socket); }
+}
+
+
+// --- SEND ---
+// Queues data for a connection of this reactor. Can be called from any thread.
+bool NmqttPollReactor::send(uint64_t handle, const std::string_view* parts, size_t count,
+								const NmqttSharedBody &body) {
+	if (outQueue.push(handle, parts, count, body)) { poller.wake(); }
+	return true;
+}
+
+
+// --- TAKE QUEUE ---
+// Moves the data queued by other threads to the outbound queues of the connections, and sends it.
+// Returns the time in milliseconds until queued data is due, or -1 if nothing is queued.
+int NmqttPollReactor::takeQueue() {
+	int due = outQueue.take(outLocal);
+	if (outLocal.empty()) { return due; }
+	
+	for (NmqttOutQueue::Message &msg : outLocal) {
+		std::map<uint64_t, Connection*>::iterator it = connections.find(msg.handle);
+		if (it == connections.end()) { continue; }
+		if (!it->second->out.push(std::move(msg.frame))) {
+			NYMPH_LOG_WARNING("Outbound limit exceeded. Disconnecting client.");
+			closeSession(it);
+		}
+	}
+	
+	// Connections which are waiting for their socket continue once it is writable.
+	for (NmqttOutQueue::Message &msg : outLocal) {
+		std::map<uint64_t, Connection*>::iterator it = connections.find(msg.handle);
+		if (it == connections.end()) { continue; }
+		if (it->second->writeWait) { updatePoller(it->second); }
+		else if (!flush(it->second)) { closeSession(it); }
+	}
+	
+	outLocal.clear();
+	return -1;
+}
+
+
+// --- FLUSH ---
+// Sends queued data until the socket would block. The poller reports the socket as writable while
+// data remains. Returns false if the connection failed.
+bool NmqttPollReactor::flush(Connection* conn) {
+	const size_t maxParts = 16;
+	while (!conn->out.empty()) {
+		std::string_view parts[maxParts];
+		size_t count = conn->out.gather(parts, maxParts);
+		size_t total = 0;
+		for (size_t i = 0; i < count; ++i) { total += parts[i].length(); }
+		
+		int res;
+		try {
+			res = NmqttSocketWriter::sendSome(conn->session->getSocket(), parts, count);
+		}
+		catch (Poco::Exception &e) {
+			NYMPH_LOG_ERROR("Failed to send message: " + e.message());
+			return false;
+		}
+		
+		if (res < 0) {
+			NYMPH_LOG_ERROR("Failed to send message.");
+			return false;
+		}
+		
+		NYMPH_LOG_DEBUG("Sent " + Poco::NumberFormatter::format(res) + " bytes.");
+		
+		conn->out.consume(res);
+		if ((size_t) res < total) { break; }
+	}
+	
+	updatePoller(conn);
+	return true;
+}
+
+
+// --- UPDATE POLLER ---
+// Waits for the socket to become writable while data remains, and stops reading from it while the
+// outbound queue is above its high-water mark. Calls the high- and low-water handlers when the 
+// latter changes, and the drain handler once a drain marker has been reached.
+void NmqttPollReactor::updatePoller(Connection* conn) {
+	if (conn->out.takeDrained()) { NmqttOutbound::notifyDrained(conn->session->getHandle()); }
+	
+	bool wait = !conn->out.empty();
+	bool paused = conn->out.aboveHighWater();
+	if (wait == conn->writeWait && paused == conn->paused) { return; }
+	
+	poller.modify(conn->fd, conn->session->getHandle(), wait, !paused);
+	conn->writeWait = wait;
+	if (paused != conn->paused) {
+		conn->paused = paused;
+		NmqttOutbound::notify(conn->session->getHandle(), paused);
+	}
+}
+
+
+// --- ADD SESSION ---
+void NmqttPollReactor::addSession(const Poco::Net::StreamSocket &socket) {
+	Connection* conn = new Connection;
+	conn->session = new NmqttSession(socket, this);
+	conn->session->setQuickAck(socketOptions.quickAck);
+	
+	// Most options are inherited from the listening socket, but not on all systems.
+	std::string result;
+	if (!socketOptions.apply(conn->session->getSocket(), result)) {
+		NYMPH_LOG_DEBUG("Failed to set socket options: " + result);
+	}
+	
+	conn->fd = conn->session->getSocket().impl()->sockfd();
+	if (!poller.add(conn->fd, conn->session->getHandle())) {
+		NYMPH_LOG_ERROR("Failed to add client connection to poller.");
+		delete conn->session;
+		delete conn;
+		return;
+	}
+	
+	connections.insert(std::pair<uint64_t, Connection*>(conn->session->getHandle(), conn));
+	
+	NYMPH_LOG_DEBUG("Added session with handle: " + 
+					Poco::NumberFormatter::format(conn->session->getHandle()));
+}
+
+
+// --- CLOSE SESSION ---
+// Unregisters the socket and deletes the session, which closes the connection. Data which has not
+// been sent yet is discarded.
+void NmqttPollReactor::closeSession(std::map<uint64_t, Connection*>::iterator it) {
+	poller.remove(it->second->fd);
+	delete it->second->session;
+	delete it->second;
+	connections.erase(it);
+}
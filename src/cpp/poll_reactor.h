@@ -0,0 +1,94 @@
+/*
+	poll_reactor.h - Header for the NymphMQTT poll-based server reactor class.
+	
+	Revision 0
+	
+	Features:
+			- Event loop thread which accepts client connections and receives their data, using
+				NmqttPoller.
+			
+	Notes:
+			- On Linux each reactor has its own listening socket on the same port (SO_REUSEPORT), 
+				and the kernel divides new connections over them. Elsewhere the first reactor 
+				accepts all connections and hands them out to the other reactors in turn.
+			- Data sent by worker threads is queued, and sent by the reactor thread. Each connection
+				has its own outbound queue, which is written with a single sendmsg() call for up to
+				16 parts. When the socket's send buffer is full, the reactor waits for it to 
+				become writable, without blocking other connections. Queued data may be held back 
+				for the flush latency of NmqttOutQueue, to be coalesced with later data.
+			- The outbound queue of a connection is bounded by NmqttOutbound. While it is above its
+				high-water mark, the reactor stops reading from the connection.
+			- Sessions are only accessed from the reactor's own thread.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_POLL_REACTOR_H
+#define NMQTT_POLL_REACTOR_H
+
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+#include <Poco/Mutex.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+
+#include "server_reactor.h"
+#include "poller.h"
+#include "session.h"
+#include "out_queue.h"
+#include "outbound.h"
+
+
+class NmqttPollReactor : public NmqttServerReactor, public Poco::Runnable {
+	struct Connection {
+		NmqttSession* session;
+		poco_socket_t fd;
+		NmqttOutbound out;					// Data waiting to be sent.
+		bool writeWait = false;				// Waiting for the socket to become writable.
+		bool paused = false;				// Not reading, while above the high-water mark.
+	};
+	
+	std::string loggerName = "NmqttPollReactor";
+	NmqttPoller poller;
+	Poco::Net::ServerSocket acceptor;
+	bool accepting = false;
+	std::vector<NmqttServerReactor*> peers;		// Reactors to hand accepted connections to.
+	uint32_t nextPeer = 0;
+	std::map<uint64_t, Connection*> connections;
+	std::vector<Poco::Net::StreamSocket> pending;	// Connections handed over by another reactor.
+	Poco::Mutex pendingMutex;
+	NmqttOutQueue outQueue;							// Data sent by other threads.
+	std::vector<NmqttOutQueue::Message> outLocal;
+	Poco::Thread thread;
+	bool running = false;
+	
+	void acceptConnection();
+	void addSession(const Poco::Net::StreamSocket &socket);
+	void addPending();
+	int takeQueue();
+	bool flush(Connection* conn);
+	void updatePoller(Connection* conn);
+	void closeSession(std::map<uint64_t, Connection*>::iterator it);
+	
+public:
+	~NmqttPollReactor();
+	
+	bool listen(int port, bool reusePort);
+	void setPeers(std::vector<NmqttServerReactor*> &peers) { this->peers = peers; }
+	bool start();
+	void stop();
+	void run();
+	
+	void adopt(const Poco::Net::StreamSocket &socket);
+	bool send(uint64_t handle, const std::string_view* parts, size_t count,
+				const NmqttSharedBody &body);
+};
+
+
+#endif
@@ -0,0 +1,245 @@
+/*
+	poller.cpp - Implementation of the NymphMQTT socket poller class.
+	
+	Revision 0
+	
+	Features:
+			- Waits for readiness on any number of sockets from a single thread.
+			- Can be woken up from other threads.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "poller.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#endif
+
+#include <cerrno>
+
+
+#ifdef __linux__
+// Key used for the eventfd, which is not reported as an event.
+static const uint64_t wakeKey = ~(uint64_t) 0;
+#endif
+
+
+// --- CONSTRUCTOR ---
+NmqttPoller::NmqttPoller() {
+#ifdef __linux__
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (epfd >= 0 && wakefd >= 0) {
+		epoll_event ev = {};
+		ev.events = EPOLLIN;
+		ev.data.u64 = wakeKey;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &ev);
+	}
+#elif !defined(_WIN32)
+	if (pipe(wakePipe) == 0) {
+		fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+	}
+#endif
+}
+
+
+// --- DECONSTRUCTOR ---
+NmqttPoller::~NmqttPoller() {
+#ifdef __linux__
+	if (epfd >= 0) { close(epfd); }
+	if (wakefd >= 0) { close(wakefd); }
+#elif !defined(_WIN32)
+	if (wakePipe[0] >= 0) { close(wakePipe[0]); }
+	if (wakePipe[1] >= 0) { close(wakePipe[1]); }
+#endif
+}
+
+
+// --- VALID ---
+// Returns false if the poller could not be created.
+bool NmqttPoller::valid() {
+#ifdef __linux__
+	return epfd >= 0 && wakefd >= 0;
+#elif defined(_WIN32)
+	return true;
+#else
+	return wakePipe[0] >= 0;
+#endif
+}
+
+
+// --- ADD ---
+// Registers a socket for read readiness, and optionally write readiness.
+bool NmqttPoller::add(poco_socket_t fd, uint64_t key, bool write) {
+#ifdef __linux__
+	epoll_event ev = {};
+	ev.events = EPOLLIN | (write ? EPOLLOUT : 0);
+	ev.data.u64 = key;
+	return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+#else
+	entriesMutex.lock();
+	Entry entry = { fd, key, write, true };
+	entries.push_back(entry);
+	entriesMutex.unlock();
+	wake();
+	return true;
+#endif
+}
+
+
+// --- MODIFY ---
+// Changes whether write and read readiness are reported for a registered socket. Errors and 
+// hang-ups are always reported.
+bool NmqttPoller::modify(poco_socket_t fd, uint64_t key, bool write, bool read) {
+#ifdef __linux__
+	epoll_event ev = {};
+	ev.events = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+	ev.data.u64 = key;
+	return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == 0;
+#else
+	bool found = false;
+	entriesMutex.lock();
+	for (Entry &entry : entries) {
+		if (entry.fd != fd) { continue; }
+		entry.key = key;
+		entry.write = write;
+		entry.read = read;
+		found = true;
+		break;
+	}
+	
+	entriesMutex.unlock();
+	if (found) { wake(); }
+	return found;
+#endif
+}
+
+
+// --- REMOVE ---
+// Unregisters a socket. This has to be done before the socket is closed.
+bool NmqttPoller::remove(poco_socket_t fd) {
+#ifdef __linux__
+	return epoll_ctl(epfd, EPOLL_CTL_DEL, fd, 0) == 0;
+#else
+	bool found = false;
+	entriesMutex.lock();
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (entries[i].fd != fd) { continue; }
+		entries[i] = entries.back();
+		entries.pop_back();
+		found = true;
+		break;
+	}
+	
+	entriesMutex.unlock();
+	return found;
+#endif
+}
+
+
+// --- WAIT ---
+// Waits up to the timeout (in milliseconds, -1 for no timeout) for events, which are stored in the
+// provided vector. Returns the number of events, or -1 on error. A wake-up returns zero events.
+int NmqttPoller::wait(std::vector<NmqttPollEvent> &events, int timeout) {
+	events.clear();
+#ifdef __linux__
+	epoll_event evs[64];
+	int n = epoll_wait(epfd, evs, 64, timeout);
+	if (n < 0) { return (errno == EINTR) ? 0 : -1; }
+	
+	for (int i = 0; i < n; ++i) {
+		if (evs[i].data.u64 == wakeKey) {
+			uint64_t count;
+			while (read(wakefd, &count, sizeof(count)) > 0) { }
+			continue;
+		}
+		
+		NmqttPollEvent ev;
+		ev.key = evs[i].data.u64;
+		ev.readable = evs[i].events & EPOLLIN;
+		ev.writable = evs[i].events & EPOLLOUT;
+		ev.error = evs[i].events & (EPOLLERR | EPOLLHUP);
+		events.push_back(ev);
+	}
+#else
+	entriesMutex.lock();
+	std::vector<Entry> current = entries;
+	entriesMutex.unlock();
+	
+	// The wake-up pipe is the first entry, where available.
+	std::vector<pollfd> fds;
+	fds.reserve(current.size() + 1);
+#ifdef _WIN32
+	if (timeout < 0 || timeout > 100) { timeout = 100; }
+	if (current.empty()) {
+		Sleep(timeout);
+		return 0;
+	}
+#else
+	pollfd wp = { wakePipe[0], POLLIN, 0 };
+	fds.push_back(wp);
+#endif
+	size_t first = fds.size();
+	for (const Entry &entry : current) {
+		pollfd pfd = {};
+		pfd.fd = entry.fd;
+		pfd.events = (entry.read ? POLLIN : 0) | (entry.write ? POLLOUT : 0);
+		fds.push_back(pfd);
+	}
+
+#ifdef _WIN32
+	int n = WSAPoll(fds.data(), fds.size(), timeout);
+#else
+	int n = poll(fds.data(), fds.size(), timeout);
+#endif
+	if (n < 0) { return (errno == EINTR) ? 0 : -1; }
+
+#ifndef _WIN32
+	if (fds[0].revents & POLLIN) {
+		char drain[64];
+		while (read(wakePipe[0], drain, sizeof(drain)) > 0) { }
+	}
+#endif
+	
+	for (size_t i = first; i < fds.size(); ++i) {
+		if (fds[i].revents == 0) { continue; }
+		NmqttPollEvent ev;
+		ev.key = current[i - first].key;
+		ev.readable = fds[i].revents & POLLIN;
+		ev.writable = fds[i].revents & POLLOUT;
+		ev.error = fds[i].revents & (POLLERR | POLLHUP | POLLNVAL);
+		events.push_back(ev);
+	}
+#endif
+	
+	return events.size();
+}
+
+
+// --- WAKE ---
+// Makes a current or the next call to wait() return. Can be called from any thread.
+void NmqttPoller::wake() {
+#ifdef __linux__
+	uint64_t one = 1;
+	ssize_t res = write(wakefd, &one, sizeof(one));
+	(void) res;
+#elif !defined(_WIN32)
+	char b = 1;
+	ssize_t res = write(wakePipe[1], &b, 1);
+	(void) res;
+#endif
+}
@@ -0,0 +1,74 @@
+/*
+	poller.h - Header for the NymphMQTT socket poller class.
+	
+	Revision 0
+	
+	Features:
+			- Waits for readiness on any number of sockets from a single thread.
+			- Can be woken up from other threads.
+	
+	Notes:
+			- Uses epoll with an eventfd for waking up on Linux, poll() with a pipe on other POSIX
+				systems and WSAPoll() on Windows. On Windows a wait is limited to 100 ms instead of
+				being woken up.
+			- Sockets are registered with a key, which is returned with their events. The highest 
+				key (~0) is reserved.
+			- Readiness is level-triggered.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_POLLER_H
+#define NMQTT_POLLER_H
+
+
+#include <vector>
+#include <cstdint>
+
+#include <Poco/Mutex.h>
+#include <Poco/Net/SocketDefs.h>
+
+
+struct NmqttPollEvent {
+	uint64_t key;
+	bool readable;
+	bool writable;
+	bool error;			// Error or hang-up.
+};
+
+
+class NmqttPoller {
+#ifdef __linux__
+	int epfd = -1;
+	int wakefd = -1;
+#else
+	// Registered sockets. Copied for each wait, so that sockets can be changed meanwhile.
+	struct Entry {
+		poco_socket_t fd;
+		uint64_t key;
+		bool write;
+		bool read;
+	};
+	
+	std::vector<Entry> entries;
+	Poco::Mutex entriesMutex;
+#ifndef _WIN32
+	int wakePipe[2] = { -1, -1 };
+#endif
+#endif
+	
+public:
+	NmqttPoller();
+	~NmqttPoller();
+	
+	bool valid();
+	bool add(poco_socket_t fd, uint64_t key, bool write = false);
+	bool modify(poco_socket_t fd, uint64_t key, bool write, bool read = true);
+	bool remove(poco_socket_t fd);
+	int wait(std::vector<NmqttPollEvent> &events, int timeout);
+	void wake();
+};
+
+
+#endif
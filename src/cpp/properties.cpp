@@ -0,0 +1,254 @@
+/*
+	properties.cpp - Implementation of the NymphMQTT MQTT 5 properties codec.
+	
+	Revision 0
+	
+	Features:
+			- Encoding and lazy decoding of MQTT 5 properties.
+			
+	Notes:
+			- The properties section handled here excludes the leading properties length.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "properties.h"
+
+#include <bytebauble.h>
+
+
+// Static initialisations.
+// Data type for each property identifier.
+const uint8_t NmqttProperties::types[0x2B] = {
+	MQTT_PROP_TYPE_INVALID,				// 0x00
+	MQTT_PROP_TYPE_BYTE,				// 0x01 Payload Format Indicator
+	MQTT_PROP_TYPE_FOUR_BYTE_INT,		// 0x02 Message Expiry Interval
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x03 Content Type
+	MQTT_PROP_TYPE_INVALID,				// 0x04
+	MQTT_PROP_TYPE_INVALID,				// 0x05
+	MQTT_PROP_TYPE_INVALID,				// 0x06
+	MQTT_PROP_TYPE_INVALID,				// 0x07
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x08 Response Topic
+	MQTT_PROP_TYPE_BINARY_DATA,			// 0x09 Correlation Data
+	MQTT_PROP_TYPE_INVALID,				// 0x0A
+	MQTT_PROP_TYPE_VARIABLE_INT,		// 0x0B Subscription Identifier
+	MQTT_PROP_TYPE_INVALID,				// 0x0C
+	MQTT_PROP_TYPE_INVALID,				// 0x0D
+	MQTT_PROP_TYPE_INVALID,				// 0x0E
+	MQTT_PROP_TYPE_INVALID,				// 0x0F
+	MQTT_PROP_TYPE_INVALID,				// 0x10
+	MQTT_PROP_TYPE_FOUR_BYTE_INT,		// 0x11 Session Expiry Interval
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x12 Assigned Client Identifier
+	MQTT_PROP_TYPE_TWO_BYTE_INT,		// 0x13 Server Keep Alive
+	MQTT_PROP_TYPE_INVALID,				// 0x14
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x15 Authentication Method
+	MQTT_PROP_TYPE_BINARY_DATA,			// 0x16 Authentication Data
+	MQTT_PROP_TYPE_BYTE,				// 0x17 Request Problem Information
+	MQTT_PROP_TYPE_FOUR_BYTE_INT,		// 0x18 Will Delay Interval
+	MQTT_PROP_TYPE_BYTE,				// 0x19 Request Response Information
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x1A Response Information
+	MQTT_PROP_TYPE_INVALID,				// 0x1B
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x1C Server Reference
+	MQTT_PROP_TYPE_INVALID,				// 0x1D
+	MQTT_PROP_TYPE_INVALID,				// 0x1E
+	MQTT_PROP_TYPE_UTF8_STRING,			// 0x1F Reason String
+	MQTT_PROP_TYPE_INVALID,				// 0x20
+	MQTT_PROP_TYPE_TWO_BYTE_INT,		// 0x21 Receive Maximum
+	MQTT_PROP_TYPE_TWO_BYTE_INT,		// 0x22 Topic Alias Maximum
+	MQTT_PROP_TYPE_TWO_BYTE_INT,		// 0x23 Topic Alias
+	MQTT_PROP_TYPE_BYTE,				// 0x24 Maximum QoS
+	MQTT_PROP_TYPE_BYTE,				// 0x25 Retain Available
+	MQTT_PROP_TYPE_UTF8_PAIR,			// 0x26 User Property
+	MQTT_PROP_TYPE_FOUR_BYTE_INT,		// 0x27 Maximum Packet Size
+	MQTT_PROP_TYPE_BYTE,				// 0x28 Wildcard Subscription Available
+	MQTT_PROP_TYPE_BYTE,				// 0x29 Subscription Identifier Available
+	MQTT_PROP_TYPE_BYTE					// 0x2A Shared Subscription Available
+};
+
+
+// --- READ VAR INT ---
+// Reads a variable byte integer from the provided data. Returns the number of bytes used, or -1 if
+// the integer is incomplete or malformed.
+int NmqttProperties::readVarInt(const char* data, uint32_t len, uint32_t &value) {
+	uint32_t packed = 0;
+	uint32_t i = 0;
+	for (; i < 4 && i < len; ++i) {
+		packed |= (uint32_t) (uint8_t) data[i] << (i * 8);
+		if (!(data[i] & 0x80)) { break; }
+	}
+	
+	if (i == len || i == 4) { return -1; }
+	
+	return ByteBauble::readPackedInt(packed, value);
+}
+
+
+// --- SCAN ---
+// Validates the properties section and records the identifier and value offset of each property in
+// the index. Returns the number of properties, or -1 if the section is malformed.
+int NmqttProperties::scan(std::string_view props, std::vector<NmqttPropertyEntry> &index) {
+	index.clear();
+	uint64_t seen = 0;	// Identifiers seen so far. All identifiers are below 64.
+	uint32_t idx = 0;
+	uint32_t len = props.length();
+	const char* data = props.data();
+	while (idx < len) {
+		// The identifier is a variable byte integer, but all defined identifiers fit in one byte.
+		uint8_t id = (uint8_t) data[idx++];
+		MqttPropertyType t = type(id);
+		if (t == MQTT_PROP_TYPE_INVALID) { return -1; }
+		
+		// Only User Property and Subscription Identifier may be included more than once.
+		if ((seen >> id) & 1U) {
+			if (id != MQTT_PROP_USER_PROPERTY && id != MQTT_PROP_SUBSCRIPTION_IDENTIFIER) { 
+				return -1; 
+			}
+		}
+		
+		seen |= (uint64_t) 1 << id;
+		index.push_back({ id, idx });
+		
+		uint32_t size = 0;
+		switch (t) {
+			case MQTT_PROP_TYPE_BYTE: size = 1; break;
+			case MQTT_PROP_TYPE_TWO_BYTE_INT: size = 2; break;
+			case MQTT_PROP_TYPE_FOUR_BYTE_INT: size = 4; break;
+			case MQTT_PROP_TYPE_VARIABLE_INT: {
+				uint32_t value;
+				int bytes = readVarInt(data + idx, len - idx, value);
+				if (bytes < 0) { return -1; }
+				size = bytes;
+			}
+			
+			break;
+			case MQTT_PROP_TYPE_UTF8_STRING:
+			case MQTT_PROP_TYPE_BINARY_DATA: 
+			case MQTT_PROP_TYPE_UTF8_PAIR: {
+				// One or two strings, each with a big-endian, two-byte length header.
+				int strings = (t == MQTT_PROP_TYPE_UTF8_PAIR) ? 2 : 1;
+				for (int i = 0; i < strings; ++i) {
+					if (idx + size + 2 > len) { return -1; }
+					size += 2 + (((uint8_t) data[idx + size] << 8) | (uint8_t) data[idx + size + 1]);
+				}
+			}
+			
+			break;
+			default: return -1;
+		};
+		
+		if (idx + size > len) { return -1; }
+		idx += size;
+	}
+	
+	return index.size();
+}
+
+
+// --- DECODE INT ---
+// Decodes the integer value of a byte, two byte, four byte or variable byte integer property.
+uint32_t NmqttProperties::decodeInt(std::string_view props, const NmqttPropertyEntry &entry) {
+	const uint8_t* p = (const uint8_t*) props.data() + entry.offset;
+	switch (type(entry.id)) {
+		case MQTT_PROP_TYPE_BYTE: return p[0];
+		case MQTT_PROP_TYPE_TWO_BYTE_INT: return (p[0] << 8) | p[1];
+		case MQTT_PROP_TYPE_FOUR_BYTE_INT: 
+			return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+		case MQTT_PROP_TYPE_VARIABLE_INT: {
+			uint32_t value = 0;
+			readVarInt(props.data() + entry.offset, props.length() - entry.offset, value);
+			return value;
+		}
+		
+		default: return 0;
+	};
+}
+
+
+// --- DECODE STRING ---
+// Decodes a UTF-8 string or binary data property, or the key of a User Property.
+std::string_view NmqttProperties::decodeString(std::string_view props, const NmqttPropertyEntry &entry) {
+	const uint8_t* p = (const uint8_t*) props.data() + entry.offset;
+	uint16_t len = (p[0] << 8) | p[1];
+	return props.substr(entry.offset + 2, len);
+}
+
+
+// --- DECODE PAIR VALUE ---
+// Decodes the value of a User Property.
+std::string_view NmqttProperties::decodePairValue(std::string_view props, 
+													const NmqttPropertyEntry &entry) {
+	std::string_view key = decodeString(props, entry);
+	NmqttPropertyEntry value = { entry.id, (uint32_t) (entry.offset + 2 + key.length()) };
+	return decodeString(props, value);
+}
+
+
+// --- ENCODE ---
+// Appends an integer property to the encoded properties. Returns false if the identifier is not
+// of an integer type.
+bool NmqttProperties::encode(std::string &out, MqttPropertyId id, uint32_t value) {
+	MqttPropertyType t = type(id);
+	switch (t) {
+		case MQTT_PROP_TYPE_BYTE: 
+			out.push_back((char) id);
+			out.push_back((char) value);
+			break;
+		case MQTT_PROP_TYPE_TWO_BYTE_INT:
+			out.push_back((char) id);
+			out.push_back((char) (value >> 8));
+			out.push_back((char) value);
+			break;
+		case MQTT_PROP_TYPE_FOUR_BYTE_INT:
+			out.push_back((char) id);
+			out.push_back((char) (value >> 24));
+			out.push_back((char) (value >> 16));
+			out.push_back((char) (value >> 8));
+			out.push_back((char) value);
+			break;
+		case MQTT_PROP_TYPE_VARIABLE_INT: {
+			uint32_t packed;
+			uint32_t bytes = ByteBauble::writePackedInt(value, packed);
+			if (bytes == 0) { return false; }
+			out.push_back((char) id);
+			for (uint32_t i = 0; i < bytes; ++i) { out.push_back((char) (packed >> (i * 8))); }
+		}
+		
+		break;
+		default: return false;
+	};
+	
+	return true;
+}
+
+
+// Appends a UTF-8 string or binary data property. Returns false if the identifier is not of a 
+// string type, or the value is too long.
+bool NmqttProperties::encode(std::string &out, MqttPropertyId id, std::string_view value) {
+	MqttPropertyType t = type(id);
+	if (t != MQTT_PROP_TYPE_UTF8_STRING && t != MQTT_PROP_TYPE_BINARY_DATA) { return false; }
+	if (value.length() > 0xFFFF) { return false; }
+	
+	out.push_back((char) id);
+	out.push_back((char) (value.length() >> 8));
+	out.push_back((char) value.length());
+	out.append(value.data(), value.length());
+	
+	return true;
+}
+
+
+// Appends a User Property. Returns false if either string is too long.
+bool NmqttProperties::encode(std::string &out, std::string_view key, std::string_view value) {
+	if (key.length() > 0xFFFF || value.length() > 0xFFFF) { return false; }
+	
+	out.push_back((char) MQTT_PROP_USER_PROPERTY);
+	out.push_back((char) (key.length() >> 8));
+	out.push_back((char) key.length());
+	out.append(key.data(), key.length());
+	out.push_back((char) (value.length() >> 8));
+	out.push_back((char) value.length());
+	out.append(value.data(), value.length());
+	
+	return true;
+}
@@ -0,0 +1,100 @@
+/*
+	properties.h - Header for the NymphMQTT MQTT 5 properties codec.
+	
+	Revision 0
+	
+	Features:
+			- Encoding and lazy decoding of MQTT 5 properties.
+			
+	Notes:
+			- Received properties are scanned once to validate them and to record the offset of 
+				each property's value. Values are only decoded when accessed.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_PROPERTIES_H
+#define NMQTT_PROPERTIES_H
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+
+// MQTT 5 property identifiers.
+enum MqttPropertyId {
+	MQTT_PROP_PAYLOAD_FORMAT_INDICATOR = 0x01,
+	MQTT_PROP_MESSAGE_EXPIRY_INTERVAL = 0x02,
+	MQTT_PROP_CONTENT_TYPE = 0x03,
+	MQTT_PROP_RESPONSE_TOPIC = 0x08,
+	MQTT_PROP_CORRELATION_DATA = 0x09,
+	MQTT_PROP_SUBSCRIPTION_IDENTIFIER = 0x0B,
+	MQTT_PROP_SESSION_EXPIRY_INTERVAL = 0x11,
+	MQTT_PROP_ASSIGNED_CLIENT_IDENTIFIER = 0x12,
+	MQTT_PROP_SERVER_KEEP_ALIVE = 0x13,
+	MQTT_PROP_AUTHENTICATION_METHOD = 0x15,
+	MQTT_PROP_AUTHENTICATION_DATA = 0x16,
+	MQTT_PROP_REQUEST_PROBLEM_INFORMATION = 0x17,
+	MQTT_PROP_WILL_DELAY_INTERVAL = 0x18,
+	MQTT_PROP_REQUEST_RESPONSE_INFORMATION = 0x19,
+	MQTT_PROP_RESPONSE_INFORMATION = 0x1A,
+	MQTT_PROP_SERVER_REFERENCE = 0x1C,
+	MQTT_PROP_REASON_STRING = 0x1F,
+	MQTT_PROP_RECEIVE_MAXIMUM = 0x21,
+	MQTT_PROP_TOPIC_ALIAS_MAXIMUM = 0x22,
+	MQTT_PROP_TOPIC_ALIAS = 0x23,
+	MQTT_PROP_MAXIMUM_QOS = 0x24,
+	MQTT_PROP_RETAIN_AVAILABLE = 0x25,
+	MQTT_PROP_USER_PROPERTY = 0x26,
+	MQTT_PROP_MAXIMUM_PACKET_SIZE = 0x27,
+	MQTT_PROP_WILDCARD_SUB_AVAILABLE = 0x28,
+	MQTT_PROP_SUB_ID_AVAILABLE = 0x29,
+	MQTT_PROP_SHARED_SUB_AVAILABLE = 0x2A
+};
+
+
+// Data types of property values.
+enum MqttPropertyType {
+	MQTT_PROP_TYPE_INVALID = 0,
+	MQTT_PROP_TYPE_BYTE,
+	MQTT_PROP_TYPE_TWO_BYTE_INT,
+	MQTT_PROP_TYPE_FOUR_BYTE_INT,
+	MQTT_PROP_TYPE_VARIABLE_INT,
+	MQTT_PROP_TYPE_UTF8_STRING,
+	MQTT_PROP_TYPE_BINARY_DATA,
+	MQTT_PROP_TYPE_UTF8_PAIR
+};
+
+
+// Location of a property's value, relative to the start of the properties section.
+struct NmqttPropertyEntry {
+	uint8_t id;
+	uint32_t offset;
+};
+
+
+class NmqttProperties {
+	static const uint8_t types[0x2B];
+	
+public:
+	static MqttPropertyType type(uint8_t id) { 
+		return (id < sizeof(types)) ? (MqttPropertyType) types[id] : MQTT_PROP_TYPE_INVALID;
+	}
+	
+	static int readVarInt(const char* data, uint32_t len, uint32_t &value);
+	static int scan(std::string_view props, std::vector<NmqttPropertyEntry> &index);
+	
+	static uint32_t decodeInt(std::string_view props, const NmqttPropertyEntry &entry);
+	static std::string_view decodeString(std::string_view props, const NmqttPropertyEntry &entry);
+	static std::string_view decodePairValue(std::string_view props, const NmqttPropertyEntry &entry);
+	
+	static bool encode(std::string &out, MqttPropertyId id, uint32_t value);
+	static bool encode(std::string &out, MqttPropertyId id, std::string_view value);
+	static bool encode(std::string &out, std::string_view key, std::string_view value);
+};
+
+
+#endif
@@ -0,0 +1,104 @@
+/*
+	publish_template.cpp - Implementation for the NymphMQTT publish template class.
+	
+	Revision 0
+	
+	Features:
+			- Pre-encoded PUBLISH message for a fixed topic, QoS and retain flag.
+			
+	Notes:
+			- 
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "publish_template.h"
+#include "utf8_validator.h"
+
+#include <bytebauble.h>
+
+#include <cstring>
+
+
+// --- CONSTRUCTOR ---
+// Encodes the fixed header flags and the variable header for the provided topic. The template is 
+// left invalid if the topic is empty, too long, not valid UTF-8 or contains a wildcard.
+NmqttPublishTemplate::NmqttPublishTemplate(std::string topic, MqttQoS qos, bool retain, 
+											MqttProtocolVersion version) {
+	if (topic.empty() || topic.length() > 0xFFFF) { return; }
+	if (!NmqttUtf8Validator::validTopicName(topic)) { return; }
+	
+	this->topic = std::move(topic);
+	this->qos = qos;
+	
+	// Fixed header flags, as in NmqttMessage.
+	b0 = MQTT_PUBLISH;
+	if (qos == MQTT_QOS_AT_LEAST_ONCE) { b0 += 2; }
+	if (qos == MQTT_QOS_EXACTLY_ONCE) { b0 += 4; }
+	if (retain) { b0 += 1; }
+	
+	// Variable header: topic with big-endian length, packet ID if QoS > 0, properties (MQTT 5).
+	frame.assign(fixedHeaderMax, '\0');
+	frame.push_back((char) (this->topic.length() >> 8));
+	frame.push_back((char) this->topic.length());
+	frame += this->topic;
+	if (qos != MQTT_QOS_AT_MOST_ONCE) { frame.append(2, '\0'); }
+	if (version == MQTT_PROTOCOL_VERSION_5) { frame.push_back(0x00); }
+	
+	headerEnd = frame.length();
+}
+
+
+// --- BUILD ---
+// Returns the serialised PUBLISH message with the provided payload and packet ID. The packet ID is
+// ignored for QoS 0. The returned view is valid until the next call to this method, or until the
+// template is destroyed. An empty view is returned if the template is invalid or the message would
+// be too large.
+std::string_view NmqttPublishTemplate::build(std::string_view payload, uint16_t packetID) {
+	std::string_view header = buildHeader(payload.length(), packetID);
+	if (header.empty()) { return std::string_view(); }
+	
+	// Write the payload after the variable header.
+	frame.resize(headerEnd + payload.length());
+	if (!payload.empty()) {
+		std::memcpy(&frame[headerEnd], payload.data(), payload.length());
+	}
+	
+	return std::string_view(frame.data() + headerEnd - header.length(), 
+							header.length() + payload.length());
+}
+
+
+// --- BUILD HEADER ---
+// Returns the serialised PUBLISH message up to its payload, for a payload of the provided length.
+// The payload itself is to be sent right after it. The returned view is valid until the next call
+// to build() or buildHeader(), or until the template is destroyed. An empty view is returned if 
+// the template is invalid or the message would be too large.
+std::string_view NmqttPublishTemplate::buildHeader(uint32_t payloadLength, uint16_t packetID) {
+	if (headerEnd == 0) { return std::string_view(); }
+	
+	// Patch the remaining length into the reserved section, right-aligned against the variable
+	// header.
+	uint32_t varLen = headerEnd - fixedHeaderMax;
+	if (payloadLength > 0x0FFFFFFF - varLen) { return std::string_view(); }
+	
+	uint32_t msgLenPacked;
+	uint32_t lenBytes = ByteBauble::writePackedInt(varLen + payloadLength, msgLenPacked);
+	if (lenBytes == 0) { return std::string_view(); }
+	
+	uint32_t start = fixedHeaderMax - 1 - lenBytes;
+	frame[start] = (char) b0;
+	for (uint32_t i = 0; i < lenBytes; ++i) {
+		frame[start + 1 + i] = (char) (msgLenPacked >> (i * 8));
+	}
+	
+	// Patch the packet ID, which directly follows the topic.
+	if (qos != MQTT_QOS_AT_MOST_ONCE) {
+		uint32_t idx = fixedHeaderMax + 2 + topic.length();
+		frame[idx] = (char) (packetID >> 8);
+		frame[idx + 1] = (char) packetID;
+	}
+	
+	return std::string_view(frame.data() + start, headerEnd - start);
+}
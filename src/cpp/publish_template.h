@@ -0,0 +1,56 @@
+/*
+	publish_template.h - Header for the NymphMQTT publish template class.
+	
+	Revision 0
+	
+	Features:
+			- Pre-encoded PUBLISH message for a fixed topic, QoS and retain flag.
+			
+	Notes:
+			- The topic and flags are encoded once. Building a message only writes the remaining
+				length, the packet identifier and the payload.
+			- buildHeader() leaves out the payload, for sending it from the caller's buffer.
+			- An instance is not thread-safe, as it reuses its internal buffer for each message.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_PUBLISH_TEMPLATE_H
+#define NMQTT_PUBLISH_TEMPLATE_H
+
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "message.h"
+
+
+class NmqttPublishTemplate {
+	// Buffer layout: [reserved fixed header (5)][topic length (2)][topic][packet ID (2)][props (1)]
+	// followed by the payload. The fixed header is written right-aligned into the reserved section.
+	std::string frame;
+	uint32_t headerEnd = 0;		// Index into the frame where the payload starts.
+	uint8_t b0 = MQTT_PUBLISH;
+	MqttQoS qos = MQTT_QOS_AT_MOST_ONCE;
+	std::string topic;
+	
+	static const uint32_t fixedHeaderMax = 5;
+	
+public:
+	NmqttPublishTemplate() { }
+	NmqttPublishTemplate(std::string topic, MqttQoS qos = MQTT_QOS_AT_MOST_ONCE, 
+							bool retain = false, 
+							MqttProtocolVersion version = MQTT_PROTOCOL_VERSION_4);
+	
+	bool valid() { return headerEnd != 0; }
+	const std::string& getTopic() { return topic; }
+	MqttQoS getQoS() { return qos; }
+	
+	std::string_view build(std::string_view payload, uint16_t packetID = 0);
+	std::string_view buildHeader(uint32_t payloadLength, uint16_t packetID = 0);
+};
+
+
+#endif
@@ -47,11 +47,27 @@ void Request::process() {
 	NymphSocket* nymphSocket = NmqttConnections::getSocket(handle);
 	
 	if (msg.getCommand() == MQTT_PUBLISH) {
+		// The view handler gets the topic and payload without copying them out of the message.
 		NYMPH_LOG_DEBUG("Calling PUBLISH message handler...");
-		nymphSocket->handler(handle, msg.getTopic(), msg.getPayload());
+		if (nymphSocket->viewHandler) {
+			nymphSocket->viewHandler(handle, msg.getTopicView(), msg.getPayloadView());
+		}
+		else if (nymphSocket->handler) {
+			nymphSocket->handler(handle, msg.getTopic(), msg.getPayload());
+		}
 	}
 	else if (msg.getCommand() == MQTT_CONNACK) {
 		NYMPH_LOG_DEBUG("Calling CONNACK message handler...");
+		
+		// The broker's Topic Alias Maximum limits the aliases we can use for publishing (MQTT 5).
+		uint32_t aliasMax = 0;
+		msg.getProperty(MQTT_PROP_TOPIC_ALIAS_MAXIMUM, aliasMax);
+		if (nymphSocket->topicAliases) {
+			nymphSocket->topicAliases->lock();
+			nymphSocket->topicAliases->setMaximum(aliasMax);
+			nymphSocket->topicAliases->unlock();
+		}
+		
 		nymphSocket->connackHandler(handle, msg.getSessionPresent(), msg.getReasonCode());
 	}
 	else if (msg.getCommand() == MQTT_PINGRESP) {
@@ -66,6 +82,9 @@ void Request::process() {
 
 // --- FINISH ---
 void Request::finish() {
-	// Call own destructor.
-	delete this;
+	// Return to the pool, or call own destructor if not pooled. The pool reference is dropped last,
+	// as this may destroy the pool along with this request.
+	std::shared_ptr<NmqttRequestPool<Request> > p = std::move(pool);
+	if (p) { p->release(this); }
+	else { delete this; }
 }
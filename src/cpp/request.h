@@ -18,6 +18,7 @@
 #include "abstract_request.h"
 #include "connections.h"
 #include "message.h"
+#include "request_pool.h"
 
 
 #include <string>
@@ -49,13 +50,17 @@ class Request : public AbstractRequest {
 	int handle;
 	NmqttMessage msg;
 	std::string loggerName = "Request";
+	std::shared_ptr<NmqttRequestPool<Request> > pool;
 	
 	//logFunction outFnc;
 	
 public:
 	Request() { }
 	void setValue(std::string value) { this->value = value; }
-	void setMessage(int handle, NmqttMessage msg) { this->handle = handle; this->msg = msg; }
+	void setMessage(int handle, NmqttMessage &&msg) { this->handle = handle; this->msg = std::move(msg); }
+	void setHandle(int handle) { this->handle = handle; }
+	NmqttMessage& getMessage() { return msg; }
+	void setPool(std::shared_ptr<NmqttRequestPool<Request> > pool) { this->pool = std::move(pool); }
 	//void setOutput(logFunction fnc) { outFnc = fnc; }
 	void process();
 	void finish();
@@ -0,0 +1,64 @@
+/*
+	request_pool.h - Header for the NymphMQTT request pool class.
+	
+	Revision 0
+	
+	Features:
+			- Free list of request instances, so that received messages can be dispatched without
+				allocating a new request each time.
+	
+	Notes:
+			- Each listener or session owns a pool. Requests are acquired by the reading thread and
+				released by the worker thread in finish(), so the free list is locked.
+			- A request keeps a reference to its pool while in use, so that the pool remains valid
+				when its owner is destroyed before all requests have finished.
+			- Released requests keep their message, so that its buffer capacity is reused.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_REQUEST_POOL_H
+#define NMQTT_REQUEST_POOL_H
+
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+
+template <typename T>
+class NmqttRequestPool : public std::enable_shared_from_this<NmqttRequestPool<T> > {
+	std::vector<T*> freeList;
+	std::mutex freeMutex;
+	
+public:
+	~NmqttRequestPool() {
+		for (T* req : freeList) { delete req; }
+	}
+	
+	// Returns a request from the free list, or a new one if the list is empty.
+	T* acquire() {
+		T* req = 0;
+		freeMutex.lock();
+		if (!freeList.empty()) {
+			req = freeList.back();
+			freeList.pop_back();
+		}
+		
+		freeMutex.unlock();
+		if (!req) { req = new T; }
+		
+		req->setPool(this->shared_from_this());
+		return req;
+	}
+	
+	// Returns the request to the free list. Called with the pool reference taken from the request.
+	void release(T* req) {
+		std::lock_guard<std::mutex> lock(freeMutex);
+		freeList.push_back(req);
+	}
+};
+
+
+#endif
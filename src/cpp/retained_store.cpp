@@ -0,0 +1,278 @@
+/*
+	retained_store.cpp - Implementation of the NymphMQTT retained message store.
+	
+	Revision 0
+	
+	Features:
+			- Stores the last retained PUBLISH message of each topic.
+	
+	Notes:
+			- Memory usage is estimated from the sizes of the nodes, messages and payloads, plus
+				the bookkeeping of the children maps and shared pointers.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "retained_store.h"
+
+#include <algorithm>
+#include <iterator>
+
+
+// Static initialisations.
+const size_t NmqttRetainedStore::nodeBytes = sizeof(Node) + sizeof(Children::value_type)
+												+ 4 * sizeof(void*);
+const size_t NmqttRetainedStore::messageBytes = sizeof(NmqttRetainedMessage)
+												+ sizeof(std::string) + 8 * sizeof(void*);
+
+
+// Splits a topic or topic filter into its levels.
+static void splitLevels(std::string_view topic, std::vector<std::string_view> &out) {
+	out.clear();
+	size_t start = 0;
+	for (;;) {
+		size_t end = topic.find('/', start);
+		if (end == std::string_view::npos) {
+			out.push_back(topic.substr(start));
+			return;
+		}
+		
+		out.push_back(topic.substr(start, end - start));
+		start = end + 1;
+	}
+}
+
+
+// Returns true if a child is skipped by a wildcard at the first level.
+static bool systemTopic(size_t depth, std::string_view name) {
+	return depth == 0 && !name.empty() && name[0] == '$';
+}
+
+
+// --- DECONSTRUCTOR ---
+NmqttRetainedStore::~NmqttRetainedStore() {
+	destroy(&root);
+}
+
+
+// --- STORE ---
+// Stores the retained message for a topic, replacing any previous one. An empty payload removes
+// the retained message instead, as required by MQTT-3.3.1-6. Returns true if a message was stored.
+bool NmqttRetainedStore::store(std::string_view topic, const NmqttSharedBody &payload,
+								uint8_t qos) {
+	if (!payload || payload->empty()) {
+		remove(topic);
+		return false;
+	}
+	
+	if (topic.empty()) { return false; }
+	
+	std::shared_ptr<NmqttRetainedMessage> msg = std::make_shared<NmqttRetainedMessage>();
+	msg->topic.assign(topic.data(), topic.length());
+	msg->payload = payload;
+	msg->qos = qos;
+	
+	std::vector<std::string_view> levels;
+	splitLevels(topic, levels);
+	
+	Poco::Mutex::ScopedLock lock(mutex);
+	Node* node = &root;
+	for (std::string_view level : levels) {
+		Children::iterator it = node->children.find(level);
+		if (it == node->children.end()) {
+			Node* child = new Node;
+			child->parent = node;
+			it = node->children.insert(Children::value_type(std::string(level), child)).first;
+			child->name = it->first;
+			nodes++;
+			bytes += nodeBytes + level.length();
+		}
+		
+		node = it->second;
+	}
+	
+	if (node->message) {
+		payloadBytes -= node->message->payload->length();
+		bytes -= messageBytes + topic.length() + node->message->payload->length();
+	}
+	else {
+		messages++;
+	}
+	
+	payloadBytes += payload->length();
+	bytes += messageBytes + topic.length() + payload->length();
+	node->message = msg;
+	return true;
+}
+
+
+// --- REMOVE ---
+// Removes the retained message of a topic. Returns false if there was none.
+bool NmqttRetainedStore::remove(std::string_view topic) {
+	std::vector<std::string_view> levels;
+	splitLevels(topic, levels);
+	
+	Poco::Mutex::ScopedLock lock(mutex);
+	Node* node = &root;
+	for (std::string_view level : levels) {
+		Children::iterator it = node->children.find(level);
+		if (it == node->children.end()) { return false; }
+		node = it->second;
+	}
+	
+	if (!node->message) { return false; }
+	
+	messages--;
+	payloadBytes -= node->message->payload->length();
+	bytes -= messageBytes + topic.length() + node->message->payload->length();
+	node->message.reset();
+	prune(node);
+	return true;
+}
+
+
+// --- COLLECT ---
+// Appends up to max retained messages whose topic matches the filter to out, continuing after the
+// position of the cursor. The cursor is marked as done once all matching messages have been
+// returned. Returns the number of messages appended.
+size_t NmqttRetainedStore::collect(std::string_view filter, Cursor &cursor, size_t max,
+									std::vector<NmqttRetainedRef> &out) {
+	if (cursor.done || max == 0) { return 0; }
+	
+	Walk w;
+	splitLevels(filter, w.filter);
+	w.last = &cursor.last;
+	w.max = out.size() + max;
+	w.out = &out;
+	size_t before = out.size();
+	
+	Poco::Mutex::ScopedLock lock(mutex);
+	if (match(&root, 0, !cursor.last.empty(), w)) {
+		cursor.done = true;
+		return out.size() - before;
+	}
+	
+	// Remember the topic of the last message, as the node may be gone by the next call.
+	cursor.last.clear();
+	for (const Node* n = w.stop; n != &root; n = n->parent) {
+		cursor.last.push_back(std::string(n->name));
+	}
+	
+	std::reverse(cursor.last.begin(), cursor.last.end());
+	return out.size() - before;
+}
+
+
+// --- CLEAR ---
+void NmqttRetainedStore::clear() {
+	Poco::Mutex::ScopedLock lock(mutex);
+	destroy(&root);
+	root.children.clear();
+	messages = 0;
+	nodes = 0;
+	payloadBytes = 0;
+	bytes = 0;
+}
+
+
+// --- GET STATS ---
+NmqttRetainedStats NmqttRetainedStore::getStats() {
+	Poco::Mutex::ScopedLock lock(mutex);
+	NmqttRetainedStats stats;
+	stats.messages = messages;
+	stats.nodes = nodes;
+	stats.payloadBytes = payloadBytes;
+	stats.bytes = bytes;
+	return stats;
+}
+
+
+// --- EMIT ---
+// Collects the message of a node, unless it was returned before: onPath is set for the node of the
+// last returned topic and its parents. Returns false once the chunk is full.
+bool NmqttRetainedStore::emit(const Node* node, bool onPath, Walk &w) {
+	if (!node->message || onPath) { return true; }
+	
+	w.out->push_back(node->message);
+	if (w.out->size() < w.max) { return true; }
+	
+	w.stop = node;
+	return false;
+}
+
+
+// --- MATCH ---
+// Collects the messages below a node whose topics match the filter from the provided depth on.
+// OnPath is set if the node is on the path to the last returned topic, in which case the children
+// before that path have been visited already. Returns false once the chunk is full.
+bool NmqttRetainedStore::match(const Node* node, size_t depth, bool onPath, Walk &w) {
+	if (depth == w.filter.size()) { return emit(node, onPath, w); }
+	
+	std::string_view level = w.filter[depth];
+	if (level == "#") { return subtree(node, depth, onPath, w); }
+	
+	bool resume = onPath && depth < w.last->size();
+	std::string_view from = resume ? std::string_view((*w.last)[depth]) : std::string_view();
+	Children::const_iterator it;
+	Children::const_iterator end = node->children.end();
+	bool plus = level == "+";
+	if (plus) { it = resume ? node->children.lower_bound(from) : node->children.begin(); }
+	else {
+		it = node->children.find(level);
+		if (it != end) {
+			end = std::next(it);
+			if (resume && it->first < from) { it = end; }
+		}
+	}
+	
+	for (; it != end; ++it) {
+		if (plus && systemTopic(depth, it->first)) { continue; }
+		if (!match(it->second, depth + 1, resume && it->first == from, w)) { return false; }
+	}
+	
+	return true;
+}
+
+
+// --- SUBTREE ---
+// Collects the messages of a node and all nodes below it, for a '#' wildcard. Returns false once
+// the chunk is full.
+bool NmqttRetainedStore::subtree(const Node* node, size_t depth, bool onPath, Walk &w) {
+	if (!emit(node, onPath, w)) { return false; }
+	
+	bool resume = onPath && depth < w.last->size();
+	std::string_view from = resume ? std::string_view((*w.last)[depth]) : std::string_view();
+	Children::const_iterator it = resume ? node->children.lower_bound(from) :
+											node->children.begin();
+	for (; it != node->children.end(); ++it) {
+		if (systemTopic(depth, it->first)) { continue; }
+		if (!subtree(it->second, depth + 1, resume && it->first == from, w)) { return false; }
+	}
+	
+	return true;
+}
+
+
+// --- PRUNE ---
+// Removes a node without message or children, and any parents which are left unused by this.
+void NmqttRetainedStore::prune(Node* node) {
+	while (node != &root && !node->message && node->children.empty()) {
+		Node* parent = node->parent;
+		nodes--;
+		bytes -= nodeBytes + node->name.length();
+		parent->children.erase(parent->children.find(node->name));
+		delete node;
+		node = parent;
+	}
+}
+
+
+// --- DESTROY ---
+// Deletes the nodes below a node.
+void NmqttRetainedStore::destroy(Node* node) {
+	for (Children::value_type &child : node->children) {
+		destroy(child.second);
+		delete child.second;
+	}
+}
@@ -0,0 +1,122 @@
+/*
+	retained_store.h - Header for the NymphMQTT retained message store.
+	
+	Revision 0
+	
+	Features:
+			- Stores the last retained PUBLISH message of each topic.
+			- Topics are kept in a trie with a node per topic level, as with the subscriptions in
+				NmqttTopicTree. A topic filter is matched by walking only the branches it can
+				match, with '+' visiting the children of a node and '#' its whole subtree.
+			- Matching messages are returned in chunks, so that they can be sent to a client
+				without collecting all of them first.
+			- Reports the number of messages and nodes, and an estimate of the memory used.
+	
+	Notes:
+			- Messages are visited in topic level order, parents before their children. A cursor
+				holds the levels of the last returned topic, and the next chunk continues after
+				it. Messages which are changed between chunks are returned as they are then.
+				Messages added before the cursor are not returned, but a client which subscribed
+				first gets them as a regular PUBLISH instead.
+			- Payloads are shared with the messages sent to clients, and are never copied.
+			- Wildcards at the first level do not match topics starting with '$' (MQTT-4.7.2-1).
+			- The store is locked while a change is made or a chunk is collected.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_RETAINED_STORE_H
+#define NMQTT_RETAINED_STORE_H
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+#include <Poco/Mutex.h>
+
+#include "outbound.h"
+
+
+struct NmqttRetainedMessage {
+	std::string topic;
+	NmqttSharedBody payload;
+	uint8_t qos;
+};
+
+
+typedef std::shared_ptr<const NmqttRetainedMessage> NmqttRetainedRef;
+
+
+struct NmqttRetainedStats {
+	uint64_t messages = 0;
+	uint64_t nodes = 0;
+	uint64_t payloadBytes = 0;
+	uint64_t bytes = 0;				// Estimate of all memory used, including the payloads.
+};
+
+
+class NmqttRetainedStore {
+	struct Node;
+	typedef std::map<std::string, Node*, std::less<> > Children;
+	
+	struct Node {
+		Node* parent = 0;
+		std::string_view name;		// Key in the children of the parent.
+		Children children;			// Sorted, so that a walk can be continued.
+		NmqttRetainedRef message;
+	};
+	
+	// State of a walk which collects the messages matching a filter.
+	struct Walk {
+		std::vector<std::string_view> filter;
+		const std::vector<std::string>* last;
+		size_t max;
+		std::vector<NmqttRetainedRef>* out;
+		const Node* stop = 0;		// Node of the last message collected, once out is full.
+	};
+	
+	Node root;
+	uint64_t messages = 0;
+	uint64_t nodes = 0;
+	uint64_t payloadBytes = 0;
+	uint64_t bytes = 0;
+	Poco::Mutex mutex;
+	
+	static const size_t nodeBytes;
+	static const size_t messageBytes;
+	
+	bool emit(const Node* node, bool onPath, Walk &w);
+	bool match(const Node* node, size_t depth, bool onPath, Walk &w);
+	bool subtree(const Node* node, size_t depth, bool onPath, Walk &w);
+	void prune(Node* node);
+	void destroy(Node* node);
+
+public:
+	// Position of a walk over the messages matching a filter.
+	struct Cursor {
+		std::vector<std::string> last;		// Levels of the last returned topic.
+		bool done = false;
+	};
+	
+	NmqttRetainedStore() { }
+	~NmqttRetainedStore();
+	NmqttRetainedStore(const NmqttRetainedStore &other) = delete;
+	NmqttRetainedStore& operator=(const NmqttRetainedStore &other) = delete;
+	
+	bool store(std::string_view topic, const NmqttSharedBody &payload, uint8_t qos);
+	bool remove(std::string_view topic);
+	size_t collect(std::string_view filter, Cursor &cursor, size_t max,
+					std::vector<NmqttRetainedRef> &out);
+	void clear();
+	NmqttRetainedStats getStats();
+};
+
+
+#endif
@@ -18,17 +18,31 @@
 #include "dispatcher.h"
 #include "nymph_logger.h"
 #include "session.h"
+#include "poll_reactor.h"
+#include "uring_reactor.h"
 #include "server_connections.h"
+#include "socket_writer.h"
+#include "out_queue.h"
 
 #include <Poco/Net/NetException.h>
 #include <Poco/NumberFormatter.h>
 
+#include <thread>
+#include <algorithm>
+
 
 // Static initialisations.
 long NmqttServer::timeout = 3000;
 string NmqttServer::loggerName = "NmqttServer";
-Poco::Net::ServerSocket NmqttServer::ss;
-Poco::Net::TCPServer* NmqttServer::server;
+std::vector<NmqttServerReactor*> NmqttServer::reactors;
+uint32_t NmqttServer::reactorCount = std::max(std::thread::hardware_concurrency(), 1u);
+NmqttIoBackend NmqttServer::ioBackend = NMQTT_IO_BACKEND_POLL;
+uint16_t NmqttServer::topicAliasMaximum = 64;
+NmqttTopicTree NmqttServer::subscriptions;
+NmqttRetainedStore NmqttServer::retained;
+uint32_t NmqttServer::retainedChunk = 64;
+std::map<uint64_t, std::deque<NmqttServer::RetainedDelivery> > NmqttServer::retainedDeliveries;
+Poco::Mutex NmqttServer::retainedMutex;
 
 
 // --- CONSTRUCTOR ---
@@ -54,8 +68,17 @@ bool NmqttServer::init(std::function<void(int, std::string)> logger, int level,
 	//using namespace std::placeholders;
 	ns.connectHandler = &NmqttServer::connectHandler; //std::bind(&NmqttServer::connectHandler, this, _1);
 	ns.pingreqHandler = &NmqttServer::pingreqHandler; //std::bind(&NmqttServer::pingreqHandler, this, _1);
+	ns.publishHandler = &NmqttServer::publishHandler;
+	ns.pubrelHandler = &NmqttServer::pubrelHandler;
+	ns.subscribeHandler = &NmqttServer::subscribeHandler;
+	ns.unsubscribeHandler = &NmqttServer::unsubscribeHandler;
+	ns.disconnectHandler = &NmqttServer::disconnectHandler;
+	ns.topicAliasMaximum = topicAliasMaximum;
 	NmqttClientConnections::setCoreParameters(ns);
 	
+	// Retained messages for new subscriptions are sent a chunk at a time, as the client drains them.
+	NmqttOutbound::setDrainHandler(&NmqttServer::sendRetained);
+	
 	// Start the dispatcher runtime.
 	// Get the number of concurrent threads supported by the system we are running on.
 	int numThreads = std::thread::hardware_concurrency();
@@ -84,20 +107,90 @@ void NmqttServer::setLogger(std::function<void(int, std::string)> logger, int le
 }
 
 
+// --- SET RECEIVE BUFFER SIZE ---
+// Sets the initial size of the receive buffer of new client sessions, and the size up to which it
+// may grow while a socket keeps having more data available than fits.
+void NmqttServer::setReceiveBufferSize(uint32_t size, uint32_t max) {
+	NmqttSession::setReceiveBufferSize(size, max);
+}
+
+
+// --- SET FLUSH LATENCY ---
+// Sets the time in milliseconds that data for clients may be held back, so that small messages 
+// can be coalesced into fewer writes, and the amount of held back data at which it is sent 
+// regardless. The default latency of zero sends data as soon as the reactor gets to it.
+void NmqttServer::setFlushLatency(uint32_t ms, uint32_t size) {
+	NmqttOutQueue::setFlushLatency(ms, size);
+}
+
+
+// --- SET OUTBOUND LIMITS ---
+// Sets the limits on data queued for a single client. Above these, QoS 0 messages are handled as
+// set by the drop policy, while QoS 1 and 2 messages are held back, up to the spill limit, and the
+// broker stops reading from the client until its queue has drained to the low-water mark. A client
+// which exceeds the spill limit, or a QoS 0 limit with the disconnect policy, is disconnected.
+void NmqttServer::setOutboundLimits(const NmqttOutboundLimits &limits) {
+	NmqttOutbound::setLimits(limits);
+}
+
+
+// --- SET BACKPRESSURE HANDLERS ---
+// Sets the functions which are called with the handle of a client when its outbound queue goes
+// above the high-water mark, and when it drains to the low-water mark again. They are called on a
+// reactor thread, and must not block.
+void NmqttServer::setBackpressureHandlers(std::function<void(uint64_t)> highWater,
+										std::function<void(uint64_t)> lowWater) {
+	NmqttOutbound::setHandlers(highWater, lowWater);
+}
+
+
 // --- START ---
-bool NmqttServer::start(int port) {
-	try {
-		// Create a server socket that listens on all interfaces, IPv4 and IPv6.
-		// Assign it to the new TCPServer.
-		ss.bind6(port, true, false); // Port, SO_REUSEADDR, IPv6-only.
-		ss.listen();
-		server = new Poco::Net::TCPServer(
-					new Poco::Net::TCPServerConnectionFactoryImpl<NmqttSession>(), ss);
-		server->start();
-	}
-	catch (Poco::Net::NetException& e) {
-		NYMPH_LOG_ERROR("Error starting TCP server: " + e.message());
-		return false;
+// Start the reactor threads which accept and serve client connections. On Linux every reactor 
+// listens on the port itself, using SO_REUSEPORT. Elsewhere the first reactor accepts connections
+// and distributes them over all reactors.
+// The io_uring backend is used when selected, built in and supported by the kernel. Otherwise the
+// poll backend is used.
+// The socket options are set on the listening sockets, and on every accepted connection.
+bool NmqttServer::start(int port, const NmqttSocketOptions &options) {
+#ifdef __linux__
+	bool reusePort = true;
+#else
+	bool reusePort = false;
+#endif
+	
+	bool useUring = false;
+	if (ioBackend == NMQTT_IO_BACKEND_URING) {
+#ifdef NMQTT_IO_URING
+		useUring = NmqttUringReactor::supported();
+		if (!useUring) { NYMPH_LOG_WARNING("io_uring is not supported. Using poll backend."); }
+#else
+		NYMPH_LOG_WARNING("Built without io_uring support. Using poll backend.");
+#endif
+	}
+	
+	for (uint32_t i = 0; i < reactorCount; ++i) {
+		NmqttServerReactor* reactor;
+#ifdef NMQTT_IO_URING
+		if (useUring) { reactor = new NmqttUringReactor; }
+		else
+#endif
+		reactor = new NmqttPollReactor;
+		reactors.push_back(reactor);
+		reactor->setSocketOptions(options);
+		if ((reusePort || i == 0) && !reactor->listen(port, reusePort)) {
+			NYMPH_LOG_ERROR("Error starting TCP server on port " + Poco::NumberFormatter::format(port));
+			shutdown();
+			return false;
+		}
+	}
+	
+	if (!reusePort) { reactors[0]->setPeers(reactors); }
+	
+	for (NmqttServerReactor* reactor : reactors) {
+		if (!reactor->start()) {
+			shutdown();
+			return false;
+		}
 	}
 	
 	//running = true;
@@ -107,18 +200,36 @@ bool NmqttServer::start(int port) {
 
 // --- SEND MESSAGE ---
 // Private method for sending data to a remote broker.
-bool NmqttServer::sendMessage(uint64_t handle, std::string binMsg) {
-	NmqttClientSocket* clientSocket = NmqttClientConnections::getSocket(handle);
+bool NmqttServer::sendMessage(uint64_t handle, std::string_view binMsg) {
+	return sendMessage(handle, &binMsg, 1);
+}
+
+
+// --- SEND MESSAGE ---
+// Sends a message made up of multiple parts to a client, followed by the shared body if any, 
+// without concatenating them.
+bool NmqttServer::sendMessage(uint64_t handle, const std::string_view* parts, size_t count,
+								const NmqttSharedBody &body) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return false; }
+	if (clientSocket->sender) { return clientSocket->sender->send(handle, parts, count, body); }
+	
+	std::vector<std::string_view> all;
+	if (body) {
+		all.assign(parts, parts + count);
+		all.push_back(*body);
+		parts = all.data();
+		count = all.size();
+	}
 	
 	try {
-		int ret = clientSocket->socket->sendBytes(((const void*) binMsg.c_str()), binMsg.length());
-		if (ret != binMsg.length()) {
+		if (!NmqttSocketWriter::send(clientSocket->socket, parts, count)) {
 			// Handle error.
 			NYMPH_LOG_ERROR("Failed to send message. Not all bytes sent.");
 			return false;
 		}
 		
-		NYMPH_LOG_DEBUG("Sent " + Poco::NumberFormatter::format(ret) + " bytes.");
+		NYMPH_LOG_DEBUG("Sent message in " + Poco::NumberFormatter::format(count) + " parts.");
 	}
 	catch (Poco::Exception &e) {
 		NYMPH_LOG_ERROR("Failed to send message: " + e.message());
@@ -129,11 +240,74 @@ bool NmqttServer::sendMessage(uint64_t handle, std::string binMsg) {
 }
 
 
+// --- SEND ACK ---
+// Sends a PUBACK, PUBREC, PUBREL or PUBCOMP message with a success code to a client.
+bool NmqttServer::sendAck(uint64_t handle, MqttPacketType type, uint16_t packetID) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return false; }
+	
+	NmqttMessage msg(type);
+	msg.setProtocolVersion(clientSocket->version);
+	msg.setPacketID(packetID);
+	return sendMessage(handle, msg.serializeLocal());
+}
+
+
+// --- PUBLISH MESSAGE ---
+// Sends a PUBLISH message to a client, as the client's header followed by the shared body of the
+// fan-out. With MQTT 5, the topic is replaced with a topic alias where possible. QoS 1 and 2 
+// messages get the next packet identifier of the client. The alias table stays locked until the
+// message is sent, so that the client sees aliases in the order they were assigned in. A client
+// which disconnected after it was matched is skipped, as its handle matches no other connection.
+bool NmqttServer::publishMessage(uint64_t handle, NmqttFanout &fanout, MqttQoS qos, bool retain) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return false; }
+	
+	clientSocket->topicAliases->lock();
+	uint16_t packetID = 0;
+	if (qos != MQTT_QOS_AT_MOST_ONCE) {
+		if (++clientSocket->packetID == 0) { clientSocket->packetID = 1; }
+		packetID = clientSocket->packetID;
+	}
+	
+	uint16_t alias = 0;
+	bool known = false;
+	if (clientSocket->version == MQTT_PROTOCOL_VERSION_5) {
+		alias = clientSocket->topicAliases->assign(fanout.getTopic(), known);
+	}
+	
+	std::string_view header = fanout.header(qos, retain, clientSocket->version, packetID, alias,
+											known);
+	bool ret = !header.empty() && sendMessage(handle, &header, 1, fanout.getBody());
+	clientSocket->topicAliases->unlock();
+	
+	return ret;
+}
+
+
 // --- CONNECT HANDLER ---
 // Process connection. Return CONNACK response.
-void NmqttServer::connectHandler(uint64_t handle) {
+void NmqttServer::connectHandler(uint64_t handle, NmqttMessage &connect) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return; }
+	
 	NmqttMessage msg(MQTT_CONNACK);
-	sendMessage(handle, msg.serialize());
+	clientSocket->version = connect.getProtocolVersion();
+	if (clientSocket->version == MQTT_PROTOCOL_VERSION_5) {
+		// Use topic aliases for messages to the client up to its maximum, and advertise our own.
+		uint32_t aliasMax = 0;
+		connect.getProperty(MQTT_PROP_TOPIC_ALIAS_MAXIMUM, aliasMax);
+		clientSocket->topicAliases->lock();
+		clientSocket->topicAliases->setMaximum(aliasMax);
+		clientSocket->topicAliases->unlock();
+		
+		msg.setProtocolVersion(MQTT_PROTOCOL_VERSION_5);
+		if (clientSocket->topicAliasMaximum > 0) {
+			msg.setProperty(MQTT_PROP_TOPIC_ALIAS_MAXIMUM, clientSocket->topicAliasMaximum);
+		}
+	}
+	
+	sendMessage(handle, msg.serializeLocal());
 }
 
 
@@ -141,14 +315,208 @@ void NmqttServer::connectHandler(uint64_t handle) {
 // Reply to ping response from a client.
 void NmqttServer::pingreqHandler(uint64_t handle) {
 	NmqttMessage msg(MQTT_PINGRESP);
-	sendMessage(handle, msg.serialize());
+	sendMessage(handle, msg.serializeLocal());
+}
+
+
+// --- PUBLISH HANDLER ---
+// Acknowledges a PUBLISH message from a client, and sends it to every client with a matching 
+// subscription. Each subscriber gets the message with the lower of the published QoS and the QoS
+// it was granted. The message is encoded once, and its payload is shared by all subscribers.
+// A retained message is stored, sharing the same payload.
+void NmqttServer::publishHandler(uint64_t handle, NmqttMessage &msg) {
+	if (msg.getQoS() == MQTT_QOS_AT_LEAST_ONCE) { sendAck(handle, MQTT_PUBACK, msg.getPacketID()); }
+	else if (msg.getQoS() == MQTT_QOS_EXACTLY_ONCE) { 
+		sendAck(handle, MQTT_PUBREC, msg.getPacketID());
+	}
+	
+	static thread_local std::vector<NmqttSubscriber> subscribers;
+	std::string_view topic = msg.getTopicView();
+	subscriptions.match(topic, subscribers);
+	
+	uint8_t qos = msg.getQoS() >> 1;
+	NmqttSharedBody payload;
+	if (msg.getRetain() || !subscribers.empty()) {
+		payload = std::make_shared<const std::string>(msg.getPayloadView());
+	}
+	
+	if (msg.getRetain()) { retained.store(topic, payload, qos); }
+	if (subscribers.empty()) { return; }
+	
+	NmqttFanout fanout(topic, std::move(payload));
+	for (const NmqttSubscriber &sub : subscribers) {
+		publishMessage(sub.handle, fanout, (MqttQoS) (std::min(qos, sub.qos) << 1), false);
+	}
+}
+
+
+// --- PUBREL HANDLER ---
+// Completes a QoS 2 PUBLISH from a client. The message was sent on when it was received.
+void NmqttServer::pubrelHandler(uint64_t handle, NmqttMessage &msg) {
+	sendAck(handle, MQTT_PUBCOMP, msg.getPacketID());
+}
+
+
+// --- SUBSCRIBE HANDLER ---
+// Adds the subscriptions of a client to the topic tree, and replies with SUBACK. The requested
+// QoS is granted. Shared subscriptions are not supported. The matching retained messages are sent
+// after the SUBACK, as selected by the Retain Handling option of MQTT 5.
+void NmqttServer::subscribeHandler(uint64_t handle, NmqttMessage &msg) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return; }
+	
+	std::vector<std::pair<std::string_view, uint8_t> > retainedFilters;
+	std::string codes;
+	std::string_view filter;
+	uint8_t options;
+	for (uint32_t i = 0; msg.getTopicFilter(i, filter, options); ++i) {
+		if (filter.substr(0, 7) == "$share/") {
+			codes += (char) ((clientSocket->version == MQTT_PROTOCOL_VERSION_5) ? 
+								MQTT_CODE_SHARED_SUB_UNSUPPORTED : MQTT_CODE_UNSPECIFIED);
+			continue;
+		}
+		
+		uint8_t qos = options & 0x03;
+		bool added = subscriptions.subscribe(handle, filter, qos);
+		codes += (char) qos;
+		
+		// Retain Handling: 0 sends retained messages, 1 only for a new subscription, 2 never. The
+		// bits are zero with MQTT 3.1.1.
+		uint8_t handling = (options >> 4) & 0x03;
+		if (handling == 0 || (handling == 1 && added)) {
+			retainedFilters.push_back(std::pair<std::string_view, uint8_t>(filter, qos));
+		}
+	}
+	
+	NmqttMessage ack(MQTT_SUBACK);
+	ack.setProtocolVersion(clientSocket->version);
+	ack.setPacketID(msg.getPacketID());
+	ack.setReasonCodes(codes);
+	sendMessage(handle, ack.serializeLocal());
+	
+	for (const std::pair<std::string_view, uint8_t> &f : retainedFilters) {
+		queueRetained(handle, f.first, f.second);
+	}
+}
+
+
+// --- QUEUE RETAINED ---
+// Adds the delivery of the retained messages matching a new subscription to those of the client,
+// and starts sending them unless a delivery is already in progress.
+void NmqttServer::queueRetained(uint64_t handle, std::string_view filter, uint8_t qos) {
+	RetainedDelivery delivery;
+	delivery.filter = std::string(filter);
+	delivery.qos = qos;
+	
+	retainedMutex.lock();
+	std::deque<RetainedDelivery> &deliveries = retainedDeliveries[handle];
+	bool idle = deliveries.empty();
+	deliveries.push_back(std::move(delivery));
+	retainedMutex.unlock();
+	
+	if (idle) { sendRetained(handle); }
+}
+
+
+// --- SEND RETAINED ---
+// Sends the next chunk of retained messages to a client, with the lower of their QoS and the 
+// granted QoS. The cursor of the delivery is kept, and a drain marker is queued behind the chunk,
+// so that the next chunk follows once the client's reactor has sent this one. Only a chunk is 
+// thus queued for the client at any time. Also called as the outbound drain handler, on a reactor
+// thread. Without a reactor the chunk has been sent on return, and the next one follows directly.
+void NmqttServer::sendRetained(uint64_t handle) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return; }
+	
+	std::vector<NmqttRetainedRef> chunk;
+	while (true) {
+		uint8_t qos = 0;
+		retainedMutex.lock();
+		std::map<uint64_t, std::deque<RetainedDelivery> >::iterator it;
+		it = retainedDeliveries.find(handle);
+		if (it == retainedDeliveries.end()) {
+			retainedMutex.unlock();
+			return;
+		}
+		
+		std::deque<RetainedDelivery> &deliveries = it->second;
+		while (!deliveries.empty()) {
+			RetainedDelivery &d = deliveries.front();
+			if (retained.collect(d.filter, d.cursor, retainedChunk, chunk) > 0) {
+				qos = d.qos;
+				break;
+			}
+			
+			deliveries.pop_front();
+		}
+		
+		if (deliveries.empty()) { retainedDeliveries.erase(it); }
+		retainedMutex.unlock();
+		if (chunk.empty()) { return; }
+		
+		for (const NmqttRetainedRef &ref : chunk) {
+			NmqttFanout fanout(ref->topic, ref->payload);
+			MqttQoS q = (MqttQoS) (std::min(ref->qos, qos) << 1);
+			if (!publishMessage(handle, fanout, q, true)) {
+				retainedMutex.lock();
+				retainedDeliveries.erase(handle);
+				retainedMutex.unlock();
+				return;
+			}
+		}
+		
+		chunk.clear();
+		if (clientSocket->sender) {
+			clientSocket->sender->sendDrain(handle);
+			return;
+		}
+	}
+}
+
+
+// --- UNSUBSCRIBE HANDLER ---
+// Removes subscriptions of a client from the topic tree, and replies with UNSUBACK.
+void NmqttServer::unsubscribeHandler(uint64_t handle, NmqttMessage &msg) {
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return; }
+	
+	std::string codes;
+	std::string_view filter;
+	uint8_t options;
+	for (uint32_t i = 0; msg.getTopicFilter(i, filter, options); ++i) {
+		codes += (char) (subscriptions.unsubscribe(handle, filter) ? 
+								MQTT_CODE_SUCCESS : MQTT_CODE_NO_SUBSCRIPTION_EXISTED);
+	}
+	
+	NmqttMessage ack(MQTT_UNSUBACK);
+	ack.setProtocolVersion(clientSocket->version);
+	ack.setPacketID(msg.getPacketID());
+	ack.setReasonCodes(codes);
+	sendMessage(handle, ack.serializeLocal());
+}
+
+
+// --- DISCONNECT HANDLER ---
+// Removes the subscriptions and pending retained deliveries of a client whose connection is 
+// closed.
+void NmqttServer::disconnectHandler(uint64_t handle) {
+	subscriptions.removeSession(handle);
+	
+	retainedMutex.lock();
+	retainedDeliveries.erase(handle);
+	retainedMutex.unlock();
 }
 
 
 // --- SHUTDOWN ---
 // Shutdown the runtime. Close any open connections and clean up resources.
 bool NmqttServer::shutdown() {
-	server->stop();
+	for (NmqttServerReactor* reactor : reactors) {
+		reactor->stop();
+		delete reactor;
+	}
+	
+	reactors.clear();
 	
 	return true;
 }
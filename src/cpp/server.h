@@ -17,25 +17,61 @@
 #define NMQTT_SERVER_H
 
 #include <string>
+#include <vector>
+#include <map>
+#include <deque>
 #include <functional>
 
 #include <Poco/Net/SocketAddress.h>
 #include <Poco/Net/StreamSocket.h>
-#include <Poco/Net/TCPServer.h>
+#include <Poco/Mutex.h>
 
 #include "nymph_logger.h"
 #include "message.h"
+#include "server_reactor.h"
+#include "outbound.h"
+#include "socket_options.h"
+#include "topic_tree.h"
+#include "match_cache.h"
+#include "fanout.h"
+#include "retained_store.h"
 
 
 class NmqttServer {
 	static long timeout;
 	static std::string loggerName;
-	static Poco::Net::ServerSocket ss;
-	static Poco::Net::TCPServer* server;
+	static std::vector<NmqttServerReactor*> reactors;
+	static uint32_t reactorCount;
+	static NmqttIoBackend ioBackend;
+	static uint16_t topicAliasMaximum;
+	static NmqttTopicTree subscriptions;
+	static NmqttRetainedStore retained;
+	static uint32_t retainedChunk;
 	
-	static bool sendMessage(uint64_t handle, std::string binMsg);
-	static void connectHandler(uint64_t handle);
+	// Retained messages which remain to be sent for new subscriptions of a client.
+	struct RetainedDelivery {
+		std::string filter;
+		uint8_t qos;
+		NmqttRetainedStore::Cursor cursor;
+	};
+	
+	static std::map<uint64_t, std::deque<RetainedDelivery> > retainedDeliveries;
+	static Poco::Mutex retainedMutex;
+	
+	static bool sendMessage(uint64_t handle, std::string_view binMsg);
+	static bool sendMessage(uint64_t handle, const std::string_view* parts, size_t count,
+								const NmqttSharedBody &body = NmqttSharedBody());
+	static bool sendAck(uint64_t handle, MqttPacketType type, uint16_t packetID);
+	static bool publishMessage(uint64_t handle, NmqttFanout &fanout, MqttQoS qos, bool retain);
+	static void queueRetained(uint64_t handle, std::string_view filter, uint8_t qos);
+	static void sendRetained(uint64_t handle);
+	static void connectHandler(uint64_t handle, NmqttMessage &msg);
 	static void pingreqHandler(uint64_t handle);
+	static void publishHandler(uint64_t handle, NmqttMessage &msg);
+	static void pubrelHandler(uint64_t handle, NmqttMessage &msg);
+	static void subscribeHandler(uint64_t handle, NmqttMessage &msg);
+	static void unsubscribeHandler(uint64_t handle, NmqttMessage &msg);
+	static void disconnectHandler(uint64_t handle);
 	
 public:
 	NmqttServer();
@@ -43,7 +79,19 @@ public:
 	
 	static bool init(std::function<void(int, std::string)> logger, int level = NYMPH_LOG_LEVEL_TRACE, long timeout = 3000);
 	static void setLogger(std::function<void(int, std::string)> logger, int level);
-	static bool start(int port = 4004);
+	static void setTopicAliasMaximum(uint16_t max) { topicAliasMaximum = max; }
+	static void setReactorCount(uint32_t count) { reactorCount = (count > 0) ? count : 1; }
+	static void setReceiveBufferSize(uint32_t size, uint32_t max);
+	static void setFlushLatency(uint32_t ms, uint32_t size = 64 * 1024);
+	static void setOutboundLimits(const NmqttOutboundLimits &limits);
+	static void setBackpressureHandlers(std::function<void(uint64_t)> highWater,
+										std::function<void(uint64_t)> lowWater);
+	static void setIoBackend(NmqttIoBackend backend) { ioBackend = backend; }
+	static void setMatchCacheSize(size_t topics) { subscriptions.setCacheSize(topics); }
+	static NmqttMatchCacheStats getMatchCacheStats() { return subscriptions.getCacheStats(); }
+	static void setRetainedChunk(uint32_t messages) { retainedChunk = (messages > 0) ? messages : 1; }
+	static NmqttRetainedStats getRetainedStats() { return retained.getStats(); }
+	static bool start(int port = 4004, const NmqttSocketOptions &options = NmqttSocketOptions());
 	static bool shutdown();
 };
 
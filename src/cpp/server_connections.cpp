@@ -17,48 +17,66 @@
 
 
 // Static initialisations.
-std::map<uint64_t, NmqttClientSocket> NmqttClientConnections::sockets;
-uint64_t NmqttClientConnections::lastHandle = 0;
+std::map<uint64_t, std::shared_ptr<NmqttClientSocket> > NmqttClientConnections::sockets;
+uint32_t NmqttClientConnections::lastSlot = 0;
 std::queue<uint64_t> NmqttClientConnections::freeHandles;
 NmqttClientSocket NmqttClientConnections::coreCS;
+Poco::Mutex NmqttClientConnections::socketsMutex;
+
+
+// Bits of a handle which hold the slot, and the mask of the generation above them.
+static const int slotBits = 32;
+static const uint64_t generationMask = ((uint64_t) 1 << 24) - 1;
 
 
 // --- ADD SOCKET ---
 uint64_t NmqttClientConnections::addSocket(NmqttClientSocket &ns) {
-	// Add new instance to map, return either a new handle ID, or one from the FIFO.
+	// Add new instance to map, return either a new handle ID, or one with a slot from the FIFO and
+	// the next generation of that slot.
+	Poco::Mutex::ScopedLock lock(socketsMutex);
 	uint64_t handle;
 	if (!freeHandles.empty()) {
-		handle = freeHandles.front();
+		uint64_t old = freeHandles.front();
 		freeHandles.pop();
+		uint64_t generation = ((old >> slotBits) + 1) & generationMask;
+		handle = (generation << slotBits) | (old & (((uint64_t) 1 << slotBits) - 1));
 	}
 	else {
-		handle = lastHandle++;
+		handle = lastSlot++;
 	}
 	
 	// Merge core and provided struct.
-	NmqttClientSocket ts = coreCS;
-	ts.socket = ns.socket;
-	sockets.insert(std::pair<uint64_t, NmqttClientSocket>(handle, ts));
+	std::shared_ptr<NmqttClientSocket> ts = std::make_shared<NmqttClientSocket>(coreCS);
+	ts->socket = ns.socket;
+	ts->sender = ns.sender;
+	ts->version = MQTT_PROTOCOL_VERSION_4;
+	ts->topicAliases = std::make_shared<NmqttOutboundAliases>();
+	sockets.insert(std::pair<uint64_t, std::shared_ptr<NmqttClientSocket> >(handle, ts));
 	
 	return handle;
 }
 
 
 // --- GET SOCKET ---
-NmqttClientSocket* NmqttClientConnections::getSocket(uint64_t handle) {
-	std::map<uint64_t, NmqttClientSocket>::iterator it;
+// Returns the entry of a connection, or null if the handle is not, or no longer, in use. The entry
+// is shared, so that it remains valid while the caller uses it, even if the connection is removed
+// meanwhile.
+std::shared_ptr<NmqttClientSocket> NmqttClientConnections::getSocket(uint64_t handle) {
+	Poco::Mutex::ScopedLock lock(socketsMutex);
+	std::map<uint64_t, std::shared_ptr<NmqttClientSocket> >::iterator it;
 	it = sockets.find(handle);
 	if (it == sockets.end()) {
-		return 0;
+		return std::shared_ptr<NmqttClientSocket>();
 	}
 	
-	return &it->second;
+	return it->second;
 }
 
 
 // --- REMOVE SOCKET ---
 void NmqttClientConnections::removeSocket(uint64_t handle) {
-	std::map<uint64_t, NmqttClientSocket>::iterator it;
+	Poco::Mutex::ScopedLock lock(socketsMutex);
+	std::map<uint64_t, std::shared_ptr<NmqttClientSocket> >::iterator it;
 	it = sockets.find(handle);
 	if (it == sockets.end()) {
 		return;
@@ -7,7 +7,14 @@
 			- Static class to enable the global management of client connections.
 			
 	Notes:
-			- 
+			- The connection table is shared by all server reactor threads and the worker threads,
+				and is protected by a mutex. Entries are shared, and a looked up entry stays valid
+				after the connection has been removed.
+			- A handle holds the slot of a connection in its lower 32 bits, and the generation of
+				the slot in the 24 bits above, as the io_uring reactor uses the top byte of its
+				request data. A reused slot gets the next generation, so that a handle which was
+				kept after a disconnect, such as that of a subscriber, does not match the new
+				connection.
 			
 	2021/01/04 - Maya Posch
 */
@@ -19,13 +26,19 @@
 
 #include <map>
 #include <queue>
+#include <memory>
 #include <functional>
 
 #include <Poco/Semaphore.h>
+#include <Poco/Mutex.h>
 #include <Poco/Net/StreamSocket.h>
 #include <Poco/Net/SecureStreamSocket.h>
 
 #include "client.h"
+#include "topic_alias.h"
+
+
+class NmqttServerReactor;
 
 
 // TYPES
@@ -33,11 +46,17 @@ struct NmqttClientSocket {
 	//bool secure;						// Are using an SSL/TLS connection or not?
 	//Poco::Net::SecureStreamSocket* ssocket;	// Pointer to a secure socket instance.
 	//Poco::Net::Context::Ptr context;	// The security context for TLS connections.
-	Poco::Net::StreamSocket* socket;	// Pointer to a non-secure socket instance.
+	Poco::Net::StreamSocket socket;		// The socket, shared with the session.
+	NmqttServerReactor* sender;			// Reactor which performs sends, or null to send directly.
 	//Poco::Semaphore* semaphore;			// Signals when it's safe to delete the socket.
 	//std::function<void(int, std::string, std::string)> handler;		// Publish message handler.
-	std::function<void(uint64_t)> connectHandler;	// CONNECT handler.
+	std::function<void(uint64_t, NmqttMessage&)> connectHandler;	// CONNECT handler.
 	std::function<void(uint64_t)> pingreqHandler;	// PINGREQ handler.
+	std::function<void(uint64_t, NmqttMessage&)> publishHandler;		// PUBLISH handler.
+	std::function<void(uint64_t, NmqttMessage&)> pubrelHandler;		// PUBREL handler.
+	std::function<void(uint64_t, NmqttMessage&)> subscribeHandler;	// SUBSCRIBE handler.
+	std::function<void(uint64_t, NmqttMessage&)> unsubscribeHandler;	// UNSUBSCRIBE handler.
+	std::function<void(uint64_t)> disconnectHandler;	// Called before the connection is removed.
 	//void* data;						// User data.
 	//int handle;						// The Nymph internal socket handle.
 	bool username;
@@ -46,18 +65,23 @@ struct NmqttClientSocket {
 	uint8_t qos;
 	bool willFlag;
 	bool cleanSession;
+	MqttProtocolVersion version;
+	uint16_t topicAliasMaximum;		// Maximum for aliases of received topics.
+	uint16_t packetID = 0;			// Last packet identifier sent. Guarded by topicAliases.
+	std::shared_ptr<NmqttOutboundAliases> topicAliases;	// Aliases for topics sent to the client.
 };
 
 
 class NmqttClientConnections {
-	static std::map<uint64_t, NmqttClientSocket> sockets;
-	static uint64_t lastHandle;
+	static std::map<uint64_t, std::shared_ptr<NmqttClientSocket> > sockets;
+	static uint32_t lastSlot;
 	static std::queue<uint64_t> freeHandles;
 	static NmqttClientSocket coreCS;
+	static Poco::Mutex socketsMutex;
 	
 public:
 	static uint64_t addSocket(NmqttClientSocket &ns);
-	static NmqttClientSocket* getSocket(uint64_t handle);
+	static std::shared_ptr<NmqttClientSocket> getSocket(uint64_t handle);
 	static void removeSocket(uint64_t handle);
 	static void setCoreParameters(NmqttClientSocket &ns);
 };
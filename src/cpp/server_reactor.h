@@ -0,0 +1,78 @@
+/*
+	server_reactor.h - Header for the NymphMQTT Server reactor interface.
+	
+	Revision 0
+	
+	Features:
+			- Interface of the I/O backends which accept and serve client connections.
+			
+	Notes:
+			- The broker runs a number of reactors, each with its own thread and set of sessions.
+			- NmqttPollReactor uses NmqttPoller (epoll, poll or WSAPoll) and works everywhere. 
+				NmqttUringReactor uses io_uring on Linux, when built with NMQTT_IO_URING.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_SERVER_REACTOR_H
+#define NMQTT_SERVER_REACTOR_H
+
+
+#include <vector>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+#include <Poco/Net/StreamSocket.h>
+
+#include "socket_options.h"
+#include "outbound.h"
+
+
+enum NmqttIoBackend {
+	NMQTT_IO_BACKEND_POLL = 0,
+	NMQTT_IO_BACKEND_URING
+};
+
+
+class NmqttServerReactor {
+protected:
+	NmqttSocketOptions socketOptions;
+	
+public:
+	virtual ~NmqttServerReactor() { }
+	
+	// Options for the listening socket and accepted connections. Set before listen().
+	void setSocketOptions(const NmqttSocketOptions &options) { socketOptions = options; }
+	
+	// Creates the reactor's listening socket. With reusePort every reactor listens on the port.
+	virtual bool listen(int port, bool reusePort) = 0;
+	
+	// Reactors to distribute accepted connections over, when only one reactor listens.
+	virtual void setPeers(std::vector<NmqttServerReactor*> &peers) = 0;
+	virtual bool start() = 0;
+	virtual void stop() = 0;
+	
+	// Hands an accepted connection to this reactor. Can be called from any thread.
+	virtual void adopt(const Poco::Net::StreamSocket &socket) = 0;
+	
+	// Sends data made up of one or more parts on a connection owned by this reactor, followed by
+	// the shared body, if any. The parts are copied, the body is kept by reference until it has
+	// been sent. Only used by reactors which perform sends themselves. Can be called from any 
+	// thread.
+	virtual bool send(uint64_t handle, const std::string_view* parts, size_t count,
+						const NmqttSharedBody &body) { return false; }
+	bool send(uint64_t handle, const std::string_view* parts, size_t count) {
+		return send(handle, parts, count, NmqttSharedBody());
+	}
+	
+	bool send(uint64_t handle, std::string_view data) { return send(handle, &data, 1); }
+	
+	// Queues a drain marker, after which the outbound drain handler is called for the connection
+	// once the data queued before it has been sent.
+	bool sendDrain(uint64_t handle) { return send(handle, 0, 0); }
+};
+
+
+#endif
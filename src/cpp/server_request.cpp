@@ -18,24 +18,41 @@
 
 // --- PROCESS ---
 void NmqttServerRequest::process() {
-	NmqttClientSocket* clientSocket = NmqttClientConnections::getSocket(handle);
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (!clientSocket) { return; }
 	
-	/* if (msg.getCommand() == MQTT_PUBLISH) {
+	if (msg.getCommand() == MQTT_PUBLISH) {
 		NYMPH_LOG_DEBUG("Calling PUBLISH message handler...");
-		clientSocket->handler(handle, msg.getTopic(), msg.getPayload());
+		clientSocket->publishHandler(handle, msg);
 	}
-	else */ if (msg.getCommand() == MQTT_CONNECT) {
+	else if (msg.getCommand() == MQTT_CONNECT) {
 		NYMPH_LOG_DEBUG("Calling CONNECT message handler...");
-		clientSocket->connectHandler(handle);
+		clientSocket->connectHandler(handle, msg);
 	}
 	else if (msg.getCommand() == MQTT_PINGREQ) {
 		NYMPH_LOG_DEBUG("Calling PINGREQ message handler...");
 		clientSocket->pingreqHandler(handle);
 	}
+	else if (msg.getCommand() == MQTT_SUBSCRIBE) {
+		NYMPH_LOG_DEBUG("Calling SUBSCRIBE message handler...");
+		clientSocket->subscribeHandler(handle, msg);
+	}
+	else if (msg.getCommand() == MQTT_UNSUBSCRIBE) {
+		NYMPH_LOG_DEBUG("Calling UNSUBSCRIBE message handler...");
+		clientSocket->unsubscribeHandler(handle, msg);
+	}
+	else if (msg.getCommand() == MQTT_PUBREL) {
+		NYMPH_LOG_DEBUG("Calling PUBREL message handler...");
+		clientSocket->pubrelHandler(handle, msg);
+	}
 }
 
 
 // --- FINISH ---
 void NmqttServerRequest::finish() {
-	//
+	// Return to the pool, or call own destructor if not pooled. The pool reference is dropped last,
+	// as this may destroy the pool along with this request.
+	std::shared_ptr<NmqttRequestPool<NmqttServerRequest> > p = std::move(pool);
+	if (p) { p->release(this); }
+	else { delete this; }
 }
@@ -18,6 +18,7 @@
 #include "abstract_request.h"
 #include "server_connections.h"
 #include "message.h"
+#include "request_pool.h"
 
 
 #include <string>
@@ -30,14 +31,20 @@ using namespace std;
 
 class NmqttServerRequest : public AbstractRequest {
 	std::string value;
-	int handle;
+	uint64_t handle;
 	NmqttMessage msg;
 	std::string loggerName = "NmqttServerRequest";
+	std::shared_ptr<NmqttRequestPool<NmqttServerRequest> > pool;
 	
 public:
 	NmqttServerRequest() { }
 	void setValue(std::string value) { this->value = value; }
-	void setMessage(uint64_t handle, NmqttMessage msg) { this->handle = handle; this->msg = msg; }
+	void setMessage(uint64_t handle, NmqttMessage &&msg) { this->handle = handle; this->msg = std::move(msg); }
+	void setHandle(uint64_t handle) { this->handle = handle; }
+	NmqttMessage& getMessage() { return msg; }
+	void setPool(std::shared_ptr<NmqttRequestPool<NmqttServerRequest> > pool) { 
+		this->pool = std::move(pool);
+	}
 	void process();
 	void finish();
 };
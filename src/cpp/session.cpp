@@ -14,184 +14,168 @@
 #include "server_request.h"
 #include "dispatcher.h"
 #include "nymph_logger.h"
+#include "socket_options.h"
 
 #include <Poco/NumberFormatter.h>
+#include <Poco/Exception.h>
 
 
-// --- CONSTRUCTOR ---
-NmqttSession::NmqttSession(const Poco::Net::StreamSocket& socket) 
-							: Poco::Net::TCPServerConnection(socket) {
-	loggerName = "NmqttSession";
-	listen = true;
-}
+// Static initialisations.
+uint32_t NmqttSession::receiveBufferSize = 16 * 1024;
+uint32_t NmqttSession::receiveBufferMax = 64 * 1024;
 
 
 // --- CONSTRUCTOR ---
-/* NmqttSession::NmqttSession(int handle, Condition* cnd, Mutex* mtx) {
+// Adds the connection to the list of client connections. Data for the client is sent by the
+// sender reactor if provided, else directly on the socket.
+NmqttSession::NmqttSession(const Poco::Net::StreamSocket& socket, NmqttServerReactor* sender) 
+																			: socket(socket) {
 	loggerName = "NmqttSession";
-	listen = true;
-	init = true;
-	this->nymphSocket = NmqttConnections::getSocket(handle);
-	this->socket = nymphsocket.socket;
-	this->readyCond = cnd;
-	this->readyMutex = mtx;
-} */
+	version = MQTT_PROTOCOL_VERSION_4;
+	requestPool = std::make_shared<NmqttRequestPool<NmqttServerRequest> >();
+	buffer.resize(receiveBufferSize);
+	
+	NmqttClientSocket sk;
+	sk.socket = this->socket;
+	sk.sender = sender;
+	handle = NmqttClientConnections::addSocket(sk);
+}
 
 
 // --- DECONSTRUCTOR ---
+// Removes the connection from the list of client connections and closes the socket. The server
+// removes the state of the client first, as the handle may be reused after this.
 NmqttSession::~NmqttSession() {
-	//
+	std::shared_ptr<NmqttClientSocket> clientSocket = NmqttClientConnections::getSocket(handle);
+	if (clientSocket && clientSocket->disconnectHandler) { clientSocket->disconnectHandler(handle); }
+	NmqttClientConnections::removeSocket(handle);
+	
+	try {
+		socket.close();
+	}
+	catch (Poco::Exception &e) { }
 }
 
 
-// --- RUN ---
-void NmqttSession::run() {
-	Poco::Net::StreamSocket& socket = this->socket();
-	
-	// Add this connection to the list of client connections.
-	NmqttClientSocket sk;
-	sk.socket = &socket;
-	uint64_t handle = NmqttClientConnections::addSocket(sk);
-	
-	Poco::Timespan timeout(0, 100); // 100 microsecond timeout
-	
-	NYMPH_LOG_INFORMATION("Start listening...");
-	
-	char headerBuff[5];
-	while (listen) {
-		if (socket.poll(timeout, Poco::Net::Socket::SELECT_READ)) {
-			// Attempt to receive the entire message.
-			// First validate the first two bytes. If it's an MQTT message this will contain the
-			// command and the first byte of the message length.
-			//
-			// Unfortunately, MQTT's message length is a variable length integer, spanning 1-4 bytes.
-			// Because of this, we have to read in the first byte, see whether a second one follows
-			// by looking at the 8th bit of the byte, read that in, and so on.
-			//
-			// The smallest message we can receive is the Disconnect type, with just two bytes.
-			int received = socket.receiveBytes((void*) &headerBuff, 2);
-			if (received == 0) {
-				// Remote disconnnected. Socket should be discarded.
-				NYMPH_LOG_INFORMATION("Received remote disconnected notice. Terminating listener thread.");
-				break;
-			}
-			else if (received < 2) {
-				// TODO: try to wait for more bytes.
-				NYMPH_LOG_WARNING("Received <2 bytes: " + Poco::NumberFormatter::format(received));
-				
-				continue;
-			}
-			
-			// Use the NmqttMessage class's validation feature to extract the message length from
-			// the fixed header.
-			NmqttMessage msg;
-			uint32_t msglen = 0;
-			int idx = 0; // Will be set to the index after the fixed header by the parse method.
-			while (!msg.parseHeader((char*) &headerBuff, 5, msglen, idx)) {
-				// Attempt to read more data. The index parameter is placed at the last valid
-				// byte in the headerBuff array. Append new data after this.
-				
-				NYMPH_LOG_WARNING("Too few bytes to parse header. Aborting...");
-				
-				// TODO: abort reading for now.
-				continue;
-			}
-			
-			NYMPH_LOG_DEBUG("Message length: " + Poco::NumberFormatter::format(msglen));
-			
-			std::string binMsg;
-			if (msglen > 0) {
-				// Create new buffer for the rest of the message.
-				char* buff = new char[msglen];
-				
-				// Read the entire message into a string which is then used to
-				// construct an NmqttMessage instance.
-				received = socket.receiveBytes((void*) buff, msglen);
-				binMsg.append(headerBuff, idx);
-				binMsg.append(buff, received);
-				if (received != msglen) {
-					// Handle incomplete message.
-					NYMPH_LOG_WARNING("Incomplete message: " 
-										+ Poco::NumberFormatter::format(received) 
-										+ " of " + Poco::NumberFormatter::format(msglen));
-					
-					// Loop until the rest of the message has been received.
-					// TODO: Set a maximum number of loops/timeout? Reset when 
-					// receiving data, timeout when poll times out N times?
-					//binMsg->reserve(msglen);
-					int unread = msglen - received;
-					while (1) {
-						if (socket.poll(timeout, Poco::Net::Socket::SELECT_READ)) {
-							char* buff1 = new char[unread];
-							received = socket.receiveBytes((void*) buff1, unread);
-							if (received == 0) {
-								// Remote disconnnected. Socket should be discarded.
-								NYMPH_LOG_INFORMATION("Received remote disconnected notice. Terminating listener thread.");
-								delete[] buff1;
-								break;
-							}
-							else if (received != unread) {
-								binMsg.append((const char*) buff1, received);
-								delete[] buff1;
-								unread -= received;
-								NYMPH_LOG_WARNING("Incomplete message: " 
-													+ Poco::NumberFormatter::format(unread) + "/" 
-													+ Poco::NumberFormatter::format(msglen) 
-													+ " unread.");
-								continue;
-							}
-							
-							// Full message was read. Continue with processing.
-							binMsg.append((const char*) buff1, received);
-							delete[] buff1;
-							break;
-						} // if
-					} //while
-				}
-				else { 
-					NYMPH_LOG_DEBUG("Read " + Poco::NumberFormatter::format(received) + " bytes.");
-				}
-				
-				delete[] buff;
-			}
-			else {
-				//
-				binMsg.append(headerBuff, idx);
-			}
-			
-			// Parse the string into an NmqttMessage instance.
-			msg.parseMessage(binMsg);	
-			
-			NYMPH_LOG_DEBUG("Got command: " + Poco::NumberFormatter::format(msg.getCommand()));
-			
-			// Call the message handler callback when one exists for this type of message.
-			// TODO: refactor for Dispatcher.
-			NmqttServerRequest* req = new NmqttServerRequest;
-			req->setMessage(handle, msg);
-			Dispatcher::addRequest(req);
+// --- SET RECEIVE BUFFER SIZE ---
+// Sets the initial size of the receive buffer of new sessions, and the size up to which it may 
+// grow while the socket keeps having more data available than fits.
+void NmqttSession::setReceiveBufferSize(uint32_t size, uint32_t max) {
+	receiveBufferSize = (size > 0) ? size : 1;
+	receiveBufferMax = (max > receiveBufferSize) ? max : receiveBufferSize;
+}
+
+
+// --- READABLE ---
+// Called by the reactor when data is available on the socket. Returns false if the connection was
+// closed or has failed, after which the session should be deleted.
+bool NmqttSession::readable() {
+	// Read as much data as is available, into the receive buffer. MQTT's message length is a 
+	// variable length integer, spanning 1-4 bytes, so a read may contain any number of partial or
+	// complete messages. All complete messages are dispatched before the next read, with the 
+	// frame decoder keeping any partial message.
+	while (true) {
+		int received;
+		try {
+			received = socket.receiveBytes((void*) buffer.data(), buffer.size());
+		}
+		catch (Poco::Exception &e) {
+			NYMPH_LOG_ERROR("Failed to read from socket: " + e.message());
+			return false;
 		}
 		
-		// Check whether we're still initialising.
-		/* if (init) {
-			// Signal that this listener thread is ready.
-			readyMutex->lock();
-			readyCond->signal();
-			readyMutex->unlock();
-			
-			timeout.assign(1, 0); // Change timeout to 1 second.
-			init = false;
-		} */
+		if (received == 0) {
+			// Remote disconnnected. Socket should be discarded.
+			NYMPH_LOG_INFORMATION("Received remote disconnected notice. Terminating session.");
+			return false;
+		}
+		else if (received < 0) {
+			return true;
+		}
+		
+		NYMPH_LOG_DEBUG("Read " + Poco::NumberFormatter::format(received) + " bytes.");
+		
+		if (!processData(buffer.data(), received)) { return false; }
+		
+		// A short read means that the socket has been drained.
+		if ((size_t) received < buffer.size()) { break; }
+		
+		// The buffer was filled. Grow it for the next read, and check whether more data is 
+		// waiting, as the socket is blocking.
+		if (buffer.size() < receiveBufferMax) {
+			size_t size = buffer.size() * 2;
+			buffer.resize((size < receiveBufferMax) ? size : receiveBufferMax);
+		}
+		
+		try {
+			if (socket.available() <= 0) { break; }
+		}
+		catch (Poco::Exception &e) {
+			break;
+		}
 	}
 	
-	NYMPH_LOG_INFORMATION("Stopping thread...");
-	
-	// Clean-up.
-	// Remove this session from the list.
-	NmqttClientConnections::removeSocket(handle);
+	return true;
 }
 
 
-// --- STOP ---
-void NmqttSession::stop() {
-	listen = false;
+// --- PROCESS DATA ---
+// Feeds received data to the frame decoder, dispatching each complete message. Returns false if
+// the data is corrupted or a protocol error occurred.
+bool NmqttSession::processData(const char* data, size_t unread) {
+	if (quickAck) { NmqttSocketOptions::rearmQuickAck(socket); }
+	
+	while (unread > 0) {
+		size_t used = 0;
+		int res = decoder.feed(data, unread, used);
+		data += used;
+		unread -= used;
+		if (res < 0) {
+			NYMPH_LOG_ERROR("Received corrupted data. Terminating session.");
+			return false;
+		}
+		else if (res == 0) {
+			// Wait for the rest of the message.
+			break;
+		}
+		
+		// Parse the complete message into the message instance of a pooled request. The 
+		// buffers of the decoder, this session and the message are swapped, so that their 
+		// capacity is reused.
+		NmqttServerRequest* req = requestPool->acquire();
+		NmqttMessage &msg = req->getMessage();
+		decoder.takeFrame(frame);
+		msg.setProtocolVersion(version);
+		if (msg.parseFrame(frame) < 0) {
+			// A malformed message is a protocol error, which closes the connection.
+			NYMPH_LOG_ERROR("Received malformed message. Terminating session.");
+			req->finish();
+			return false;
+		}
+		
+		NYMPH_LOG_DEBUG("Got command: " + Poco::NumberFormatter::format(msg.getCommand()));
+		
+		if (msg.getCommand() == MQTT_CONNECT) {
+			// Subsequent messages use the MQTT version of the CONNECT message.
+			version = msg.getProtocolVersion();
+			std::shared_ptr<NmqttClientSocket> clientSocket;
+			clientSocket = NmqttClientConnections::getSocket(handle);
+			if (version == MQTT_PROTOCOL_VERSION_5 && clientSocket) {
+				topicAliases.setMaximum(clientSocket->topicAliasMaximum);
+			}
+		}
+		else if (msg.getCommand() == MQTT_PUBLISH && version == MQTT_PROTOCOL_VERSION_5 
+					&& !topicAliases.resolve(msg)) {
+			// Invalid topic alias. This is a protocol error, which closes the connection.
+			NYMPH_LOG_ERROR("Received PUBLISH with invalid topic alias. Terminating session.");
+			req->finish();
+			return false;
+		}
+		
+		// Call the message handler callback when one exists for this type of message.
+		req->setHandle(handle);
+		Dispatcher::addRequest(req);
+	}
+	
+	return true;
 }
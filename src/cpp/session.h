@@ -1,6 +1,12 @@
 /*
 	session.h - Declaration of NMQTT session class.
 	
+	Notes:
+			- A session holds the state of a single client connection. It is driven by a server 
+				reactor thread, which calls readable() when data is available on the socket, or passes
+				received data to processData() directly.
+			- Each session has its own receive buffer, which grows while reads fill it.
+	
 	2021/01/04, Maya Posch
 */
 
@@ -9,23 +15,44 @@
 #define NMQTT_SESSION_H
 
 
-#include <Poco/Net/TCPServerConnection.h>
-#include <Poco/Semaphore.h>
-#include <Poco/Condition.h>
+#include <vector>
+
+#include <Poco/Net/StreamSocket.h>
+
+#include "frame_decoder.h"
+#include "topic_alias.h"
+#include "server_request.h"
+
 
+class NmqttServerReactor;
 
-class NmqttSession : public Poco::Net::TCPServerConnection {
+
+class NmqttSession {
 	std::string loggerName;
-	bool listen;
-	bool init;
-	Poco::Condition* readyCond;
-	Poco::Mutex* readyMutex;
+	Poco::Net::StreamSocket socket;
+	uint64_t handle;
+	NmqttFrameDecoder decoder;
+	NmqttInboundAliases topicAliases;
+	MqttProtocolVersion version;
+	std::shared_ptr<NmqttRequestPool<NmqttServerRequest> > requestPool;
+	std::string frame;
+	std::vector<char> buffer;
+	bool quickAck = false;
+	
+	static uint32_t receiveBufferSize;
+	static uint32_t receiveBufferMax;
 	
 public:
-	NmqttSession(const Poco::Net::StreamSocket& socket);
+	NmqttSession(const Poco::Net::StreamSocket& socket, NmqttServerReactor* sender = 0);
 	~NmqttSession();
-	void run();
-	void stop();
+	
+	static void setReceiveBufferSize(uint32_t size, uint32_t max);
+	
+	void setQuickAck(bool enable) { quickAck = enable; }
+	uint64_t getHandle() { return handle; }
+	Poco::Net::StreamSocket& getSocket() { return socket; }
+	bool readable();
+	bool processData(const char* data, size_t len);
 };
 
 #endif
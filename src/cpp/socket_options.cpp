@@ -0,0 +1,113 @@
+/*
+	socket_options.cpp - Implementation of the NymphMQTT socket options structure.
+	
+	Revision 0
+	
+	Features:
+			- Tuning options for client connections and listening sockets.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "socket_options.h"
+
+#include <Poco/Exception.h>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+
+// --- LATENCY ---
+// Small messages are sent and acknowledged straight away. Busy polling is left to the caller, as
+// it costs CPU time and usually needs privileges.
+NmqttSocketOptions NmqttSocketOptions::latency() {
+	NmqttSocketOptions options;
+	options.noDelay = true;
+	options.quickAck = true;
+	return options;
+}
+
+
+// --- THROUGHPUT ---
+// Large buffers, so that bulk transfers are not limited by the window size on fast links with a
+// high round trip time. Nagle's algorithm stays enabled to fill segments.
+NmqttSocketOptions NmqttSocketOptions::throughput() {
+	NmqttSocketOptions options;
+	options.sendBufferSize = 4 * 1024 * 1024;
+	options.receiveBufferSize = 4 * 1024 * 1024;
+	options.listenBacklog = 1024;
+	return options;
+}
+
+
+// --- APPLY ---
+// Sets the options on a socket. All options are attempted. Returns false if any of them failed,
+// with the reason in result.
+bool NmqttSocketOptions::apply(Poco::Net::Socket &socket, std::string &result) const {
+	bool ok = true;
+	try {
+		if (noDelay) { socket.setOption(IPPROTO_TCP, TCP_NODELAY, 1); }
+	}
+	catch (Poco::Exception &e) {
+		result += "TCP_NODELAY: " + e.displayText() + ". ";
+		ok = false;
+	}
+	
+	try {
+		if (sendBufferSize > 0) { socket.setSendBufferSize(sendBufferSize); }
+		if (receiveBufferSize > 0) { socket.setReceiveBufferSize(receiveBufferSize); }
+	}
+	catch (Poco::Exception &e) {
+		result += "Buffer size: " + e.displayText() + ". ";
+		ok = false;
+	}
+
+#ifdef __linux__
+	try {
+		if (quickAck) { socket.setOption(IPPROTO_TCP, TCP_QUICKACK, 1); }
+	}
+	catch (Poco::Exception &e) {
+		result += "TCP_QUICKACK: " + e.displayText() + ". ";
+		ok = false;
+	}
+
+#ifdef SO_BUSY_POLL
+	try {
+		if (busyPoll > 0) { socket.setOption(SOL_SOCKET, SO_BUSY_POLL, busyPoll); }
+	}
+	catch (Poco::Exception &e) {
+		result += "SO_BUSY_POLL: " + e.displayText() + ". ";
+		ok = false;
+	}
+#endif
+
+#ifdef TCP_USER_TIMEOUT
+	try {
+		if (userTimeout > 0) { socket.setOption(IPPROTO_TCP, TCP_USER_TIMEOUT, (int) userTimeout); }
+	}
+	catch (Poco::Exception &e) {
+		result += "TCP_USER_TIMEOUT: " + e.displayText() + ". ";
+		ok = false;
+	}
+#endif
+#endif
+	
+	return ok;
+}
+
+
+// --- REARM QUICK ACK ---
+// Sets TCP_QUICKACK again, after the kernel may have cleared it. Errors are ignored.
+void NmqttSocketOptions::rearmQuickAck(Poco::Net::Socket &socket) {
+#ifdef __linux__
+	int one = 1;
+	setsockopt(socket.impl()->sockfd(), IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+#endif
+}
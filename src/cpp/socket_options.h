@@ -0,0 +1,49 @@
+/*
+	socket_options.h - Header for the NymphMQTT socket options structure.
+	
+	Revision 0
+	
+	Features:
+			- Tuning options for client connections and listening sockets.
+			- Latency and throughput profiles.
+	
+	Notes:
+			- The default options leave the system defaults in place.
+			- TCP_QUICKACK, SO_BUSY_POLL and TCP_USER_TIMEOUT are only available on Linux, and are
+				ignored elsewhere. Linux clears TCP_QUICKACK again by itself, so it is set again
+				after every receive on a connection which uses it.
+			- SO_BUSY_POLL above the system limit (net.core.busy_read) needs CAP_NET_ADMIN.
+			- Options set on a listening socket are inherited by the connections it accepts. They
+				are set on each accepted connection as well.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_SOCKET_OPTIONS_H
+#define NMQTT_SOCKET_OPTIONS_H
+
+
+#include <string>
+
+#include <Poco/Net/Socket.h>
+
+
+struct NmqttSocketOptions {
+	bool noDelay = false;				// TCP_NODELAY: disable Nagle's algorithm.
+	bool quickAck = false;				// TCP_QUICKACK: do not delay acknowledgements.
+	int sendBufferSize = 0;				// SO_SNDBUF in bytes. Zero for the system default.
+	int receiveBufferSize = 0;			// SO_RCVBUF in bytes. Zero for the system default.
+	int busyPoll = 0;					// SO_BUSY_POLL in microseconds. Zero to disable.
+	unsigned int userTimeout = 0;		// TCP_USER_TIMEOUT in milliseconds. Zero for the default.
+	int listenBacklog = 64;				// Backlog of a listening socket.
+	
+	static NmqttSocketOptions latency();
+	static NmqttSocketOptions throughput();
+	
+	bool apply(Poco::Net::Socket &socket, std::string &result) const;
+	static void rearmQuickAck(Poco::Net::Socket &socket);
+};
+
+
+#endif
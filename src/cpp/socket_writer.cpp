@@ -0,0 +1,219 @@
+/*
+	socket_writer.cpp - Implementation for the NymphMQTT socket writer class.
+	
+	Revision 0
+	
+	Features:
+			- Sends a message made up of multiple buffers without concatenating them first.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "socket_writer.h"
+
+#include <Poco/Net/SecureStreamSocket.h>
+#include <Poco/Timespan.h>
+#include <Poco/Exception.h>
+
+#include <string>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#endif
+
+
+// --- SEND BYTES ---
+// Sends a buffer with sendBytes(), continuing after partial sends. On a non-blocking socket it 
+// waits for the socket to become ready when it would block, which for a TLS socket may mean 
+// readable. Adds the number of bytes sent to sent. Returns false on timeout.
+bool NmqttSocketWriter::sendBytes(Poco::Net::StreamSocket &socket, const char* data, size_t len,
+									size_t &sent) {
+	Poco::Timespan timeout(0, sendTimeout * 1000);
+	while (len > 0) {
+		int ret;
+		try {
+			ret = socket.sendBytes(data, len);
+		}
+		catch (Poco::TimeoutException &e) {
+			// Would block, with POCO versions which report this as a timeout.
+			ret = 0;
+		}
+		
+		if (ret > 0) {
+			data += ret;
+			len -= ret;
+			sent += ret;
+			continue;
+		}
+		
+		int mode = Poco::Net::Socket::SELECT_WRITE;
+		if (socket.secure() && ret == Poco::Net::SecureStreamSocket::ERR_SSL_WANT_READ) {
+			mode = Poco::Net::Socket::SELECT_READ;
+		}
+		
+		if (!socket.poll(timeout, mode)) { return false; }
+	}
+	
+	return true;
+}
+
+
+// --- SEND SEQUENTIAL ---
+// Fallback for TLS sockets and Windows.
+bool NmqttSocketWriter::sendSequential(Poco::Net::StreamSocket &socket,
+										const std::string_view* parts, size_t count, size_t &sent) {
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i) { total += parts[i].length(); }
+	
+	if (count > 1 && total <= coalesceMax) {
+		static thread_local std::string localBuffer;
+		localBuffer.clear();
+		for (size_t i = 0; i < count; ++i) { localBuffer.append(parts[i].data(), parts[i].length()); }
+		
+		return sendBytes(socket, localBuffer.data(), localBuffer.length(), sent);
+	}
+	
+	for (size_t i = 0; i < count; ++i) {
+		if (!sendBytes(socket, parts[i].data(), parts[i].length(), sent)) { return false; }
+	}
+	
+	return true;
+}
+
+
+// --- SEND ---
+// Sends all parts. A send which fails after part of the data was written would leave the peer 
+// reading the next message from within this one, so the connection is shut down then. Its reader
+// sees it closed, and the connection is cleaned up as usual.
+bool NmqttSocketWriter::send(Poco::Net::StreamSocket &socket, const std::string_view* parts,
+								size_t count) {
+	size_t sent = 0;
+	bool ret;
+	try {
+		ret = sendAll(socket, parts, count, sent);
+	}
+	catch (Poco::Exception &e) {
+		if (sent > 0) { shutdown(socket); }
+		throw;
+	}
+	
+	if (!ret && sent > 0) { shutdown(socket); }
+	return ret;
+}
+
+
+// --- SHUTDOWN ---
+void NmqttSocketWriter::shutdown(Poco::Net::StreamSocket &socket) {
+	try {
+		socket.shutdown();
+	}
+	catch (Poco::Exception &e) { }
+}
+
+
+// --- SEND ALL ---
+// Adds the number of bytes sent to sent.
+bool NmqttSocketWriter::sendAll(Poco::Net::StreamSocket &socket, const std::string_view* parts,
+								size_t count, size_t &sent) {
+#ifdef _WIN32
+	return sendSequential(socket, parts, count, sent);
+#else
+	if (count > maxParts || socket.secure()) {
+		return sendSequential(socket, parts, count, sent);
+	}
+	
+	iovec iov[maxParts];
+	size_t used = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (parts[i].empty()) { continue; }
+		iov[used].iov_base = (void*) parts[i].data();
+		iov[used].iov_len = parts[i].length();
+		++used;
+	}
+	
+	poco_socket_t fd = socket.impl()->sockfd();
+	size_t start = 0;
+	while (start < used) {
+		msghdr msg = {};
+		msg.msg_iov = iov + start;
+		msg.msg_iovlen = used - start;
+
+#ifdef MSG_NOSIGNAL
+		ssize_t res = sendmsg(fd, &msg, MSG_NOSIGNAL);
+#else
+		ssize_t res = sendmsg(fd, &msg, 0);
+#endif
+		if (res < 0) {
+			if (errno == EINTR) { continue; }
+			if (errno != EAGAIN && errno != EWOULDBLOCK) { return false; }
+			
+			// Non-blocking socket with a full send buffer.
+			pollfd pfd = { fd, POLLOUT, 0 };
+			if (poll(&pfd, 1, sendTimeout) <= 0) { return false; }
+			continue;
+		}
+		
+		// Skip the fully sent buffers, and advance into a partially sent one.
+		sent += res;
+		size_t n = res;
+		while (start < used && n >= iov[start].iov_len) {
+			n -= iov[start].iov_len;
+			++start;
+		}
+		
+		if (start < used) {
+			iov[start].iov_base = (char*) iov[start].iov_base + n;
+			iov[start].iov_len -= n;
+		}
+	}
+	
+	return true;
+#endif
+}
+
+
+// --- SEND SOME ---
+int NmqttSocketWriter::sendSome(Poco::Net::StreamSocket &socket, const std::string_view* parts,
+								size_t count) {
+#ifndef _WIN32
+	if (!socket.secure()) {
+		iovec iov[maxParts];
+		size_t used = 0;
+		for (size_t i = 0; i < count && used < maxParts; ++i) {
+			if (parts[i].empty()) { continue; }
+			iov[used].iov_base = (void*) parts[i].data();
+			iov[used].iov_len = parts[i].length();
+			++used;
+		}
+		
+		if (used == 0) { return 0; }
+		
+		msghdr msg = {};
+		msg.msg_iov = iov;
+		msg.msg_iovlen = used;
+		while (true) {
+#ifdef MSG_NOSIGNAL
+			ssize_t sent = sendmsg(socket.impl()->sockfd(), &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+#else
+			ssize_t sent = sendmsg(socket.impl()->sockfd(), &msg, MSG_DONTWAIT);
+#endif
+			if (sent >= 0) { return sent; }
+			if (errno == EINTR) { continue; }
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+		}
+	}
+#endif
+	
+	size_t total = 0;
+	size_t sent = 0;
+	for (size_t i = 0; i < count; ++i) { total += parts[i].length(); }
+	return sendSequential(socket, parts, count, sent) ? total : -1;
+}
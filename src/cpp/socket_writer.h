@@ -0,0 +1,60 @@
+/*
+	socket_writer.h - Header for the NymphMQTT socket writer class.
+	
+	Revision 0
+	
+	Features:
+			- Sends a message made up of multiple buffers without concatenating them first.
+	
+	Notes:
+			- Plain sockets on POSIX systems use a single sendmsg() call for all buffers, which is
+				repeated for any remainder after a partial send.
+			- TLS sockets and Windows fall back to sendBytes(). Small messages are concatenated
+				into a thread-local buffer first, so that they are sent as a single TLS record.
+				With a non-blocking socket it waits for the socket whenever a send would block.
+			- A message of which only a part could be sent leaves the stream misaligned. send()
+				shuts the connection down in that case.
+			- sendSome() is used by the server reactors, to send queued data without blocking.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_SOCKET_WRITER_H
+#define NMQTT_SOCKET_WRITER_H
+
+
+#include <string_view>
+#include <cstddef>
+
+#include <Poco/Net/StreamSocket.h>
+
+
+class NmqttSocketWriter {
+	static const size_t maxParts = 16;
+	static const size_t coalesceMax = 16 * 1024;
+	static const int sendTimeout = 3000;		// Milliseconds to wait for a full send buffer.
+	
+	static bool sendBytes(Poco::Net::StreamSocket &socket, const char* data, size_t len,
+							size_t &sent);
+	static bool sendSequential(Poco::Net::StreamSocket &socket, const std::string_view* parts,
+								size_t count, size_t &sent);
+	static bool sendAll(Poco::Net::StreamSocket &socket, const std::string_view* parts,
+							size_t count, size_t &sent);
+	static void shutdown(Poco::Net::StreamSocket &socket);
+
+public:
+	// Sends all parts in order on a blocking or non-blocking socket. Returns false if not all
+	// data could be sent, after shutting the socket down if a part of it was. Can throw the same
+	// exceptions as StreamSocket::sendBytes().
+	static bool send(Poco::Net::StreamSocket &socket, const std::string_view* parts, size_t count);
+	
+	// Sends as much of the parts as the socket accepts without blocking, with a single system 
+	// call. Returns the number of bytes sent, or -1 on error. On TLS sockets and Windows all data
+	// is sent, blocking as needed.
+	static int sendSome(Poco::Net::StreamSocket &socket, const std::string_view* parts, 
+							size_t count);
+};
+
+
+#endif
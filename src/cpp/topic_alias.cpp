@@ -0,0 +1,100 @@
+/*
+	topic_alias.cpp - Implementation of the NymphMQTT topic alias tables.
+	
+	Revision 0
+	
+	Features:
+			- Per-connection MQTT 5 topic alias tables for outgoing and incoming PUBLISH messages.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "topic_alias.h"
+
+
+// --- SET MAXIMUM ---
+// Sets the Topic Alias Maximum advertised by the remote side. This clears any existing aliases,
+// as happens on a new connection.
+void NmqttOutboundAliases::setMaximum(uint16_t max) {
+	aliases.clear();
+	maximum = max;
+}
+
+
+// --- APPLY ---
+// Adds a Topic Alias property to the PUBLISH message. If the topic already has an alias, the
+// topic is removed from the message. Returns true if an alias was used.
+// The table should be locked until the message has been sent.
+bool NmqttOutboundAliases::apply(NmqttMessage &msg) {
+	if (msg.getProtocolVersion() != MQTT_PROTOCOL_VERSION_5) { return false; }
+	
+	std::string_view topic = msg.getTopicView();
+	bool known;
+	uint16_t alias = assign(topic, known);
+	if (alias == 0) { return false; }
+	
+	msg.setProperty(MQTT_PROP_TOPIC_ALIAS, alias);
+	if (known) { msg.setTopic(std::string()); }
+	return true;
+}
+
+
+// --- ASSIGN ---
+// Returns the alias to send an MQTT 5 PUBLISH message for the topic with, or 0 if it is to be sent
+// without one. Known is set if the remote side already has the alias, so that the topic can be
+// left out. A new alias is sent along with the topic once, to establish the mapping.
+// The table should be locked until the message has been sent.
+uint16_t NmqttOutboundAliases::assign(std::string_view topic, bool &known) {
+	known = false;
+	if (maximum == 0 || topic.empty()) { return 0; }
+	
+	std::unordered_map<std::string, uint16_t>::iterator it = aliases.find(std::string(topic));
+	if (it != aliases.end()) {
+		known = true;
+		return it->second;
+	}
+	
+	if (aliases.size() >= maximum) { return 0; }
+	
+	uint16_t alias = aliases.size() + 1;
+	aliases.insert(std::pair<std::string, uint16_t>(std::string(topic), alias));
+	return alias;
+}
+
+
+// --- SET MAXIMUM ---
+// Sets the Topic Alias Maximum which we advertised to the remote side. Clears existing aliases.
+void NmqttInboundAliases::setMaximum(uint16_t max) {
+	topics.clear();
+	topics.resize(max);
+}
+
+
+// --- RESOLVE ---
+// Processes the Topic Alias property of a received PUBLISH message, if any. A message with a topic
+// updates the mapping for the alias, a message without a topic gets the topic of the alias set.
+// Returns false on a protocol error: an invalid alias, or an unknown alias without a topic.
+bool NmqttInboundAliases::resolve(NmqttMessage &msg) {
+	uint32_t alias;
+	if (!msg.getProperty(MQTT_PROP_TOPIC_ALIAS, alias)) {
+		// No alias, so a topic is required.
+		return !msg.getTopicView().empty();
+	}
+	
+	if (alias == 0 || alias > topics.size()) { return false; }
+	
+	std::string_view topic = msg.getTopicView();
+	if (!topic.empty()) {
+		topics[alias - 1].assign(topic.data(), topic.length());
+		return true;
+	}
+	
+	if (topics[alias - 1].empty()) { return false; }
+	
+	msg.setTopic(topics[alias - 1]);
+	return true;
+}
@@ -0,0 +1,60 @@
+/*
+	topic_alias.h - Header for the NymphMQTT topic alias tables.
+	
+	Revision 0
+	
+	Features:
+			- Per-connection MQTT 5 topic alias tables for outgoing and incoming PUBLISH messages.
+	
+	Notes:
+			- Outbound aliases are assigned on first use of a topic, until the maximum advertised by
+				the receiver is reached. Topics published after that are sent in full.
+			- Assigning an alias and sending the message has to happen in the same order on both
+				ends, so the outbound table is locked by the caller for the duration of both.
+			- The inbound table is only used by the connection's reading thread and is not locked.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_TOPIC_ALIAS_H
+#define NMQTT_TOPIC_ALIAS_H
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include <Poco/Mutex.h>
+
+#include "message.h"
+
+
+class NmqttOutboundAliases {
+	std::unordered_map<std::string, uint16_t> aliases;
+	uint16_t maximum = 0;
+	Poco::Mutex mutex;
+	
+public:
+	void lock() { mutex.lock(); }
+	void unlock() { mutex.unlock(); }
+	
+	void setMaximum(uint16_t max);
+	bool apply(NmqttMessage &msg);
+	uint16_t assign(std::string_view topic, bool &known);
+};
+
+
+class NmqttInboundAliases {
+	std::vector<std::string> topics;	// Indexed by alias - 1.
+	
+public:
+	void setMaximum(uint16_t max);
+	uint16_t getMaximum() { return topics.size(); }
+	bool resolve(NmqttMessage &msg);
+};
+
+
+#endif
@@ -0,0 +1,517 @@
+/*
+	topic_tree.cpp - Implementation of the NymphMQTT topic tree.
+	
+	Revision 0
+	
+	Features:
+			- Subscription index of the broker: a trie with a node per topic level.
+	
+	Notes:
+			- A new node is linked into the tree straight away, with empty tables. Lookups may
+				reach it before its tables are published, which is the same as not reaching it.
+			- Unused nodes are removed when the batch is committed, after all of its changes have
+				been applied, so that a node which is unsubscribed and subscribed again within one
+				batch remains.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "topic_tree.h"
+#include "epoch.h"
+#include "match_cache.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+
+// Splits a topic or topic filter into its levels.
+static void splitLevels(std::string_view topic, std::vector<std::string_view> &out) {
+	out.clear();
+	size_t start = 0;
+	for (;;) {
+		size_t end = topic.find('/', start);
+		if (end == std::string_view::npos) {
+			out.push_back(topic.substr(start));
+			return;
+		}
+		
+		out.push_back(topic.substr(start, end - start));
+		start = end + 1;
+	}
+}
+
+
+// Appends a published subscriber list.
+static void appendSubscribers(std::vector<NmqttSubscriber> &out, const NmqttSubscriberList* list) {
+	if (list) { out.insert(out.end(), list->begin(), list->end()); }
+}
+
+
+// --- CONSTRUCTOR ---
+NmqttTopicTree::NmqttTopicTree() {
+	cache = new NmqttMatchCache;
+}
+
+
+// --- DECONSTRUCTOR ---
+// No lookups or changes may be in progress.
+NmqttTopicTree::~NmqttTopicTree() {
+	delete cache;
+	destroy(&root);
+	for (std::pair<const std::string_view, Level*> &level : levels) { delete level.second; }
+}
+
+
+// --- DESTROY ---
+// Deletes the nodes below the provided node.
+void NmqttTopicTree::destroy(NmqttTopicNode* node) {
+	if (const NmqttTopicChildren* children = node->children.load()) {
+		for (const std::pair<const std::string_view, NmqttTopicNode*> &child : *children) {
+			destroy(child.second);
+			delete child.second;
+		}
+	}
+	
+	NmqttTopicNode* wild[2] = { node->plus.load(), node->hash.load() };
+	for (NmqttTopicNode* w : wild) {
+		if (!w) { continue; }
+		destroy(w);
+		delete w;
+	}
+}
+
+
+// --- INTERN ---
+// Returns the interned copy of a level string, adding a reference to it.
+std::string_view NmqttTopicTree::intern(std::string_view name) {
+	std::unordered_map<std::string_view, Level*>::iterator it = levels.find(name);
+	if (it != levels.end()) {
+		it->second->refs++;
+		return it->second->name;
+	}
+	
+	Level* level = new Level;
+	level->name.assign(name.data(), name.length());
+	level->refs = 1;
+	levels.insert(std::pair<std::string_view, Level*>(level->name, level));
+	return level->name;
+}
+
+
+// --- RELEASE ---
+// Removes a reference to an interned level string. With the last reference it is retired, as
+// published tables may still use it as key.
+void NmqttTopicTree::release(std::string_view name) {
+	std::unordered_map<std::string_view, Level*>::iterator it = levels.find(name);
+	if (it == levels.end() || --it->second->refs > 0) { return; }
+	
+	Level* level = it->second;
+	levels.erase(it);
+	NmqttEpoch::retire(level);
+}
+
+
+// --- READ CHILDREN ---
+// Returns the children table of a node as changed by the batch so far, or null if it is empty.
+const NmqttTopicChildren* NmqttTopicTree::readChildren(Batch &batch, NmqttTopicNode* node) {
+	std::unordered_map<NmqttTopicNode*, NmqttTopicChildren*>::iterator it;
+	it = batch.children.find(node);
+	if (it != batch.children.end()) { return it->second; }
+	
+	return node->children.load(std::memory_order_relaxed);
+}
+
+
+// --- EDIT CHILDREN ---
+// Returns the copy of the children table of a node which the batch changes.
+NmqttTopicChildren* NmqttTopicTree::editChildren(Batch &batch, NmqttTopicNode* node) {
+	NmqttTopicChildren* &copy = batch.children[node];
+	if (!copy) {
+		const NmqttTopicChildren* published = node->children.load(std::memory_order_relaxed);
+		copy = published ? new NmqttTopicChildren(*published) : new NmqttTopicChildren;
+	}
+	
+	return copy;
+}
+
+
+// --- READ SUBSCRIBERS ---
+const NmqttSubscriberList* NmqttTopicTree::readSubscribers(Batch &batch, NmqttTopicNode* node) {
+	std::unordered_map<NmqttTopicNode*, NmqttSubscriberList*>::iterator it;
+	it = batch.subscribers.find(node);
+	if (it != batch.subscribers.end()) { return it->second; }
+	
+	return node->subscribers.load(std::memory_order_relaxed);
+}
+
+
+// --- EDIT SUBSCRIBERS ---
+NmqttSubscriberList* NmqttTopicTree::editSubscribers(Batch &batch, NmqttTopicNode* node) {
+	NmqttSubscriberList* &copy = batch.subscribers[node];
+	if (!copy) {
+		const NmqttSubscriberList* published = node->subscribers.load(std::memory_order_relaxed);
+		copy = published ? new NmqttSubscriberList(*published) : new NmqttSubscriberList;
+	}
+	
+	return copy;
+}
+
+
+// --- UNUSED ---
+// Returns true if a node has no children and no subscribers after the batch.
+bool NmqttTopicTree::unused(Batch &batch, NmqttTopicNode* node) {
+	const NmqttTopicChildren* children = readChildren(batch, node);
+	const NmqttSubscriberList* subs = readSubscribers(batch, node);
+	return (!children || children->empty()) && (!subs || subs->empty())
+			&& !node->plus.load(std::memory_order_relaxed)
+			&& !node->hash.load(std::memory_order_relaxed);
+}
+
+
+// --- FILTER OF ---
+// Returns the topic filter of a node.
+std::string NmqttTopicTree::filterOf(const NmqttTopicNode* node) {
+	std::string filter;
+	for (; node != &root; node = node->parent) {
+		filter.insert(0, node->name.data(), node->name.length());
+		if (node->parent != &root) { filter.insert(0, 1, '/'); }
+	}
+	
+	return filter;
+}
+
+
+// --- SET CACHE SIZE ---
+// Sets the maximum number of topics for which lookup results are cached. Zero disables the cache.
+void NmqttTopicTree::setCacheSize(size_t topics) {
+	cache->setCapacity(topics);
+}
+
+
+// --- GET CACHE STATS ---
+NmqttMatchCacheStats NmqttTopicTree::getCacheStats() {
+	return cache->getStats();
+}
+
+
+// --- FIND ---
+// Returns the node of a topic filter, or null if it does not exist.
+NmqttTopicNode* NmqttTopicTree::find(Batch &batch, std::string_view filter) {
+	std::vector<std::string_view> filterLevels;
+	splitLevels(filter, filterLevels);
+	
+	NmqttTopicNode* node = &root;
+	for (std::string_view name : filterLevels) {
+		if (name == "+") { node = node->plus.load(std::memory_order_relaxed); }
+		else if (name == "#") { node = node->hash.load(std::memory_order_relaxed); }
+		else {
+			const NmqttTopicChildren* children = readChildren(batch, node);
+			if (!children) { return 0; }
+			NmqttTopicChildren::const_iterator it = children->find(name);
+			node = (it == children->end()) ? 0 : it->second;
+		}
+		
+		if (!node) { return 0; }
+	}
+	
+	return node;
+}
+
+
+// --- SUBSCRIBE ---
+// Adds a subscription of a client for a validated topic filter, with the granted QoS. An existing
+// subscription of the client for the same filter is replaced. Returns true if the subscription is
+// new. Returns once the subscription is used by lookups.
+bool NmqttTopicTree::subscribe(uint64_t handle, std::string_view filter, uint8_t qos) {
+	Change change;
+	change.type = NMQTT_CHANGE_SUBSCRIBE;
+	change.handle = handle;
+	change.filter = filter;
+	change.qos = qos;
+	return submit(change);
+}
+
+
+// --- UNSUBSCRIBE ---
+// Removes the subscription of a client for a topic filter. Returns false if it did not exist.
+bool NmqttTopicTree::unsubscribe(uint64_t handle, std::string_view filter) {
+	Change change;
+	change.type = NMQTT_CHANGE_UNSUBSCRIBE;
+	change.handle = handle;
+	change.filter = filter;
+	return submit(change);
+}
+
+
+// --- REMOVE SESSION ---
+// Removes all subscriptions of a client. This has to be done before its handle is reused.
+void NmqttTopicTree::removeSession(uint64_t handle) {
+	Change change;
+	change.type = NMQTT_CHANGE_REMOVE_SESSION;
+	change.handle = handle;
+	submit(change);
+}
+
+
+// --- SUBMIT ---
+// Queues a change and waits until it has been applied. The thread which gets to apply changes
+// next applies all changes queued by then, including those of the threads waiting behind it.
+bool NmqttTopicTree::submit(Change &change) {
+	pendingMutex.lock();
+	pending.push_back(&change);
+	pendingMutex.unlock();
+	
+	Poco::Mutex::ScopedLock lock(writerMutex);
+	if (!change.done) {
+		std::vector<Change*> changes;
+		pendingMutex.lock();
+		changes.swap(pending);
+		pendingMutex.unlock();
+		
+		apply(changes);
+	}
+	
+	return change.result;
+}
+
+
+// --- APPLY ---
+// Applies a batch of changes and publishes the result.
+void NmqttTopicTree::apply(std::vector<Change*> &changes) {
+	Batch batch;
+	for (Change* change : changes) {
+		if (change->type == NMQTT_CHANGE_SUBSCRIBE) {
+			change->result = addSubscription(batch, change->handle, change->filter, change->qos);
+		}
+		else if (change->type == NMQTT_CHANGE_UNSUBSCRIBE) {
+			change->result = removeSubscription(batch, change->handle, change->filter);
+		}
+		else {
+			removeSubscriptions(batch, change->handle);
+		}
+	}
+	
+	commit(batch);
+	if (!batch.filters.empty()) { cache->invalidate(batch.filters); }
+	
+	// Waiting threads only read their result after the writer lock has been released.
+	for (Change* change : changes) { change->done = true; }
+	
+	NmqttEpoch::reclaim();
+}
+
+
+// --- ADD SUBSCRIPTION ---
+bool NmqttTopicTree::addSubscription(Batch &batch, uint64_t handle, std::string_view filter,
+																		uint8_t qos) {
+	std::vector<std::string_view> filterLevels;
+	splitLevels(filter, filterLevels);
+	
+	NmqttTopicNode* node = &root;
+	for (std::string_view name : filterLevels) {
+		std::atomic<NmqttTopicNode*>* wild = 0;
+		if (name == "+") { wild = &node->plus; }
+		else if (name == "#") { wild = &node->hash; }
+		
+		
+		NmqttTopicNode* child = 0;
+		if (wild) { child = wild->load(std::memory_order_relaxed); }
+		else if (const NmqttTopicChildren* children = readChildren(batch, node)) {
+			NmqttTopicChildren::const_iterator it = children->find(name);
+			if (it != children->end()) { child = it->second; }
+		}
+		
+		if (!child) {
+			child = new NmqttTopicNode;
+			child->parent = node;
+			if (wild) {
+				child->name = (name == "+") ? "+" : "#";
+				wild->store(child, std::memory_order_release);
+			}
+			else {
+				child->name = intern(name);
+				editChildren(batch, node)->insert(NmqttTopicChildren::value_type(child->name, child));
+			}
+		}
+		
+		node = child;
+	}
+	
+	NmqttSubscriberList* subs = editSubscribers(batch, node);
+	batch.filters.push_back(std::string(filter));
+	for (NmqttSubscriber &sub : *subs) {
+		if (sub.handle == handle) {
+			sub.qos = qos;
+			return false;
+		}
+	}
+	
+	NmqttSubscriber sub;
+	sub.handle = handle;
+	sub.qos = qos;
+	subs->push_back(sub);
+	sessions[handle].push_back(node);
+	subscriptions.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+
+// --- REMOVE SUBSCRIPTION ---
+bool NmqttTopicTree::removeSubscription(Batch &batch, uint64_t handle, std::string_view filter) {
+	NmqttTopicNode* node = find(batch, filter);
+	if (!node) { return false; }
+	
+	std::unordered_map<uint64_t, std::vector<NmqttTopicNode*> >::iterator it;
+	it = sessions.find(handle);
+	if (it == sessions.end()) { return false; }
+	
+	std::vector<NmqttTopicNode*> &nodes = it->second;
+	std::vector<NmqttTopicNode*>::iterator n = std::find(nodes.begin(), nodes.end(), node);
+	if (n == nodes.end()) { return false; }
+	
+	nodes.erase(n);
+	if (nodes.empty()) { sessions.erase(it); }
+	removeSubscriber(batch, node, handle);
+	batch.filters.push_back(std::string(filter));
+	return true;
+}
+
+
+// --- REMOVE SUBSCRIPTIONS ---
+// Removes all subscriptions of a client.
+void NmqttTopicTree::removeSubscriptions(Batch &batch, uint64_t handle) {
+	std::unordered_map<uint64_t, std::vector<NmqttTopicNode*> >::iterator it;
+	it = sessions.find(handle);
+	if (it == sessions.end()) { return; }
+	
+	for (NmqttTopicNode* node : it->second) {
+		removeSubscriber(batch, node, handle);
+		batch.filters.push_back(filterOf(node));
+	}
+	
+	sessions.erase(it);
+}
+
+
+// --- REMOVE SUBSCRIBER ---
+void NmqttTopicTree::removeSubscriber(Batch &batch, NmqttTopicNode* node, uint64_t handle) {
+	NmqttSubscriberList* subs = editSubscribers(batch, node);
+	for (size_t i = 0; i < subs->size(); ++i) {
+		if ((*subs)[i].handle != handle) { continue; }
+		
+		(*subs)[i] = subs->back();
+		subs->pop_back();
+		subscriptions.fetch_sub(1, std::memory_order_relaxed);
+		break;
+	}
+	
+	batch.removals.push_back(node);
+}
+
+
+// --- COMMIT ---
+// Unlinks the nodes which are no longer used, and publishes the changed tables. Replaced tables
+// and unlinked nodes are retired.
+void NmqttTopicTree::commit(Batch &batch) {
+	std::unordered_set<NmqttTopicNode*> removed;
+	for (NmqttTopicNode* node : batch.removals) {
+		while (node != &root && removed.count(node) == 0 && unused(batch, node)) {
+			NmqttTopicNode* parent = node->parent;
+			if (parent->plus.load(std::memory_order_relaxed) == node) {
+				parent->plus.store(0, std::memory_order_release);
+			}
+			else if (parent->hash.load(std::memory_order_relaxed) == node) {
+				parent->hash.store(0, std::memory_order_release);
+			}
+			else {
+				editChildren(batch, parent)->erase(node->name);
+				release(node->name);
+			}
+			
+			removed.insert(node);
+			node = parent;
+		}
+	}
+	
+	std::unordered_map<NmqttTopicNode*, NmqttTopicChildren*>::iterator c;
+	for (c = batch.children.begin(); c != batch.children.end(); ++c) {
+		if (removed.count(c->first)) { delete c->second; }
+		else { NmqttEpoch::retire(c->first->children.exchange(c->second)); }
+	}
+	
+	std::unordered_map<NmqttTopicNode*, NmqttSubscriberList*>::iterator s;
+	for (s = batch.subscribers.begin(); s != batch.subscribers.end(); ++s) {
+		if (removed.count(s->first)) { delete s->second; }
+		else { NmqttEpoch::retire(s->first->subscribers.exchange(s->second)); }
+	}
+	
+	for (NmqttTopicNode* node : removed) { NmqttEpoch::retire(node); }
+}
+
+
+// --- COLLECT ---
+// Adds the subscribers of the nodes below the provided node which match the topic from level i.
+void NmqttTopicTree::collect(const NmqttTopicNode* node, const std::vector<std::string_view> &topic,
+								size_t i, std::vector<NmqttSubscriber> &out) {
+	// Topics starting with '$' are not matched by wildcards at the first level.
+	bool wildcards = !(node == &root && !topic[0].empty() && topic[0][0] == '$');
+	
+	// '#' also matches the parent level, so it applies whether or not levels remain.
+	const NmqttTopicNode* hash = node->hash.load(std::memory_order_acquire);
+	if (wildcards && hash) {
+		appendSubscribers(out, hash->subscribers.load(std::memory_order_acquire));
+	}
+	
+	if (i == topic.size()) {
+		appendSubscribers(out, node->subscribers.load(std::memory_order_acquire));
+		return;
+	}
+	
+	const NmqttTopicNode* plus = node->plus.load(std::memory_order_acquire);
+	if (wildcards && plus) { collect(plus, topic, i + 1, out); }
+	
+	const NmqttTopicChildren* children = node->children.load(std::memory_order_acquire);
+	if (!children) { return; }
+	
+	NmqttTopicChildren::const_iterator it = children->find(topic[i]);
+	if (it != children->end()) { collect(it->second, topic, i + 1, out); }
+}
+
+
+// --- MATCH ---
+// Finds the subscribers for a published topic. Each client is returned once, with the highest QoS
+// of its matching subscriptions, ordered by handle. This does not lock the tree, and may run 
+// concurrently with changes. Cached results are used where available.
+void NmqttTopicTree::match(std::string_view topic, std::vector<NmqttSubscriber> &out) {
+	out.clear();
+	if (cache->lookup(topic, out)) { return; }
+	
+	static thread_local std::vector<std::string_view> topicLevels;
+	splitLevels(topic, topicLevels);
+	uint64_t generation = cache->getGeneration();
+	{
+		NmqttEpoch::Guard guard;
+		collect(&root, topicLevels, 0, out);
+	}
+	
+	if (out.size() > 1) {
+		std::sort(out.begin(), out.end(), [](const NmqttSubscriber &a, const NmqttSubscriber &b) {
+			return a.handle < b.handle;
+		});
+		
+		size_t n = 0;
+		for (size_t i = 1; i < out.size(); ++i) {
+			if (out[i].handle == out[n].handle) {
+				out[n].qos = std::max(out[n].qos, out[i].qos);
+			}
+			else {
+				out[++n] = out[i];
+			}
+		}
+		
+		out.resize(n + 1);
+	}
+	
+	cache->insert(topic, out, generation);
+}
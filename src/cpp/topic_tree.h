@@ -0,0 +1,157 @@
+/*
+	topic_tree.h - Header for the NymphMQTT topic tree.
+	
+	Revision 0
+	
+	Features:
+			- Subscription index of the broker: a trie with a node per topic level.
+			- Finds the subscribers for a topic in time proportional to the number of levels of
+				the topic, instead of the number of subscriptions.
+			- Lookups take no locks, and are not blocked by changes to the subscriptions.
+	
+	Notes:
+			- Literal levels are interned, so that each distinct level string is stored once. The
+				children of a node are keyed by views of the interned strings.
+			- The '+' and '#' wildcards are separate children of a node.
+			- Wildcards at the first level do not match topics starting with '$' (MQTT-4.7.2-1).
+			- A client with overlapping subscriptions is returned once, with the highest QoS.
+			- Lookup results are cached per topic by NmqttMatchCache. Each batch of changes
+				invalidates the cached topics which match its filters.
+			- The children table and subscriber list of a node are immutable once published.
+				Changes are made to copies, which replace them, while lookups continue on the
+				published versions. Replaced tables, nodes and levels are deleted through
+				NmqttEpoch once no lookup can be using them.
+			- Changes are applied by one thread at a time. Changes which are submitted while
+				another thread applies its own are applied together in the next batch, so that a
+				table is copied once per batch instead of once per change. A lookup sees each
+				subscription as it was either before or after the batch, but may see some
+				subscriptions of a batch changed before others.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_TOPIC_TREE_H
+#define NMQTT_TOPIC_TREE_H
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include <Poco/Mutex.h>
+
+
+// A subscriber and the QoS it was granted.
+struct NmqttSubscriber {
+	uint64_t handle;
+	uint8_t qos;
+};
+
+
+struct NmqttTopicNode;
+class NmqttMatchCache;
+struct NmqttMatchCacheStats;
+typedef std::unordered_map<std::string_view, NmqttTopicNode*> NmqttTopicChildren;
+typedef std::vector<NmqttSubscriber> NmqttSubscriberList;
+
+
+struct NmqttTopicNode {
+	NmqttTopicNode* parent = 0;
+	std::string_view name;									// Level, interned for a literal node.
+	std::atomic<const NmqttTopicChildren*> children { 0 };	// Literal children, or null.
+	std::atomic<NmqttTopicNode*> plus { 0 };				// '+' child.
+	std::atomic<NmqttTopicNode*> hash { 0 };				// '#' child.
+	std::atomic<const NmqttSubscriberList*> subscribers { 0 };	// Subscriptions ending here.
+	
+	~NmqttTopicNode() {
+		delete children.load();
+		delete subscribers.load();
+	}
+};
+
+
+class NmqttTopicTree {
+	struct Level {
+		std::string name;
+		uint32_t refs = 0;
+	};
+	
+	enum ChangeType {
+		NMQTT_CHANGE_SUBSCRIBE,
+		NMQTT_CHANGE_UNSUBSCRIBE,
+		NMQTT_CHANGE_REMOVE_SESSION
+	};
+	
+	// A change submitted by a thread, which waits until it has been applied.
+	struct Change {
+		ChangeType type;
+		uint64_t handle;
+		std::string_view filter;
+		uint8_t qos = 0;
+		bool result = false;
+		bool done = false;
+	};
+	
+	// The tables of the nodes changed by a batch, before they are published.
+	struct Batch {
+		std::unordered_map<NmqttTopicNode*, NmqttTopicChildren*> children;
+		std::unordered_map<NmqttTopicNode*, NmqttSubscriberList*> subscribers;
+		std::vector<NmqttTopicNode*> removals;		// Nodes which lost a subscriber.
+		std::vector<std::string> filters;			// Filters of the changed subscriptions.
+	};
+	
+	NmqttTopicNode root;
+	std::atomic<uint32_t> subscriptions { 0 };
+	NmqttMatchCache* cache;
+	
+	// Only used by the thread which applies changes.
+	std::unordered_map<std::string_view, Level*> levels;
+	std::unordered_map<uint64_t, std::vector<NmqttTopicNode*> > sessions;
+	
+	std::vector<Change*> pending;
+	Poco::Mutex pendingMutex;
+	Poco::Mutex writerMutex;
+	
+	bool submit(Change &change);
+	void apply(std::vector<Change*> &changes);
+	void commit(Batch &batch);
+	
+	std::string_view intern(std::string_view name);
+	void release(std::string_view name);
+	const NmqttTopicChildren* readChildren(Batch &batch, NmqttTopicNode* node);
+	NmqttTopicChildren* editChildren(Batch &batch, NmqttTopicNode* node);
+	const NmqttSubscriberList* readSubscribers(Batch &batch, NmqttTopicNode* node);
+	NmqttSubscriberList* editSubscribers(Batch &batch, NmqttTopicNode* node);
+	bool unused(Batch &batch, NmqttTopicNode* node);
+	std::string filterOf(const NmqttTopicNode* node);
+	NmqttTopicNode* find(Batch &batch, std::string_view filter);
+	bool addSubscription(Batch &batch, uint64_t handle, std::string_view filter, uint8_t qos);
+	bool removeSubscription(Batch &batch, uint64_t handle, std::string_view filter);
+	void removeSubscriptions(Batch &batch, uint64_t handle);
+	void removeSubscriber(Batch &batch, NmqttTopicNode* node, uint64_t handle);
+	void collect(const NmqttTopicNode* node, const std::vector<std::string_view> &topic, size_t i,
+					std::vector<NmqttSubscriber> &out);
+	void destroy(NmqttTopicNode* node);
+
+public:
+	NmqttTopicTree();
+	~NmqttTopicTree();
+	NmqttTopicTree(const NmqttTopicTree &other) = delete;
+	NmqttTopicTree& operator=(const NmqttTopicTree &other) = delete;
+	
+	bool subscribe(uint64_t handle, std::string_view filter, uint8_t qos);
+	bool unsubscribe(uint64_t handle, std::string_view filter);
+	void removeSession(uint64_t handle);
+	void match(std::string_view topic, std::vector<NmqttSubscriber> &out);
+	uint32_t count() { return subscriptions.load(std::memory_order_relaxed); }
+	void setCacheSize(size_t topics);
+	NmqttMatchCacheStats getCacheStats();
+};
+
+
+#endif
@@ -0,0 +1,235 @@
+/*
+	uring.cpp - Implementation of the NymphMQTT io_uring class.
+	
+	Revision 0
+	
+	Features:
+			- Minimal wrapper around a Linux io_uring instance: submission and completion queues
+				and a ring of provided receive buffers.
+			
+	Notes:
+			- 
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "uring.h"
+
+
+#ifdef NMQTT_IO_URING
+
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+
+// --- DECONSTRUCTOR ---
+// Closing the ring cancels all outstanding requests.
+NmqttUring::~NmqttUring() {
+	if (fd >= 0) { close(fd); }
+	if (sqes) { munmap(sqes, sqesSize); }
+	if (cqRing && cqRing != sqRing) { munmap(cqRing, cqRingSize); }
+	if (sqRing) { munmap(sqRing, sqRingSize); }
+	if (bufRing) { munmap(bufRing, bufRingSize); }
+	free(bufBase);
+}
+
+
+// --- SUPPORTED ---
+// Returns true if the running kernel supports the features used by the io_uring backend (6.0+)
+// and io_uring has not been disabled.
+bool NmqttUring::supported() {
+	utsname name;
+	int major = 0, minor = 0;
+	if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2) { return false; }
+	if (major < 6) { return false; }
+	
+	NmqttUring ring;
+	return ring.init(4);
+}
+
+
+// --- INIT ---
+// Creates the ring with at least the given number of submission queue entries. The completion 
+// queue is made four times larger, as multishot requests produce many completions each.
+bool NmqttUring::init(unsigned entries) {
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP | IORING_SETUP_SUBMIT_ALL | 
+				IORING_SETUP_COOP_TASKRUN;
+	p.cq_entries = entries * 4;
+	fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (fd < 0) { return false; }
+	
+	sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cqRingSize > sqRingSize) { sqRingSize = cqRingSize; }
+		cqRingSize = sqRingSize;
+	}
+	
+	sqRing = mmap(0, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 
+					IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED) {
+		sqRing = 0;
+		return false;
+	}
+	
+	if (p.features & IORING_FEAT_SINGLE_MMAP) { cqRing = sqRing; }
+	else {
+		cqRing = mmap(0, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 
+						IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED) {
+			cqRing = 0;
+			return false;
+		}
+	}
+	
+	sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+	void* ptr = mmap(0, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 
+					IORING_OFF_SQES);
+	if (ptr == MAP_FAILED) { return false; }
+	sqes = (io_uring_sqe*) ptr;
+	
+	char* sq = (char*) sqRing;
+	sqHead = (unsigned*) (sq + p.sq_off.head);
+	sqTail = (unsigned*) (sq + p.sq_off.tail);
+	sqMask = *(unsigned*) (sq + p.sq_off.ring_mask);
+	sqEntries = p.sq_entries;
+	sqLocalTail = *sqTail;
+	
+	// Submission queue entries are always used in order, so the index array is set up once.
+	unsigned* array = (unsigned*) (sq + p.sq_off.array);
+	for (unsigned i = 0; i < sqEntries; ++i) { array[i] = i; }
+	
+	char* cq = (char*) cqRing;
+	cqHead = (unsigned*) (cq + p.cq_off.head);
+	cqTail = (unsigned*) (cq + p.cq_off.tail);
+	cqMask = *(unsigned*) (cq + p.cq_off.ring_mask);
+	cqes = (io_uring_cqe*) (cq + p.cq_off.cqes);
+	
+	return true;
+}
+
+
+// --- SETUP BUFFERS ---
+// Registers a ring of buffers which the kernel picks from for receives using the buffer group.
+// The count has to be a power of two.
+bool NmqttUring::setupBuffers(uint16_t group, unsigned count, unsigned size) {
+	bufRingSize = count * sizeof(io_uring_buf);
+	void* ptr = mmap(0, bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) { return false; }
+	bufRing = (io_uring_buf_ring*) ptr;
+	
+	io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t) (uintptr_t) bufRing;
+	reg.ring_entries = count;
+	reg.bgid = group;
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		return false;
+	}
+	
+	bufCount = count;
+	bufSize = size;
+	bufBase = (char*) malloc((size_t) count * size);
+	if (!bufBase) { return false; }
+	
+	for (unsigned i = 0; i < count; ++i) { returnBuffer(i); }
+	
+	return true;
+}
+
+
+// --- RETURN BUFFER ---
+// Makes a buffer available to the kernel again, after the data received in it has been used.
+void NmqttUring::returnBuffer(uint16_t bid) {
+	// The bufs member of io_uring_buf_ring is misplaced when the kernel header is compiled as C++,
+	// so the entries are addressed directly.
+	io_uring_buf* buf = (io_uring_buf*) bufRing + (bufTail & (bufCount - 1));
+	buf->addr = (uint64_t) (uintptr_t) buffer(bid);
+	buf->len = bufSize;
+	buf->bid = bid;
+	++bufTail;
+	__atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+}
+
+
+// --- GET SQE ---
+// Returns a cleared submission queue entry. If the queue is full, it is submitted first. 
+// Returns null if no entry is available.
+io_uring_sqe* NmqttUring::getSqe() {
+	if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+		submit(0);
+		if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) { return 0; }
+	}
+	
+	io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	++sqLocalTail;
+	++toSubmit;
+	return sqe;
+}
+
+
+// --- SUBMIT ---
+// Submits all queued entries in a single system call, and waits for the given number of 
+// completions, for up to the timeout in milliseconds (-1 for no timeout). Returns the number of 
+// submitted entries, or a negative error code.
+int NmqttUring::submit(unsigned waitNr, int timeout) {
+	__atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+	if (toSubmit == 0 && waitNr == 0) { return 0; }
+	
+	int ret;
+	if (waitNr && timeout >= 0) {
+		__kernel_timespec ts;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (long long) (timeout % 1000) * 1000000;
+		io_uring_getevents_arg arg = {};
+		arg.ts = (uint64_t) (uintptr_t) &ts;
+		ret = syscall(__NR_io_uring_enter, fd, toSubmit, waitNr, 
+						IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+	}
+	else {
+		ret = syscall(__NR_io_uring_enter, fd, toSubmit, waitNr, 
+						waitNr ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+	}
+	
+	if (ret < 0) { return (errno == EINTR || errno == ETIME) ? 0 : -errno; }
+	
+	toSubmit -= ret;
+	return ret;
+}
+
+
+// --- READY ---
+// Returns true if completions are waiting.
+bool NmqttUring::ready() {
+	return *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+}
+
+
+// --- PEEK ---
+// Returns the next completion, or null if there is none. It has to be marked with seen() after use.
+io_uring_cqe* NmqttUring::peek() {
+	unsigned head = *cqHead;
+	if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) { return 0; }
+	return &cqes[head & cqMask];
+}
+
+
+// --- SEEN ---
+void NmqttUring::seen() {
+	__atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+}
+
+
+#endif
@@ -0,0 +1,85 @@
+/*
+	uring.h - Header for the NymphMQTT io_uring class.
+	
+	Revision 0
+	
+	Features:
+			- Minimal wrapper around a Linux io_uring instance: submission and completion queues
+				and a ring of provided receive buffers.
+			
+	Notes:
+			- Uses the kernel interface directly, so that no additional library is needed. Only 
+				built with NMQTT_IO_URING defined (make IOURING=1).
+			- Multishot accept and receive need Linux 6.0 or newer, which supported() checks.
+			- An instance may only be used from a single thread.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_URING_H
+#define NMQTT_URING_H
+
+
+#ifdef NMQTT_IO_URING
+
+
+#include <linux/io_uring.h>
+
+#include <cstdint>
+#include <cstddef>
+
+
+class NmqttUring {
+	int fd = -1;
+	
+	// Submission queue.
+	unsigned* sqHead = 0;
+	unsigned* sqTail = 0;
+	unsigned sqMask = 0;
+	unsigned sqEntries = 0;
+	unsigned sqLocalTail = 0;
+	unsigned toSubmit = 0;
+	io_uring_sqe* sqes = 0;
+	
+	// Completion queue.
+	unsigned* cqHead = 0;
+	unsigned* cqTail = 0;
+	unsigned cqMask = 0;
+	io_uring_cqe* cqes = 0;
+	
+	void* sqRing = 0;
+	void* cqRing = 0;
+	size_t sqRingSize = 0;
+	size_t cqRingSize = 0;
+	size_t sqesSize = 0;
+	
+	// Provided buffers.
+	io_uring_buf_ring* bufRing = 0;
+	char* bufBase = 0;
+	size_t bufRingSize = 0;
+	unsigned bufCount = 0;
+	unsigned bufSize = 0;
+	uint16_t bufTail = 0;
+	
+public:
+	~NmqttUring();
+	
+	static bool supported();
+	bool init(unsigned entries);
+	bool setupBuffers(uint16_t group, unsigned count, unsigned size);
+	
+	io_uring_sqe* getSqe();
+	int submit(unsigned waitNr, int timeout = -1);
+	bool ready();
+	io_uring_cqe* peek();
+	void seen();
+	
+	char* buffer(uint16_t bid) { return bufBase + (size_t) bid * bufSize; }
+	unsigned bufferSize() { return bufSize; }
+	void returnBuffer(uint16_t bid);
+};
+
+
+#endif
+#endif
@@ -0,0 +1,560 @@
+/*
+	uring_reactor.cpp - Implementation of the NymphMQTT io_uring server reactor class.
+	
+	Revision 0
+	
+	Features:
+			- Event loop thread which accepts client connections, receives their data and sends
+				to them, using io_uring.
+			
+	Notes:
+			- 
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "uring_reactor.h"
+
+
+#ifdef NMQTT_IO_URING
+
+
+#include "nymph_logger.h"
+
+#include <Poco/Net/StreamSocketImpl.h>
+#include <Poco/Net/NetException.h>
+#include <Poco/NumberFormatter.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+
+// Request types, stored in the top byte of the request's user data. The rest holds the handle of
+// the connection.
+enum {
+	OP_ACCEPT = 1,
+	OP_WAKE,
+	OP_RECEIVE,
+	OP_SEND,
+	OP_CANCEL,
+	OP_TIMEOUT
+};
+
+static const int opShift = 56;
+static const uint64_t handleMask = ((uint64_t) 1 << opShift) - 1;
+
+static inline uint64_t userData(uint64_t op, uint64_t handle) { return (op << opShift) | handle; }
+
+// Ring sizes. Buffer counts must be a power of two.
+static const unsigned ringEntries = 256;
+static const uint16_t bufferGroup = 0;
+static const unsigned bufferCount = 256;
+static const unsigned bufferSize = 8192;
+
+// Maximum number of parts in a single send request. A message with a shared body takes two.
+static const size_t sendParts = 64;
+
+
+// --- DECONSTRUCTOR ---
+NmqttUringReactor::~NmqttUringReactor() {
+	stop();
+	if (wakefd >= 0) { close(wakefd); }
+}
+
+
+// --- SUPPORTED ---
+// Returns true if io_uring can be used on this system.
+bool NmqttUringReactor::supported() {
+	return NmqttUring::supported();
+}
+
+
+// --- LISTEN ---
+// Creates a listening socket for this reactor, on all interfaces, IPv4 and IPv6. Every reactor 
+// listens on the port, as connections are not handed out between reactors.
+bool NmqttUringReactor::listen(int port, bool reusePort) {
+	try {
+		acceptor.bind6(port, true, true, false); // Port, SO_REUSEADDR, SO_REUSEPORT, IPv6-only.
+		std::string result;
+		if (!socketOptions.apply(acceptor, result)) {
+			NYMPH_LOG_WARNING("Failed to set socket options: " + result);
+		}
+		
+		acceptor.listen(socketOptions.listenBacklog);
+		acceptor.setBlocking(false);
+	}
+	catch (Poco::Exception &e) {
+		NYMPH_LOG_ERROR("Error creating listening socket: " + e.message());
+		return false;
+	}
+	
+	accepting = true;
+	return true;
+}
+
+
+// --- START ---
+bool NmqttUringReactor::start() {
+	if (!ring.init(ringEntries) || !ring.setupBuffers(bufferGroup, bufferCount, bufferSize)) {
+		NYMPH_LOG_ERROR("Failed to set up io_uring: " + std::string(strerror(errno)));
+		return false;
+	}
+	
+	wakefd = eventfd(0, EFD_CLOEXEC);
+	if (wakefd < 0 || !submitWake() || (accepting && !submitAccept())) {
+		NYMPH_LOG_ERROR("Failed to set up io_uring requests.");
+		return false;
+	}
+	
+	running = true;
+	thread.start(*this);
+	return true;
+}
+
+
+// --- STOP ---
+// Stops the reactor thread, after closing all connections.
+void NmqttUringReactor::stop() {
+	if (!running) { return; }
+	
+	running = false;
+	uint64_t one = 1;
+	ssize_t res = write(wakefd, &one, sizeof(one));
+	(void) res;
+	thread.join();
+	
+	if (accepting) {
+		acceptor.close();
+		accepting = false;
+	}
+}
+
+
+// --- RUN ---
+void NmqttUringReactor::run() {
+	NYMPH_LOG_INFORMATION("Start listening...");
+	
+	int timeout = -1;
+	while (running) {
+		// Submit all requests queued since the last iteration, and wait for a completion unless 
+		// some are available already. Queued data which is held back limits the wait.
+		int res = ring.submit(ring.ready() ? 0 : 1, timeout);
+		if (res < 0 && res != -EBUSY && res != -EAGAIN) {
+			NYMPH_LOG_ERROR("Failed to submit io_uring requests. Terminating reactor thread.");
+			break;
+		}
+		
+		io_uring_cqe* cqe;
+		while ((cqe = ring.peek())) {
+			uint64_t data = cqe->user_data;
+			int result = cqe->res;
+			uint32_t flags = cqe->flags;
+			ring.seen();
+			handleCompletion(data, result, flags);
+		}
+		
+		timeout = takeQueues();
+	}
+	
+	drain();
+	
+	NYMPH_LOG_INFORMATION("Stopping thread...");
+}
+
+
+// --- HANDLE COMPLETION ---
+void NmqttUringReactor::handleCompletion(uint64_t data, int res, uint32_t flags) {
+	uint64_t op = data >> opShift;
+	if (op == OP_ACCEPT) {
+		if (res >= 0) {
+			// Connections accepted while stopping are closed straight away.
+			Poco::Net::StreamSocket socket(new Poco::Net::StreamSocketImpl(res));
+			if (running) { addSession(socket); }
+		}
+		else if (res != -ECANCELED) {
+			NYMPH_LOG_WARNING("Failed to accept connection: " + std::string(strerror(-res)));
+		}
+		
+		// Multishot requests end on errors, and when the kernel cannot post more completions.
+		if (!(flags & IORING_CQE_F_MORE)) {
+			acceptActive = false;
+			if (running) { submitAccept(); }
+		}
+		
+		return;
+	}
+	else if (op == OP_WAKE) {
+		// The queues are checked after every batch of completions.
+		if (running) { submitWake(); }
+		return;
+	}
+	else if (op != OP_RECEIVE && op != OP_SEND) { return; }
+	
+	std::map<uint64_t, Connection*>::iterator it = connections.find(data & handleMask);
+	if (it == connections.end()) {
+		if (flags & IORING_CQE_F_BUFFER) { ring.returnBuffer(flags >> IORING_CQE_BUFFER_SHIFT); }
+		return;
+	}
+	
+	if (op == OP_RECEIVE) { handleReceive(it->second, res, flags); }
+	else { handleSend(it->second, res); }
+}
+
+
+// --- HANDLE RECEIVE ---
+// Passes received data to the session. The buffer is returned to the kernel straight after, as 
+// the session copies what it needs.
+void NmqttUringReactor::handleReceive(Connection* conn, int res, uint32_t flags) {
+	bool more = flags & IORING_CQE_F_MORE;
+	if (!more) { conn->receiving = false; }
+	
+	if (flags & IORING_CQE_F_BUFFER) {
+		uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+		bool ok = true;
+		if (res > 0 && !conn->closing) {
+			ok = conn->session->processData(ring.buffer(bid), res);
+		}
+		
+		ring.returnBuffer(bid);
+		if (!ok) {
+			closeConnection(conn);
+			return;
+		}
+	}
+	
+	if (conn->closing) {
+		releaseConnection(conn);
+		return;
+	}
+	
+	if (res == 0) {
+		// Remote disconnnected.
+		NYMPH_LOG_INFORMATION("Received remote disconnected notice. Terminating session.");
+		closeConnection(conn);
+	}
+	else if (res < 0 && res != -ENOBUFS && res != -ECANCELED) {
+		NYMPH_LOG_ERROR("Failed to read from socket: " + std::string(strerror(-res)));
+		closeConnection(conn);
+	}
+	else if (!more && !conn->paused) {
+		// Out of buffers, or ended by the kernel. The buffers used by this batch of completions 
+		// have been returned by the time the new request is submitted. A receive which was
+		// cancelled for a paused connection is resubmitted when it resumes.
+		submitReceive(conn);
+	}
+}
+
+
+// --- HANDLE SEND ---
+// Removes the sent data from the queue, and sends the remainder along with the data queued 
+// meanwhile.
+void NmqttUringReactor::handleSend(Connection* conn, int res) {
+	conn->sendActive = false;
+	if (conn->closing) {
+		releaseConnection(conn);
+		return;
+	}
+	
+	if (res < 0) {
+		NYMPH_LOG_ERROR("Failed to send message: " + std::string(strerror(-res)));
+		closeConnection(conn);
+		return;
+	}
+	
+	conn->out.consume(res);
+	if (updateReceive(conn)) { submitSend(conn); }
+}
+
+
+// --- SUBMIT ACCEPT ---
+// Multishot accept on the listening socket. Both the listening and the accepted sockets are 
+// non-blocking, as blocking sockets can stall multishot requests.
+bool NmqttUringReactor::submitAccept() {
+	io_uring_sqe* sqe = ring.getSqe();
+	if (!sqe) { return false; }
+	
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = acceptor.impl()->sockfd();
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	sqe->user_data = userData(OP_ACCEPT, 0);
+	acceptActive = true;
+	return true;
+}
+
+
+// --- SUBMIT WAKE ---
+// Reads the eventfd which other threads write to after queuing data or connections.
+bool NmqttUringReactor::submitWake() {
+	io_uring_sqe* sqe = ring.getSqe();
+	if (!sqe) { return false; }
+	
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = wakefd;
+	sqe->addr = (uint64_t) (uintptr_t) &wakeValue;
+	sqe->len = sizeof(wakeValue);
+	sqe->user_data = userData(OP_WAKE, 0);
+	return true;
+}
+
+
+// --- SUBMIT RECEIVE ---
+bool NmqttUringReactor::submitReceive(Connection* conn) {
+	io_uring_sqe* sqe = ring.getSqe();
+	if (!sqe) {
+		NYMPH_LOG_ERROR("Submission queue full. Closing connection.");
+		closeConnection(conn);
+		return false;
+	}
+	
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = conn->fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = bufferGroup;
+	sqe->user_data = userData(OP_RECEIVE, conn->session->getHandle());
+	conn->receiving = true;
+	return true;
+}
+
+
+// --- SUBMIT SEND ---
+// Sends the queued data in a single request. The queued messages stay pinned until it completes.
+bool NmqttUringReactor::submitSend(Connection* conn) {
+	if (conn->sendActive || conn->closing || conn->out.empty()) { return true; }
+	
+	std::string_view parts[sendParts];
+	size_t count = conn->out.gather(parts, sendParts);
+	if (count == 0) {
+		// Only dropped messages and drain markers were left.
+		conn->out.consume(0);
+		return updateReceive(conn);
+	}
+	
+	io_uring_sqe* sqe = ring.getSqe();
+	if (!sqe) {
+		NYMPH_LOG_ERROR("Submission queue full. Closing connection.");
+		closeConnection(conn);
+		return false;
+	}
+	
+	conn->iov.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		conn->iov[i].iov_base = (void*) parts[i].data();
+		conn->iov[i].iov_len = parts[i].length();
+	}
+	
+	memset(&conn->msg, 0, sizeof(msghdr));
+	conn->msg.msg_iov = conn->iov.data();
+	conn->msg.msg_iovlen = count;
+	
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = conn->fd;
+	sqe->addr = (uint64_t) (uintptr_t) &conn->msg;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = userData(OP_SEND, conn->session->getHandle());
+	conn->sendActive = true;
+	return true;
+}
+
+
+// --- UPDATE RECEIVE ---
+// Stops receiving from a connection while its outbound queue is above the high-water mark, and
+// resumes once it has drained. Calls the high- and low-water handlers on these changes, and the
+// drain handler once a drain marker has been reached. Returns false if the connection was closed.
+bool NmqttUringReactor::updateReceive(Connection* conn) {
+	if (!conn->closing && conn->out.takeDrained()) {
+		NmqttOutbound::notifyDrained(conn->session->getHandle());
+	}
+	
+	bool paused = conn->out.aboveHighWater();
+	if (conn->closing || paused == conn->paused) { return true; }
+	
+	conn->paused = paused;
+	if (paused && conn->receiving) {
+		// Data received before the cancellation takes effect is still processed.
+		io_uring_sqe* sqe = ring.getSqe();
+		if (sqe) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = userData(OP_RECEIVE, conn->session->getHandle());
+			sqe->user_data = userData(OP_CANCEL, 0);
+		}
+	}
+	else if (!paused && !conn->receiving && !submitReceive(conn)) {
+		return false;
+	}
+	
+	NmqttOutbound::notify(conn->session->getHandle(), paused);
+	return true;
+}
+
+
+// --- ADOPT ---
+// Hands an accepted connection to this reactor. Can be called from any thread.
+void NmqttUringReactor::adopt(const Poco::Net::StreamSocket &socket) {
+	queueMutex.lock();
+	pending.push_back(socket);
+	queueMutex.unlock();
+	
+	uint64_t one = 1;
+	ssize_t res = write(wakefd, &one, sizeof(one));
+	(void) res;
+}
+
+
+// --- SEND ---
+// Queues data for a connection of this reactor. The parts are copied into a single buffer, as the
+// send completes asynchronously. The shared body is kept until then. Can be called from any thread.
+bool NmqttUringReactor::send(uint64_t handle, const std::string_view* parts, size_t count,
+								const NmqttSharedBody &body) {
+	if (outQueue.push(handle, parts, count, body)) {
+		uint64_t one = 1;
+		ssize_t res = write(wakefd, &one, sizeof(one));
+		(void) res;
+	}
+	
+	return true;
+}
+
+
+// --- TAKE QUEUES ---
+// Adds connections and data queued by other threads. Sends are started for all connections which
+// received data, to be submitted together. Returns the time in milliseconds until held back data 
+// is due, or -1 if nothing is queued.
+int NmqttUringReactor::takeQueues() {
+	std::vector<Poco::Net::StreamSocket> sockets;
+	queueMutex.lock();
+	sockets.swap(pending);
+	queueMutex.unlock();
+	
+	for (const Poco::Net::StreamSocket &socket : sockets) { addSession(socket); }
+	
+	int due = outQueue.take(outLocal);
+	if (outLocal.empty()) { return due; }
+	
+	for (NmqttOutQueue::Message &out : outLocal) {
+		std::map<uint64_t, Connection*>::iterator it = connections.find(out.handle);
+		if (it == connections.end() || it->second->closing) { continue; }
+		if (!it->second->out.push(std::move(out.frame))) {
+			NYMPH_LOG_WARNING("Outbound limit exceeded. Disconnecting client.");
+			closeConnection(it->second);
+		}
+	}
+	
+	for (NmqttOutQueue::Message &out : outLocal) {
+		std::map<uint64_t, Connection*>::iterator it = connections.find(out.handle);
+		if (it != connections.end() && updateReceive(it->second)) { submitSend(it->second); }
+	}
+	
+	outLocal.clear();
+	return -1;
+}
+
+
+// --- ADD SESSION ---
+void NmqttUringReactor::addSession(const Poco::Net::StreamSocket &socket) {
+	Connection* conn = new Connection;
+	conn->session = new NmqttSession(socket, this);
+	conn->session->setQuickAck(socketOptions.quickAck);
+	
+	// Most options are inherited from the listening socket, but not on all systems.
+	std::string result;
+	if (!socketOptions.apply(conn->session->getSocket(), result)) {
+		NYMPH_LOG_DEBUG("Failed to set socket options: " + result);
+	}
+	
+	conn->fd = conn->session->getSocket().impl()->sockfd();
+	connections.insert(std::pair<uint64_t, Connection*>(conn->session->getHandle(), conn));
+	
+	NYMPH_LOG_DEBUG("Added session with handle: " + 
+					Poco::NumberFormatter::format(conn->session->getHandle()));
+	
+	submitReceive(conn);
+}
+
+
+// --- CLOSE CONNECTION ---
+// Ends the requests in flight for the connection by shutting down the socket. The connection is
+// deleted once these have completed, as the kernel may still use its buffers until then.
+void NmqttUringReactor::closeConnection(Connection* conn) {
+	if (conn->closing) { return; }
+	conn->closing = true;
+	conn->out.clear();
+	
+	shutdown(conn->fd, SHUT_RDWR);
+	releaseConnection(conn);
+}
+
+
+// --- RELEASE CONNECTION ---
+// Deletes a closing connection when no requests are in flight any more.
+void NmqttUringReactor::releaseConnection(Connection* conn) {
+	if (conn->receiving || conn->sendActive) { return; }
+	
+	connections.erase(conn->session->getHandle());
+	delete conn->session;
+	delete conn;
+}
+
+
+// --- DRAIN ---
+// Stops accepting, closes all connections and waits for their requests to end, for up to a 
+// second. The listening socket stays open until the accept request has ended, and would receive
+// connections from the kernel until then.
+void NmqttUringReactor::drain() {
+	io_uring_sqe* sqe;
+	if (acceptActive && (sqe = ring.getSqe())) {
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = userData(OP_ACCEPT, 0);
+		sqe->user_data = userData(OP_CANCEL, 0);
+	}
+	
+	std::vector<Connection*> conns;
+	for (auto &entry : connections) { conns.push_back(entry.second); }
+	for (Connection* conn : conns) { closeConnection(conn); }
+	
+	__kernel_timespec ts = { 1, 0 };
+	sqe = ring.getSqe();
+	if (sqe) {
+		sqe->opcode = IORING_OP_TIMEOUT;
+		sqe->addr = (uint64_t) (uintptr_t) &ts;
+		sqe->len = 1;
+		sqe->user_data = userData(OP_TIMEOUT, 0);
+	}
+	
+	bool timedOut = !sqe;
+	while ((!connections.empty() || acceptActive) && !timedOut) {
+		int res = ring.submit(ring.ready() ? 0 : 1);
+		if (res < 0 && res != -EBUSY && res != -EAGAIN) { break; }
+		
+		io_uring_cqe* cqe;
+		while ((cqe = ring.peek())) {
+			uint64_t data = cqe->user_data;
+			int result = cqe->res;
+			uint32_t flags = cqe->flags;
+			ring.seen();
+			if ((data >> opShift) == OP_TIMEOUT) { timedOut = true; }
+			else { handleCompletion(data, result, flags); }
+		}
+	}
+	
+	// Remaining connections are deleted regardless. Closing the ring then ends their requests.
+	for (auto &entry : connections) {
+		delete entry.second->session;
+		delete entry.second;
+	}
+	
+	connections.clear();
+	
+	queueMutex.lock();
+	pending.clear();
+	queueMutex.unlock();
+	outQueue.clear();
+}
+
+
+#endif
@@ -0,0 +1,113 @@
+/*
+	uring_reactor.h - Header for the NymphMQTT io_uring server reactor class.
+	
+	Revision 0
+	
+	Features:
+			- Event loop thread which accepts client connections, receives their data and sends
+				to them, using io_uring.
+			
+	Notes:
+			- Connections are accepted with a multishot accept on the reactor's own listening 
+				socket (SO_REUSEPORT). Each connection has a multishot receive into a ring of 
+				provided buffers, so a receive needs no system call of its own.
+			- Sends from worker threads are queued and handed to the reactor. The reactor sends 
+				the data queued for a connection with a single sendmsg request, and submits the 
+				requests for all connections with a single system call. Queued data may be held 
+				back for the flush latency of NmqttOutQueue, to be coalesced with later data.
+			- The outbound queue of a connection is bounded by NmqttOutbound. While it is above its
+				high-water mark, the receive request of the connection is cancelled, and not
+				resubmitted until the queue has drained to the low-water mark.
+			- Only built with NMQTT_IO_URING defined. Needs Linux 6.0 or newer.
+			
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_URING_REACTOR_H
+#define NMQTT_URING_REACTOR_H
+
+
+#ifdef NMQTT_IO_URING
+
+
+#include <map>
+#include <vector>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <Poco/Runnable.h>
+#include <Poco/Thread.h>
+#include <Poco/Mutex.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+
+#include "server_reactor.h"
+#include "uring.h"
+#include "session.h"
+#include "out_queue.h"
+#include "outbound.h"
+
+
+class NmqttUringReactor : public NmqttServerReactor, public Poco::Runnable {
+	struct Connection {
+		NmqttSession* session;
+		int fd;
+		NmqttOutbound out;					// Data waiting to be sent, and of the current send.
+		std::vector<iovec> iov;
+		msghdr msg;
+		bool receiving = false;				// Receive request in flight.
+		bool sendActive = false;			// Send request in flight.
+		bool paused = false;				// Not receiving, while above the high-water mark.
+		bool closing = false;
+	};
+	
+	std::string loggerName = "NmqttUringReactor";
+	NmqttUring ring;
+	Poco::Net::ServerSocket acceptor;
+	bool accepting = false;
+	bool acceptActive = false;						// Accept request in flight.
+	std::map<uint64_t, Connection*> connections;
+	std::vector<Poco::Net::StreamSocket> pending;	// Connections handed over by another reactor.
+	NmqttOutQueue outQueue;							// Data sent by other threads.
+	std::vector<NmqttOutQueue::Message> outLocal;
+	Poco::Mutex queueMutex;
+	int wakefd = -1;
+	uint64_t wakeValue;
+	Poco::Thread thread;
+	bool running = false;
+	
+	bool submitAccept();
+	bool submitWake();
+	bool submitReceive(Connection* conn);
+	bool submitSend(Connection* conn);
+	bool updateReceive(Connection* conn);
+	void handleCompletion(uint64_t data, int res, uint32_t flags);
+	void handleReceive(Connection* conn, int res, uint32_t flags);
+	void handleSend(Connection* conn, int res);
+	void addSession(const Poco::Net::StreamSocket &socket);
+	int takeQueues();
+	void closeConnection(Connection* conn);
+	void releaseConnection(Connection* conn);
+	void drain();
+	
+public:
+	~NmqttUringReactor();
+	
+	static bool supported();
+	bool listen(int port, bool reusePort);
+	void setPeers(std::vector<NmqttServerReactor*> &peers) { }
+	bool start();
+	void stop();
+	void run();
+	
+	void adopt(const Poco::Net::StreamSocket &socket);
+	bool send(uint64_t handle, const std::string_view* parts, size_t count,
+				const NmqttSharedBody &body);
+};
+
+
+#endif
+#endif
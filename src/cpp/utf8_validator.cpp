@@ -0,0 +1,250 @@
+/*
+	utf8_validator.cpp - Implementation of the NymphMQTT UTF-8 and topic validator.
+	
+	Revision 0
+	
+	Features:
+			- Validates MQTT UTF-8 strings: well-formed UTF-8 without U+0000.
+			- Finds topic wildcards ('+', '#') and level separators ('/') in the same pass.
+	
+	Notes:
+			-
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#include "utf8_validator.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NMQTT_UTF8_X86
+#include <immintrin.h>
+#endif
+
+
+// --- SEQUENCE LENGTH ---
+// Returns the length of the UTF-8 sequence at the provided position, or 0 if it is malformed.
+// Rejects overlong encodings, surrogates and code points beyond U+10FFFF.
+static inline size_t sequenceLength(const uint8_t* p, size_t len) {
+	uint8_t c = p[0];
+	if (c < 0x80) { return 1; }
+	if (c < 0xC2) { return 0; }		// Continuation byte, or overlong two-byte sequence.
+	if (c < 0xE0) {
+		if (len < 2 || (p[1] & 0xC0) != 0x80) { return 0; }
+		return 2;
+	}
+	
+	if (c < 0xF0) {
+		if (len < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80) { return 0; }
+		if (c == 0xE0 && p[1] < 0xA0) { return 0; }		// Overlong.
+		if (c == 0xED && p[1] > 0x9F) { return 0; }		// Surrogate.
+		return 3;
+	}
+	
+	if (c < 0xF5) {
+		if (len < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80
+				|| (p[3] & 0xC0) != 0x80) {
+			return 0;
+		}
+		
+		if (c == 0xF0 && p[1] < 0x90) { return 0; }		// Overlong.
+		if (c == 0xF4 && p[1] > 0x8F) { return 0; }		// Beyond U+10FFFF.
+		return 4;
+	}
+	
+	return 0;
+}
+
+
+// --- SCAN RANGE ---
+// Scalar scan from index i until at least index end, moving i along. As whole characters are
+// consumed, i ends up on a character boundary, possibly past end.
+static inline uint32_t scanRange(const uint8_t* p, size_t len, size_t &i, size_t end) {
+	uint32_t flags = 0;
+	while (i < end) {
+		uint8_t c = p[i];
+		if (c < 0x80) {
+			if (c == 0) { return NMQTT_SCAN_INVALID; }
+			else if (c == '/') { flags |= NMQTT_SCAN_SLASH; }
+			else if (c == '+') { flags |= NMQTT_SCAN_PLUS; }
+			else if (c == '#') { flags |= NMQTT_SCAN_HASH; }
+			i++;
+			continue;
+		}
+		
+		size_t n = sequenceLength(p + i, len - i);
+		if (n == 0) { return NMQTT_SCAN_INVALID; }
+		i += n;
+	}
+	
+	return flags;
+}
+
+
+// --- SCAN SCALAR ---
+uint32_t NmqttUtf8Validator::scanScalar(const char* data, size_t len) {
+	size_t i = 0;
+	return scanRange((const uint8_t*) data, len, i, len);
+}
+
+
+// --- SCAN BLOCKS ---
+// Checks 16 bytes at a time from index i, leaving the remainder of less than 16 bytes. Blocks which
+// are all ASCII only need to be checked for the special characters, other blocks are handed to the
+// scalar decoder. This is inlined into both vectorised scans, so that the AVX2 version does not
+// mix in legacy SSE instructions.
+#ifdef NMQTT_UTF8_X86
+__attribute__((target("sse2"), always_inline))
+static inline uint32_t scanBlocks(const uint8_t* p, size_t len, size_t &i) {
+	uint32_t flags = 0;
+	__m128i nul = _mm_setzero_si128();
+	__m128i plus = _mm_set1_epi8('+');
+	__m128i hash = _mm_set1_epi8('#');
+	__m128i slash = _mm_set1_epi8('/');
+	__m128i foundNul = _mm_setzero_si128();
+	__m128i foundPlus = _mm_setzero_si128();
+	__m128i foundHash = _mm_setzero_si128();
+	__m128i foundSlash = _mm_setzero_si128();
+	while (i + 16 <= len) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+		if (_mm_movemask_epi8(v) != 0) {
+			flags |= scanRange(p, len, i, i + 16);
+			if (flags & NMQTT_SCAN_INVALID) { return NMQTT_SCAN_INVALID; }
+			continue;
+		}
+		
+		foundNul = _mm_or_si128(foundNul, _mm_cmpeq_epi8(v, nul));
+		foundPlus = _mm_or_si128(foundPlus, _mm_cmpeq_epi8(v, plus));
+		foundHash = _mm_or_si128(foundHash, _mm_cmpeq_epi8(v, hash));
+		foundSlash = _mm_or_si128(foundSlash, _mm_cmpeq_epi8(v, slash));
+		i += 16;
+	}
+	
+	if (_mm_movemask_epi8(foundNul)) { return NMQTT_SCAN_INVALID; }
+	if (_mm_movemask_epi8(foundPlus)) { flags |= NMQTT_SCAN_PLUS; }
+	if (_mm_movemask_epi8(foundHash)) { flags |= NMQTT_SCAN_HASH; }
+	if (_mm_movemask_epi8(foundSlash)) { flags |= NMQTT_SCAN_SLASH; }
+	
+	return flags;
+}
+#endif
+
+
+// --- SCAN SSE2 ---
+#ifdef NMQTT_UTF8_X86
+__attribute__((target("sse2")))
+#endif
+uint32_t NmqttUtf8Validator::scanSSE2(const char* data, size_t len) {
+#ifdef NMQTT_UTF8_X86
+	const uint8_t* p = (const uint8_t*) data;
+	size_t i = 0;
+	uint32_t flags = scanBlocks(p, len, i);
+	if (flags & NMQTT_SCAN_INVALID) { return NMQTT_SCAN_INVALID; }
+	
+	uint32_t tail = scanRange(p, len, i, len);
+	return (tail & NMQTT_SCAN_INVALID) ? tail : flags | tail;
+#else
+	return scanScalar(data, len);
+#endif
+}
+
+
+// --- SCAN AVX2 ---
+// As the SSE2 version, with 32 bytes at a time. A remainder of 16 bytes or more is checked as a
+// 16 byte block.
+#ifdef NMQTT_UTF8_X86
+__attribute__((target("avx2")))
+#endif
+uint32_t NmqttUtf8Validator::scanAVX2(const char* data, size_t len) {
+#ifdef NMQTT_UTF8_X86
+	const uint8_t* p = (const uint8_t*) data;
+	uint32_t flags = 0;
+	size_t i = 0;
+	__m256i nul = _mm256_setzero_si256();
+	__m256i plus = _mm256_set1_epi8('+');
+	__m256i hash = _mm256_set1_epi8('#');
+	__m256i slash = _mm256_set1_epi8('/');
+	__m256i foundNul = _mm256_setzero_si256();
+	__m256i foundPlus = _mm256_setzero_si256();
+	__m256i foundHash = _mm256_setzero_si256();
+	__m256i foundSlash = _mm256_setzero_si256();
+	while (i + 32 <= len) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (p + i));
+		if (_mm256_movemask_epi8(v) != 0) {
+			flags |= scanRange(p, len, i, i + 32);
+			if (flags & NMQTT_SCAN_INVALID) { return NMQTT_SCAN_INVALID; }
+			continue;
+		}
+		
+		foundNul = _mm256_or_si256(foundNul, _mm256_cmpeq_epi8(v, nul));
+		foundPlus = _mm256_or_si256(foundPlus, _mm256_cmpeq_epi8(v, plus));
+		foundHash = _mm256_or_si256(foundHash, _mm256_cmpeq_epi8(v, hash));
+		foundSlash = _mm256_or_si256(foundSlash, _mm256_cmpeq_epi8(v, slash));
+		i += 32;
+	}
+	
+	if (_mm256_movemask_epi8(foundNul)) { return NMQTT_SCAN_INVALID; }
+	if (_mm256_movemask_epi8(foundPlus)) { flags |= NMQTT_SCAN_PLUS; }
+	if (_mm256_movemask_epi8(foundHash)) { flags |= NMQTT_SCAN_HASH; }
+	if (_mm256_movemask_epi8(foundSlash)) { flags |= NMQTT_SCAN_SLASH; }
+	
+	flags |= scanBlocks(p, len, i);
+	if (flags & NMQTT_SCAN_INVALID) { return NMQTT_SCAN_INVALID; }
+	
+	uint32_t tail = scanRange(p, len, i, len);
+	return (tail & NMQTT_SCAN_INVALID) ? tail : flags | tail;
+#else
+	return scanScalar(data, len);
+#endif
+}
+
+
+// --- SCAN ---
+// Returns the scan flags for the provided string, using the fastest implementation for this CPU.
+uint32_t NmqttUtf8Validator::scan(const char* data, size_t len) {
+#ifdef NMQTT_UTF8_X86
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	if (len >= 32 && avx2) { return scanAVX2(data, len); }
+	return scanSSE2(data, len);
+#else
+	return scanScalar(data, len);
+#endif
+}
+
+
+// --- VALID STRING ---
+// Returns true if the string is a valid MQTT UTF-8 string.
+bool NmqttUtf8Validator::validString(std::string_view str) {
+	return !(scan(str) & NMQTT_SCAN_INVALID);
+}
+
+
+// --- VALID TOPIC NAME ---
+// Returns true if the string is valid as the topic of a PUBLISH message: a valid string without
+// wildcards. An empty topic is accepted, as it is used with topic aliases.
+bool NmqttUtf8Validator::validTopicName(std::string_view topic) {
+	return !(scan(topic) & (NMQTT_SCAN_INVALID | NMQTT_SCAN_PLUS | NMQTT_SCAN_HASH));
+}
+
+
+// --- VALID TOPIC FILTER ---
+// Returns true if the string is valid as a subscription topic filter. Wildcards have to occupy a
+// whole topic level, and the multi-level wildcard can only be the last level.
+bool NmqttUtf8Validator::validTopicFilter(std::string_view filter) {
+	if (filter.empty()) { return false; }
+	
+	uint32_t flags = scan(filter);
+	if (flags & NMQTT_SCAN_INVALID) { return false; }
+	if (!(flags & (NMQTT_SCAN_PLUS | NMQTT_SCAN_HASH))) { return true; }
+	
+	// Check the wildcard positions.
+	for (size_t i = 0; i < filter.length(); ++i) {
+		char c = filter[i];
+		if (c != '+' && c != '#') { continue; }
+		if (i > 0 && filter[i - 1] != '/') { return false; }
+		if (c == '#' && i + 1 != filter.length()) { return false; }
+		if (c == '+' && i + 1 < filter.length() && filter[i + 1] != '/') { return false; }
+	}
+	
+	return true;
+}
@@ -0,0 +1,52 @@
+/*
+	utf8_validator.h - Header for the NymphMQTT UTF-8 and topic validator.
+	
+	Revision 0
+	
+	Features:
+			- Validates MQTT UTF-8 strings: well-formed UTF-8 without U+0000.
+			- Finds topic wildcards ('+', '#') and level separators ('/') in the same pass.
+	
+	Notes:
+			- ASCII is checked 16 (SSE2) or 32 (AVX2) bytes at a time. Blocks containing multi-byte
+				sequences are validated by the scalar decoder, which is also used on other platforms.
+			- AVX2 is selected at runtime when supported by the CPU.
+	
+	2026/10/17 - Maya Posch
+*/
+
+
+#ifndef NMQTT_UTF8_VALIDATOR_H
+#define NMQTT_UTF8_VALIDATOR_H
+
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+
+// Flags returned by a scan.
+enum NmqttScanFlags {
+	NMQTT_SCAN_INVALID = 0x01,		// Malformed UTF-8, or U+0000. No other flags are set then.
+	NMQTT_SCAN_PLUS = 0x02,			// Single-level wildcard found.
+	NMQTT_SCAN_HASH = 0x04,			// Multi-level wildcard found.
+	NMQTT_SCAN_SLASH = 0x08			// Topic level separator found.
+};
+
+
+class NmqttUtf8Validator {
+	static uint32_t scanSSE2(const char* data, size_t len);
+	static uint32_t scanAVX2(const char* data, size_t len);
+	
+public:
+	static uint32_t scan(const char* data, size_t len);
+	static uint32_t scan(std::string_view str) { return scan(str.data(), str.length()); }
+	static uint32_t scanScalar(const char* data, size_t len);
+	
+	static bool validString(std::string_view str);
+	static bool validTopicName(std::string_view topic);
+	static bool validTopicFilter(std::string_view filter);
+};
+
+
+#endif